@@ -0,0 +1,616 @@
+/**
+ * \file ctb_bench.c
+ * \brief Measure the overhead of tracing against uninstrumented code.
+ *
+ * Usage: ctb_bench [-r RUNS] [-s SCALE]
+ *
+ * Every workload is run without instrumentation (raw), with the TRACE and TRY macros
+ * (trace), and with frames pushed from static call sites with
+ * ctb_push_call_stack_site (site), which copies one precomputed frame instead of
+ * storing its fields one by one. The best of several runs is reported, with the
+ * overhead relative to the raw mode and the cache misses counted by perf_event_open
+ * on Linux when the kernel allows it.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "clock.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HAS_PERF_EVENT 1
+#else
+#define HAS_PERF_EVENT 0
+#endif
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+/* Depth of the recursion workload, as in examples/example_recursion.c */
+#define RECURSION_DEPTH 100
+
+#define RECURSION_ITERATIONS 20000
+#define TRY_LOOP_ITERATIONS 10000000
+#define THROW_LOOP_ITERATIONS 200000
+#define NUM_THREADS 4
+
+#define DEFAULT_NUM_RUNS 5
+
+/**
+ * \brief Like TRACE, but pushes a frame precomputed at compile time.
+ */
+#define TRACE_SITE(expr)                                                               \
+    do                                                                                 \
+    {                                                                                  \
+        static const CTB_Frame ctb_site_ = {__LINE__, __FILE__, __func__, #expr};      \
+        ctb_push_call_stack_site(&ctb_site_);                                          \
+        (expr);                                                                        \
+        ctb_pop_call_stack_frame();                                                    \
+    } while (0)
+
+/**
+ * \brief Like TRY, but pushes a frame precomputed at compile time.
+ */
+#define TRY_SITE(ok, expr)                                                             \
+    do                                                                                 \
+    {                                                                                  \
+        static const CTB_Frame ctb_site_ = {__LINE__, __FILE__, __func__, #expr};      \
+        ctb_push_call_stack_site(&ctb_site_);                                          \
+        (expr);                                                                        \
+        ctb_pop_call_stack_frame();                                                    \
+        (ok) = !ctb_check_error();                                                     \
+    } while (0)
+
+typedef void (*Workload_Fn)(long iterations);
+
+typedef struct
+{
+    const char *workload;
+    const char *mode;
+    Workload_Fn run;
+    long iterations;
+    bool threaded;
+} Bench_Case;
+
+typedef struct
+{
+    double ns_per_iteration;
+    long long cache_misses;
+} Bench_Result;
+
+/* Keeps the compiler from discarding the raw workloads */
+static volatile long bench_sink;
+
+/* Error state of the raw workloads, which report errors by return value */
+typedef struct
+{
+    int code;
+    char message[CTB_MAX_ERROR_MESSAGE_LENGTH];
+} Raw_Error;
+
+/* --- Recursion: deep call chain throwing at the bottom --- */
+
+BENCH_NOINLINE static int raw_recursion(Raw_Error *error, int count)
+{
+    if (count >= RECURSION_DEPTH)
+    {
+        error->code = CTB_RUNTIME_ERROR;
+        snprintf(
+            error->message,
+            sizeof(error->message),
+            "Oh no, some error occurred at depth %d",
+            count
+        );
+        return 1;
+    }
+
+    const int status = raw_recursion(error, count + 1);
+    bench_sink += count;
+    return status;
+}
+
+BENCH_NOINLINE static void trace_recursion(int count)
+{
+    if (count >= RECURSION_DEPTH)
+    {
+        THROW_FMT(CTB_RUNTIME_ERROR, "Oh no, some error occurred at depth %d", count);
+        return;
+    }
+
+    TRACE(trace_recursion(count + 1));
+    bench_sink += count;
+}
+
+BENCH_NOINLINE static void site_recursion(int count)
+{
+    if (count >= RECURSION_DEPTH)
+    {
+        THROW_FMT(CTB_RUNTIME_ERROR, "Oh no, some error occurred at depth %d", count);
+        return;
+    }
+
+    TRACE_SITE(site_recursion(count + 1));
+    bench_sink += count;
+}
+
+static void recursion_raw(long iterations)
+{
+    Raw_Error error;
+    for (long i = 0; i < iterations; i++)
+    {
+        if (raw_recursion(&error, 0) != 0)
+        {
+            error.code = 0;
+        }
+    }
+}
+
+static void recursion_trace(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        TRACE(trace_recursion(0));
+        ctb_clear_error();
+    }
+}
+
+static void recursion_site(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        TRACE_SITE(site_recursion(0));
+        ctb_clear_error();
+    }
+}
+
+/* --- TRY loop: short calls that never fail --- */
+
+BENCH_NOINLINE static int raw_step(long i, long *sum)
+{
+    *sum += i;
+    return (*sum < 0) ? 1 : 0;
+}
+
+BENCH_NOINLINE static void traced_step(long i, long *sum)
+{
+    *sum += i;
+    if (*sum < 0)
+    {
+        THROW(CTB_MATH_OVERFLOW_ERROR, "Sum overflow");
+    }
+}
+
+static void try_loop_raw(long iterations)
+{
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        if (raw_step(i, &sum) != 0)
+        {
+            break;
+        }
+    }
+    bench_sink = sum;
+}
+
+static void try_loop_trace(long iterations)
+{
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        if (!TRY(traced_step(i, &sum)))
+        {
+            break;
+        }
+    }
+    bench_sink = sum;
+}
+
+static void try_loop_site(long iterations)
+{
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        bool ok;
+        TRY_SITE(ok, traced_step(i, &sum));
+        if (!ok)
+        {
+            break;
+        }
+    }
+    bench_sink = sum;
+}
+
+/* --- Throw loop: every call fails and the error is handled --- */
+
+BENCH_NOINLINE static int raw_fail(Raw_Error *error, long i)
+{
+    error->code = CTB_TIMEOUT_ERROR;
+    snprintf(error->message, sizeof(error->message), "Request %ld timed out", i);
+    return 1;
+}
+
+BENCH_NOINLINE static void traced_fail(long i)
+{
+    THROW_FMT(CTB_TIMEOUT_ERROR, "Request %ld timed out", i);
+}
+
+static void throw_loop_raw(long iterations)
+{
+    Raw_Error error;
+    for (long i = 0; i < iterations; i++)
+    {
+        if (raw_fail(&error, i) != 0)
+        {
+            error.code = 0;
+        }
+    }
+}
+
+static void throw_loop_trace(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        TRACE(traced_fail(i));
+        ctb_clear_error();
+    }
+}
+
+static void throw_loop_site(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        TRACE_SITE(traced_fail(i));
+        ctb_clear_error();
+    }
+}
+
+static const Bench_Case bench_cases[] = {
+    {"recursion", "raw", recursion_raw, RECURSION_ITERATIONS, false},
+    {"recursion", "trace", recursion_trace, RECURSION_ITERATIONS, false},
+    {"recursion", "site", recursion_site, RECURSION_ITERATIONS, false},
+    {"try_loop", "raw", try_loop_raw, TRY_LOOP_ITERATIONS, false},
+    {"try_loop", "trace", try_loop_trace, TRY_LOOP_ITERATIONS, false},
+    {"try_loop", "site", try_loop_site, TRY_LOOP_ITERATIONS, false},
+    {"throw_mt", "raw", throw_loop_raw, THROW_LOOP_ITERATIONS, true},
+    {"throw_mt", "trace", throw_loop_trace, THROW_LOOP_ITERATIONS, true},
+    {"throw_mt", "site", throw_loop_site, THROW_LOOP_ITERATIONS, true}
+};
+
+/* --- Threads --- */
+
+typedef struct
+{
+    Workload_Fn run;
+    long iterations;
+} Thread_Arg;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg)
+{
+    const Thread_Arg *thread_arg = arg;
+    thread_arg->run(thread_arg->iterations);
+    return 0;
+}
+#else
+static void *thread_main(void *arg)
+{
+    const Thread_Arg *thread_arg = arg;
+    thread_arg->run(thread_arg->iterations);
+    return NULL;
+}
+#endif
+
+/**
+ * \brief Run a workload on NUM_THREADS threads at once.
+ *
+ * \return false if a thread cannot be created.
+ */
+static bool run_threads(Workload_Fn run, long iterations)
+{
+    Thread_Arg arg = {run, iterations};
+    bool ok = true;
+
+#ifdef _WIN32
+    HANDLE threads[NUM_THREADS];
+    int num_threads = 0;
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        threads[num_threads] = CreateThread(NULL, 0, thread_main, &arg, 0, NULL);
+        if (!threads[num_threads])
+        {
+            ok = false;
+            break;
+        }
+        num_threads++;
+    }
+    WaitForMultipleObjects(num_threads, threads, TRUE, INFINITE);
+    for (int i = 0; i < num_threads; i++)
+    {
+        CloseHandle(threads[i]);
+    }
+#else
+    pthread_t threads[NUM_THREADS];
+    int num_threads = 0;
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        if (pthread_create(&threads[num_threads], NULL, thread_main, &arg) != 0)
+        {
+            ok = false;
+            break;
+        }
+        num_threads++;
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+#endif
+
+    return ok;
+}
+
+/* --- Cache miss counter --- */
+
+/**
+ * \brief Open a counter of the cache misses of the calling thread and the threads it
+ * creates afterwards, in user space only.
+ *
+ * \return The file descriptor of the counter, or -1 if it is not available.
+ */
+static int open_cache_miss_counter(void)
+{
+#if HAS_PERF_EVENT
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static void start_counter(int fd)
+{
+#if HAS_PERF_EVENT
+    if (fd != -1)
+    {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+/**
+ * \brief Stop a counter and read its value.
+ *
+ * \return The number of cache misses, or -1 if the counter is not available.
+ */
+static long long stop_counter(int fd)
+{
+#if HAS_PERF_EVENT
+    if (fd != -1)
+    {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count;
+        if (read(fd, &count, sizeof(count)) == (ssize_t)sizeof(count))
+        {
+            return count;
+        }
+    }
+#else
+    (void)fd;
+#endif
+    return -1;
+}
+
+static void close_counter(int fd)
+{
+#if HAS_PERF_EVENT
+    if (fd != -1)
+    {
+        close(fd);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+/* --- Driver --- */
+
+/**
+ * \brief Run a case once after a warm-up run, then keep the fastest of the runs.
+ *
+ * \param[in] bench_case The case.
+ * \param[in] num_runs The number of measured runs.
+ * \param[in] scale The factor applied to the number of iterations.
+ * \param[out] result The fastest run.
+ * \return false if the workload threads cannot be created.
+ */
+static bool run_case(
+    const Bench_Case *bench_case,
+    const int num_runs,
+    const double scale,
+    Bench_Result *result
+)
+{
+    long iterations = (long)(bench_case->iterations * scale);
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+    const long total_iterations =
+        bench_case->threaded ? iterations * NUM_THREADS : iterations;
+
+    const int counter = open_cache_miss_counter();
+    result->ns_per_iteration = -1.0;
+    result->cache_misses = -1;
+
+    for (int run = 0; run <= num_runs; run++)
+    {
+        start_counter(counter);
+        const unsigned long long start = ctb_clock_ns();
+        if (bench_case->threaded)
+        {
+            if (!run_threads(bench_case->run, iterations))
+            {
+                close_counter(counter);
+                return false;
+            }
+        }
+        else
+        {
+            bench_case->run(iterations);
+        }
+        const unsigned long long end = ctb_clock_ns();
+        const long long cache_misses = stop_counter(counter);
+
+        /* The first run warms up the caches and the storage of the library */
+        const double ns = (double)(end - start) / (double)total_iterations;
+        const bool fastest =
+            (result->ns_per_iteration < 0.0 || ns < result->ns_per_iteration);
+        if (run > 0 && fastest)
+        {
+            result->ns_per_iteration = ns;
+            result->cache_misses = cache_misses;
+        }
+    }
+
+    close_counter(counter);
+    return true;
+}
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-r RUNS] [-s SCALE]\n", program);
+    fprintf(
+        stderr,
+        "Report the best of RUNS (default: %d) runs of each workload, with the\n"
+        "number of iterations multiplied by SCALE (default: 1).\n",
+        DEFAULT_NUM_RUNS
+    );
+}
+
+int main(int argc, char **argv)
+{
+    int num_runs = DEFAULT_NUM_RUNS;
+    double scale = 1.0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            num_runs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            scale = atof(argv[++i]);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (num_runs < 1 || scale <= 0.0)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    printf("C Traceback benchmark, best of %d runs", num_runs);
+    printf(" (%d threads for the multi-threaded workload)\n\n", NUM_THREADS);
+    printf(
+        "%-10s %-6s %12s %10s %14s\n",
+        "Workload",
+        "Mode",
+        "ns/iter",
+        "Overhead",
+        "Cache misses"
+    );
+
+    const int num_cases = (int)(sizeof(bench_cases) / sizeof(bench_cases[0]));
+    double raw_ns = 0.0;
+    bool has_cache_misses = false;
+    for (int i = 0; i < num_cases; i++)
+    {
+        const Bench_Case *bench_case = &bench_cases[i];
+        Bench_Result result;
+        if (!run_case(bench_case, num_runs, scale, &result))
+        {
+            fprintf(
+                stderr, "Failed to create the threads of %s\n", bench_case->workload
+            );
+            return 1;
+        }
+
+        char overhead[32];
+        if (strcmp(bench_case->mode, "raw") == 0)
+        {
+            raw_ns = result.ns_per_iteration;
+            snprintf(overhead, sizeof(overhead), "-");
+        }
+        else
+        {
+            const double excess = result.ns_per_iteration - raw_ns;
+            const double percent = (raw_ns > 0.0) ? 100.0 * excess / raw_ns : 0.0;
+            snprintf(overhead, sizeof(overhead), "%+.1f%%", percent);
+        }
+
+        char cache_misses[32];
+        if (result.cache_misses >= 0)
+        {
+            snprintf(cache_misses, sizeof(cache_misses), "%lld", result.cache_misses);
+            has_cache_misses = true;
+        }
+        else
+        {
+            snprintf(cache_misses, sizeof(cache_misses), "n/a");
+        }
+
+        printf(
+            "%-10s %-6s %12.2f %10s %14s\n",
+            bench_case->workload,
+            bench_case->mode,
+            result.ns_per_iteration,
+            overhead,
+            cache_misses
+        );
+    }
+
+    if (!has_cache_misses)
+    {
+        printf(
+            "\nCache misses are not available: perf_event_open is Linux-only and\n"
+            "may be restricted by /proc/sys/kernel/perf_event_paranoid.\n"
+        );
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c_traceback.h"
+
+static size_t num_allocations = 0;
+
+static void *counting_malloc(size_t size, void *user_data)
+{
+    (*(size_t *)user_data)++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *user_data)
+{
+    (void)user_data;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr, void *user_data)
+{
+    (void)user_data;
+    free(ptr);
+}
+
+void risky_function(void)
+{
+    THROW(CTB_MEMORY_ERROR, "Out of memory, but the error is still recorded");
+}
+
+int main(void)
+{
+    // Route all memory owned by the library through custom hooks
+    CTB_Config config = ctb_default_config();
+    config.allocator.malloc_fn = counting_malloc;
+    config.allocator.realloc_fn = counting_realloc;
+    config.allocator.free_fn = counting_free;
+    config.allocator.user_data = &num_allocations;
+    if (!ctb_init(&config))
+    {
+        return 1;
+    }
+
+    TRY_GOTO(risky_function(), error);
+    printf("This shouldn't be printed if there is error");
+
+error:
+    printf("Library allocations: %zu\n", num_allocations);
+    ctb_dump_traceback();
+    return 0;
+}
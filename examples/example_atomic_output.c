@@ -0,0 +1,76 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define NUM_WORKERS 8
+#define NUM_REQUESTS 5
+
+static void handle_request(int worker_id, int request)
+{
+    if (request % 2 == 0)
+    {
+        THROW_FMT(
+            CTB_TIMEOUT_ERROR, "Worker %d: request %d timed out", worker_id, request
+        );
+    }
+}
+
+static void run_worker(int worker_id)
+{
+    for (int request = 0; request < NUM_REQUESTS; request++)
+    {
+        TRACE(handle_request(worker_id, request));
+        ctb_dump_traceback();
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker(LPVOID arg)
+{
+    run_worker((int)(INT_PTR)arg);
+    return 0;
+}
+#else
+static void *worker(void *arg)
+{
+    run_worker((int)(long)arg);
+    return NULL;
+}
+#endif
+
+int main(void)
+{
+    // Write each traceback whole with one system call, in the order of completion
+    ctb_set_atomic_output(true);
+
+#ifdef _WIN32
+    HANDLE threads[NUM_WORKERS];
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, worker, (LPVOID)(INT_PTR)i, 0, NULL);
+    }
+    WaitForMultipleObjects(NUM_WORKERS, threads, TRUE, INFINITE);
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        CloseHandle(threads[i]);
+    }
+#else
+    pthread_t threads[NUM_WORKERS];
+    for (long i = 0; i < NUM_WORKERS; i++)
+    {
+        pthread_create(&threads[i], NULL, worker, (void *)i);
+    }
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#define NUM_PATHS 4
+
+static void read_file(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        THROW_FMT(CTB_FILE_NOT_FOUND_ERROR, "Failed to open file: \"%s\"", path);
+        return;
+    }
+    fclose(file);
+}
+
+static void parse_file(const char *path)
+{
+    if (path[0] == '\0')
+    {
+        THROW(CTB_SYNTAX_ERROR, "Empty path");
+        return;
+    }
+    TRACE(read_file(path));
+}
+
+/* Missing files are expected and skipped, any other error is left pending */
+static void process_file(const char *path)
+{
+    TRY_CATCH(parse_file(path), CTB_OS_ERROR, os_error);
+    return;
+
+os_error:
+{
+    const char *message;
+    const CTB_Error error = ctb_get_last_error(&message);
+    printf("Skipped (%s): %s\n", error_to_string(error), message);
+    ctb_catch_error(CTB_OS_ERROR);
+}
+}
+
+int main(void)
+{
+    const char *paths[NUM_PATHS] = {"missing_1.txt", "missing_2.txt", "", "other.txt"};
+
+    for (int i = 0; i < NUM_PATHS; i++)
+    {
+        TRY_GOTO(process_file(paths[i]), error);
+    }
+
+    return 0;
+
+error:
+    ctb_dump_traceback();
+    return 1;
+}
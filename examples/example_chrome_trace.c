@@ -0,0 +1,42 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#define TRACE_FILE "trace.json"
+
+static void parse_record(int index)
+{
+    if (index % 7 == 0)
+    {
+        THROW_FMT(CTB_INVALID_FORMAT_ERROR, "Malformed record #%d", index);
+        return;
+    }
+}
+
+static void process_batch(int batch)
+{
+    for (int i = 0; i < 10; i++)
+    {
+        TRACE(parse_record(batch * 10 + i));
+    }
+}
+
+int main(void)
+{
+    if (!ctb_chrome_trace_start(TRACE_FILE))
+    {
+        return 1;
+    }
+
+    for (int batch = 0; batch < 5; batch++)
+    {
+        TRACE(process_batch(batch));
+        ctb_clear_error();
+    }
+
+    ctb_chrome_trace_stop();
+
+    // Open the file with chrome://tracing or https://ui.perfetto.dev
+    printf("Trace written to \"%s\"\n", TRACE_FILE);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#define N 100
+
+void recursion(int count)
+{
+    if (count >= N)
+    {
+        THROW_FMT(CTB_RUNTIME_ERROR, "Oh no, some error occurred at depth %d", count);
+        return;
+    }
+
+    TRACE(recursion(count + 1));
+}
+
+int main(void)
+{
+    // Record the full call stack without recompiling the library
+    CTB_Config config = ctb_default_config();
+    config.max_call_stack_depth = 128;
+    config.max_num_errors = 2;
+    if (!ctb_init(&config))
+    {
+        return 1;
+    }
+
+    TRY_GOTO(recursion(0), error);
+    printf("This shouldn't be printed if there is error");
+
+error:
+    ctb_dump_traceback();
+    return 0;
+}
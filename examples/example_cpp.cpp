@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <vector>
+
+#include "c_traceback.hpp"
+
+int parse_value(int value)
+{
+    if (value < 0)
+    {
+        CTB_THROW_CXX(CTB_VALUE_ERROR, "Negative values are not allowed");
+    }
+    return value * 2;
+}
+
+int sum_values(const std::vector<int> &values)
+{
+    int total = 0;
+    for (const int value : values)
+    {
+        // The frame is popped and the call timed even when parse_value throws
+        TRACE_TIMED(total += parse_value(value));
+    }
+    return total;
+}
+
+int main()
+{
+    try
+    {
+        TRACE(sum_values({1, 2, -3}));
+    }
+    catch (const ctb::Error &e)
+    {
+        std::printf("Caught C++ exception: %s\n", e.what());
+        std::fflush(stdout);
+        ctb_dump_traceback();
+        ctb_clear_error();
+    }
+
+    // Exceptions escaping into C code are recorded as C Traceback errors
+    CTB_CATCH_CXX(std::vector<int>().at(1));
+    if (ctb_check_error())
+    {
+        ctb_dump_traceback();
+    }
+    return 0;
+}
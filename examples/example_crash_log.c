@@ -0,0 +1,52 @@
+#include <signal.h>
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define CRASH_LOG_PATH "example_crash_log.bin"
+#define CRASH_LOG_RECORDS 64
+
+static void process_item(const int item)
+{
+    if (item % 3 == 0)
+    {
+        THROW_FMT(CTB_VALUE_ERROR, "Item %d is not supported", item);
+    }
+}
+
+int main(void)
+{
+    /* Records are kept in the file even if the process is killed */
+    if (!ctb_crash_log_open(CRASH_LOG_PATH, CRASH_LOG_RECORDS))
+    {
+        return 1;
+    }
+
+    for (int i = 1; i <= 5; i++)
+    {
+        LOG_MESSAGE_INLINE_FMT("Processing item %d", i);
+        if (!TRY(process_item(i)))
+        {
+            LOG_WARNING_INLINE_FMT(CTB_WARNING, "Skipped item %d", i);
+            ctb_clear_error();
+        }
+    }
+
+    printf("Killing the process, run \"ctb_crash_decode " CRASH_LOG_PATH "\"\n");
+    fflush(stdout);
+
+    /* Neither a signal handler nor atexit runs after this */
+#ifdef _WIN32
+    TerminateProcess(GetCurrentProcess(), 1);
+#else
+    kill(getpid(), SIGKILL);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+/* Application-defined errors start at CTB_CUSTOM_ERROR_BASE */
+enum
+{
+    APP_CONFIG_ERROR = CTB_CUSTOM_ERROR_BASE,
+    APP_MISSING_KEY_ERROR,
+    APP_CORRUPTED_STATE_ERROR
+};
+
+static void register_errors(void)
+{
+    ctb_register_error(
+        APP_CONFIG_ERROR, "ConfigError", CTB_VALUE_ERROR, CTB_SEVERITY_ERROR
+    );
+    ctb_register_error(
+        APP_MISSING_KEY_ERROR, "MissingKeyError", APP_CONFIG_ERROR, CTB_SEVERITY_WARNING
+    );
+    ctb_register_error(
+        APP_CORRUPTED_STATE_ERROR,
+        "CorruptedStateError",
+        CTB_ERROR,
+        CTB_SEVERITY_CRITICAL
+    );
+}
+
+static void load_config(const char *key)
+{
+    THROW_FMT((CTB_Error)APP_MISSING_KEY_ERROR, "Key \"%s\" is missing", key);
+}
+
+int main(void)
+{
+    register_errors();
+
+    for (CTB_Error error = APP_MISSING_KEY_ERROR; error != CTB_SUCCESS;
+         error = ctb_get_error_parent(error))
+    {
+        printf(
+            "%s (%d, %s)\n",
+            error_to_string(error),
+            (int)error,
+            severity_to_string(ctb_get_error_severity(error))
+        );
+    }
+
+    TRACE(load_config("database.url"));
+    ctb_dump_traceback();
+
+    return 0;
+}
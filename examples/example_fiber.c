@@ -0,0 +1,95 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#if defined(__linux__)
+#include <ucontext.h>
+
+#define NUM_FIBERS 2
+#define FIBER_STACK_SIZE (64 * 1024)
+
+typedef struct Fiber
+{
+    int id;
+    ucontext_t uctx;
+    CTB_Context *ctb_context;
+    char stack[FIBER_STACK_SIZE];
+} Fiber;
+
+static ucontext_t scheduler_uctx;
+static Fiber fibers[NUM_FIBERS];
+
+static void yield(Fiber *fiber)
+{
+    swapcontext(&fiber->uctx, &scheduler_uctx);
+}
+
+void fetch_page(Fiber *fiber, int page)
+{
+    // Other fibers run while this one waits, with their own call stacks
+    yield(fiber);
+
+    if (fiber->id == 1 && page == 2)
+    {
+        THROW_FMT(
+            CTB_RUNTIME_ERROR, "Fiber %d failed to fetch page %d", fiber->id, page
+        );
+    }
+}
+
+void crawl(Fiber *fiber)
+{
+    for (int page = 0; page < 3; page++)
+    {
+        TRY_GOTO(fetch_page(fiber, page), error);
+    }
+    return;
+
+error:
+    ctb_dump_traceback();
+}
+
+static void fiber_main(int id)
+{
+    Fiber *fiber = &fibers[id];
+    TRACE(crawl(fiber));
+}
+
+int main(void)
+{
+    for (int i = 0; i < NUM_FIBERS; i++)
+    {
+        Fiber *fiber = &fibers[i];
+        fiber->id = i;
+        fiber->ctb_context = ctb_context_create();
+        getcontext(&fiber->uctx);
+        fiber->uctx.uc_stack.ss_sp = fiber->stack;
+        fiber->uctx.uc_stack.ss_size = sizeof(fiber->stack);
+        fiber->uctx.uc_link = &scheduler_uctx;
+        makecontext(&fiber->uctx, (void (*)(void))fiber_main, 1, i);
+    }
+
+    // Round-robin scheduler: switch the C Traceback context with the fiber
+    for (int round = 0; round < 4; round++)
+    {
+        for (int i = 0; i < NUM_FIBERS; i++)
+        {
+            CTB_Context *previous = ctb_context_switch(fibers[i].ctb_context);
+            swapcontext(&scheduler_uctx, &fibers[i].uctx);
+            ctb_context_switch(previous);
+        }
+    }
+
+    for (int i = 0; i < NUM_FIBERS; i++)
+    {
+        ctb_context_destroy(fibers[i].ctb_context);
+    }
+    return 0;
+}
+#else
+int main(void)
+{
+    printf("This example requires ucontext, which is only available on Linux\n");
+    return 0;
+}
+#endif
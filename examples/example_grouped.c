@@ -0,0 +1,48 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#define NUM_JOBS 200
+
+static void parse(int job)
+{
+    if (job % 3 == 0)
+    {
+        THROW_FMT(CTB_VALUE_ERROR, "Job %d has a malformed header", job);
+    }
+}
+
+static void upload(int job)
+{
+    if (job % 5 == 0)
+    {
+        THROW_FMT(CTB_TIMEOUT_ERROR, "Job %d timed out", job);
+    }
+}
+
+static void run_job(int job)
+{
+    TRACE(parse(job));
+    TRACE(upload(job));
+}
+
+int main(void)
+{
+    CTB_Config config = ctb_default_config();
+    config.max_num_errors = NUM_JOBS;
+    if (!ctb_init(&config))
+    {
+        return 1;
+    }
+
+    // Print each distinct traceback once instead of over a hundred times
+    ctb_set_traceback_mode(CTB_TRACEBACK_GROUPED);
+
+    for (int job = 0; job < NUM_JOBS; job++)
+    {
+        TRACE(run_job(job));
+    }
+
+    ctb_dump_traceback();
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+static void parse_config(const char *path)
+{
+    THROW_FMT(CTB_VALUE_ERROR, "Invalid key \"%s\" in %s", "colour\tmode", path);
+}
+
+static void load(const char *path)
+{
+    TRACE(parse_config(path));
+}
+
+int main(void)
+{
+    /* Machine-readable output for a log pipeline, one JSON object per line */
+    ctb_set_output_format(stderr, CTB_OUTPUT_JSON_LINES);
+    ctb_set_output_format(stdout, CTB_OUTPUT_JSON_LINES);
+
+    LOG_MESSAGE_INLINE("Loading configuration");
+    TRY_GOTO(load("app.conf"), error);
+    return 0;
+
+error:
+    LOG_WARNING_INLINE(CTB_USER_WARNING, "Falling back to the default configuration");
+    ctb_dump_traceback();
+    return 1;
+}
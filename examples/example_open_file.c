@@ -9,7 +9,8 @@ void open_file(const char *file_name)
     FILE *file = fopen(file_name, "r");
     if (!file)
     {
-        THROW_FMT(CTB_FILE_NOT_FOUND_ERROR, "Failed to open file: \"%s\"", file_name);
+        // Refined to FileNotFoundError, PermissionError, etc. according to errno
+        THROW_ERRNO(CTB_OS_ERROR, "\"%s\"", file_name);
         return;
     }
     /* Do something */
@@ -0,0 +1,56 @@
+#include <stdio.h>
+
+// Check CTB_ASSERT in release builds as well, since push relies on it
+#ifndef CTB_ASSERT_ALWAYS
+#define CTB_ASSERT_ALWAYS
+#endif
+#include "c_traceback.h"
+
+#define CAPACITY 4
+
+typedef struct
+{
+    int items[CAPACITY];
+    int size;
+} Stack;
+
+static void push(Stack *stack, int item)
+{
+    // Recoverable: throws a CTB_INDEX_ERROR into the context like THROW, and like
+    // THROW it does not leave the function
+    CTB_ASSERT(
+        stack->size < CAPACITY, CTB_INDEX_ERROR, "Stack is full (%d items)", stack->size
+    );
+    if (ctb_check_error())
+    {
+        return;
+    }
+    stack->items[stack->size++] = item;
+}
+
+static int pop(Stack *stack)
+{
+    // Unrecoverable: prints the traceback and aborts
+    if (stack->size < 0 || stack->size > CAPACITY)
+    {
+        CTB_PANIC(CTB_RUNTIME_ERROR, "Stack is corrupted (size %d)", stack->size);
+    }
+    return (stack->size > 0) ? stack->items[--stack->size] : 0;
+}
+
+int main(void)
+{
+    Stack stack = {{0}, 0};
+    for (int i = 0; i <= CAPACITY; i++)
+    {
+        TRY_GOTO(push(&stack, i), full);
+    }
+
+full:
+    ctb_dump_traceback();
+    ctb_clear_error();
+
+    stack.size = -1;
+    TRACE(pop(&stack));
+    return 0;
+}
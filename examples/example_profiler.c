@@ -0,0 +1,45 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#define N 2000000
+
+static volatile double sink = 0.0;
+
+static void spin(int iterations)
+{
+    for (int i = 0; i < iterations; i++)
+    {
+        sink += (double)i * 0.5;
+    }
+}
+
+static void light_work(void)
+{
+    TRACE(spin(N));
+}
+
+static void heavy_work(void)
+{
+    TRACE(spin(4 * N));
+}
+
+int main(void)
+{
+    if (!ctb_profiler_start(1000))
+    {
+        return 1;
+    }
+
+    for (int i = 0; i < 20; i++)
+    {
+        TRACE(light_work());
+        TRACE(heavy_work());
+    }
+
+    ctb_profiler_stop();
+
+    // Pipe into flamegraph.pl to get a flame graph of the traced call stack
+    ctb_profiler_write_folded(stdout, false);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "c_traceback.h"
+
+#define NUM_RECORDS 10000
+
+static void validate_id(int index)
+{
+    if (index % 7 == 0)
+    {
+        THROW_FMT(CTB_VALUE_ERROR, "Record %d has a negative id", index);
+    }
+}
+
+static void validate_name(int index)
+{
+    if (index % 1000 == 999)
+    {
+        THROW_FMT(CTB_VALUE_ERROR, "Record %d has an empty name", index);
+    }
+}
+
+static void validate(int index)
+{
+    TRACE(validate_id(index));
+    TRACE(validate_name(index));
+}
+
+int main(void)
+{
+    // Keep one error per throw site with its count, instead of the first few only
+    CTB_Config config = ctb_default_config();
+    config.retention_policy = CTB_RETAIN_SAMPLE;
+    if (!ctb_init(&config))
+    {
+        return 1;
+    }
+
+    for (int i = 0; i < NUM_RECORDS; i++)
+    {
+        TRACE(validate(i));
+    }
+
+    for (int i = 0; i < ctb_get_num_errors(); i++)
+    {
+        CTB_Error_View view;
+        ctb_get_error_view(i, &view);
+        printf(
+            "Line %d (stack %016llx): %d errors, e.g. \"%s\"\n",
+            view.throw_site->line_number,
+            (unsigned long long)view.signature,
+            view.count,
+            view.message
+        );
+    }
+
+    // A repeated error is merged and becomes the most recent error again
+    TRACE(validate(0));
+    CTB_Error_View last;
+    ctb_get_error_view(ctb_get_num_errors() - 1, &last);
+    if (strcmp(last.throw_site->function_name, "validate_id") != 0)
+    {
+        printf("The most recent error is not the repeated one\n");
+        return 1;
+    }
+    printf("Most recent: \"%s\", thrown %d times\n", last.message, last.count);
+
+    ctb_dump_traceback();
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#define MAX_ATTEMPTS 3
+
+static int num_calls = 0;
+
+static void fetch(void)
+{
+    num_calls++;
+    if (num_calls < MAX_ATTEMPTS)
+    {
+        THROW_FMT(CTB_TIMEOUT_ERROR, "Attempt %d timed out", num_calls);
+    }
+}
+
+int main(void)
+{
+    THROW(CTB_RESOURCE_ERROR, "Cache is unavailable");
+
+    for (int attempt = 1; attempt <= MAX_ATTEMPTS; attempt++)
+    {
+        const int num_errors = ctb_get_num_errors();
+        TRACE(fetch());
+        if (ctb_get_num_errors() == num_errors)
+        {
+            printf("Attempt %d succeeded\n", attempt);
+            break;
+        }
+
+        /* Inspect the latest error without formatting it, and recover from it only */
+        CTB_Error_View view;
+        ctb_get_error_view(ctb_get_num_errors() - 1, &view);
+        if (view.error != CTB_TIMEOUT_ERROR)
+        {
+            break;
+        }
+
+        printf(
+            "Retrying after \"%s\" thrown in %s at line %d\n",
+            view.message,
+            view.throw_site->function_name,
+            view.throw_site->line_number
+        );
+        ctb_pop_error(NULL);
+    }
+
+    /* The unrelated error is still pending */
+    for (int i = 0; i < ctb_get_num_errors(); i++)
+    {
+        CTB_Error_View view;
+        ctb_get_error_view(i, &view);
+        printf("Pending: %s: %s\n", error_to_string(view.error), view.message);
+    }
+    ctb_discard_error(0);
+
+    return ctb_check_error() ? 1 : 0;
+}
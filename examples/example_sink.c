@@ -0,0 +1,40 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#define RING_CAPACITY 4096
+
+static void divide(const int a, const int b)
+{
+    if (b == 0)
+    {
+        THROW_FMT(CTB_ZERO_DIVISION_ERROR, "Cannot divide %d by zero", a);
+    }
+}
+
+int main(void)
+{
+    /* Keep the most recent output in memory instead of writing it to stderr */
+    CTB_Ring_Sink *ring = ctb_ring_sink_create(RING_CAPACITY);
+    if (!ring)
+    {
+        return 1;
+    }
+
+    const CTB_Sink ring_sink = ctb_ring_sink(ring);
+    ctb_set_sink(&ring_sink);
+
+    LOG_MESSAGE_INLINE("Starting computation");
+    TRACE(divide(1, 0));
+    ctb_dump_traceback();
+
+    /* Restore stderr and stdout, then replay the captured output */
+    ctb_set_sink(NULL);
+
+    char buffer[RING_CAPACITY];
+    const size_t length = ctb_ring_sink_read(ring, buffer, sizeof(buffer));
+    printf("Captured %zu bytes:\n%.*s", length, (int)length, buffer);
+
+    ctb_ring_sink_destroy(ring);
+    return 0;
+}
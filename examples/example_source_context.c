@@ -0,0 +1,42 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+static double divide(double numerator, double denominator)
+{
+    if (denominator == 0.0)
+    {
+        THROW(CTB_RUNTIME_ERROR, "Division by zero attempted");
+        return 0.0;
+    }
+    return numerator / denominator;
+}
+
+static double average(const double *values, int count)
+{
+    double sum = 0.0;
+    for (int i = 0; i < count; i++)
+    {
+        sum += values[i];
+    }
+
+    double mean = 0.0;
+    TRACE(mean = divide(sum, count));
+    return mean;
+}
+
+int main(void)
+{
+    // Show two lines of source code around each frame, like Python tracebacks
+    ctb_set_source_context(2);
+
+    const double values[] = {1.0, 2.0, 3.0};
+    double mean;
+    TRY_GOTO(mean = average(values, 0), error);
+    printf("Average: %f\n", mean);
+    return 0;
+
+error:
+    ctb_dump_traceback();
+    return 1;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define NUM_TASKS 4
+
+typedef struct Task
+{
+    int id;
+    CTB_Error_Bundle *bundle;
+} Task;
+
+void parse_chunk(int id)
+{
+    if (id == 2)
+    {
+        THROW_FMT(CTB_VALUE_ERROR, "Malformed record in chunk %d", id);
+    }
+}
+
+void run_task(Task *task)
+{
+    TRACE(parse_chunk(task->id));
+
+    // Hand the errors of this task back to the submitting thread
+    ctb_error_bundle_capture(task->bundle);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker(LPVOID arg)
+{
+    run_task(arg);
+    return 0;
+}
+#else
+static void *worker(void *arg)
+{
+    run_task(arg);
+    return NULL;
+}
+#endif
+
+void spawn_task(Task *task)
+{
+    task->bundle = CTB_ERROR_BUNDLE_CREATE();
+}
+
+void process_file(void)
+{
+    Task tasks[NUM_TASKS];
+#ifdef _WIN32
+    HANDLE threads[NUM_TASKS];
+#else
+    pthread_t threads[NUM_TASKS];
+#endif
+
+    for (int i = 0; i < NUM_TASKS; i++)
+    {
+        tasks[i].id = i;
+        TRACE(spawn_task(&tasks[i]));
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, worker, &tasks[i], 0, NULL);
+#else
+        pthread_create(&threads[i], NULL, worker, &tasks[i]);
+#endif
+    }
+
+    for (int i = 0; i < NUM_TASKS; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+        ctb_error_bundle_raise(tasks[i].bundle);
+        ctb_error_bundle_destroy(tasks[i].bundle);
+    }
+}
+
+int main(void)
+{
+    TRY_GOTO(process_file(), error);
+    printf("This shouldn't be printed if there is error");
+
+error:
+    ctb_dump_traceback();
+    return 0;
+}
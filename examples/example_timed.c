@@ -0,0 +1,37 @@
+#include <stdio.h>
+
+#include "c_traceback.h"
+
+#define N 1000
+
+static unsigned long long fibonacci(int n)
+{
+    unsigned long long a = 0;
+    unsigned long long b = 1;
+    for (int i = 0; i < n; i++)
+    {
+        const unsigned long long next = a + b;
+        a = b;
+        b = next;
+    }
+    return a;
+}
+
+static void compute(int n, unsigned long long *result)
+{
+    *result = fibonacci(n);
+}
+
+int main(void)
+{
+    unsigned long long result = 0;
+    for (int i = 0; i < N; i++)
+    {
+        TRACE_TIMED(compute(10, &result));
+        TRACE_TIMED(compute(i, &result));
+    }
+    printf("Last result: %llu\n", result);
+
+    ctb_log_timing_report();
+    return 0;
+}
@@ -11,14 +11,30 @@
 #include <stdarg.h>
 #include <stdbool.h>
 
+#include "c_traceback/chrome_trace.h"
 #include "c_traceback/color_codes.h"
+#include "c_traceback/config.h"
+#include "c_traceback/context.h"
+#include "c_traceback/crash_log.h"
 #include "c_traceback/error.h"
+#include "c_traceback/error_bundle.h"
 #include "c_traceback/error_codes.h"
 #include "c_traceback/log_inline.h"
+#include "c_traceback/output_format.h"
+#include "c_traceback/panic.h"
+#include "c_traceback/profiler.h"
 #include "c_traceback/signal_handler.h"
+#include "c_traceback/sink.h"
+#include "c_traceback/theme.h"
+#include "c_traceback/timing.h"
 #include "c_traceback/trace.h"
 #include "c_traceback/traceback.h"
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
 #ifndef CTB_VERSION
 #define CTB_VERSION "Unknown"
 #endif
@@ -36,15 +52,61 @@
  */
 #define CTB_TRACEBACK_HEADER ""
 
-// Maximum number of call stack frames
+/**
+ * Default limits of the per-thread storage. They can be changed at runtime with
+ * ctb_init without recompiling the library.
+ */
+
+// Default maximum number of call stack frames
 #define CTB_MAX_CALL_STACK_DEPTH 32
 
-// Maximum number of simultaneous errors
+// Default maximum number of simultaneous errors
 #define CTB_MAX_NUM_ERROR 8
 
-// Maximum length of error message
+// Default maximum length of error message
 #define CTB_MAX_ERROR_MESSAGE_LENGTH 256
 
+// Default size in bytes of the emergency memory reserve
+#define CTB_EMERGENCY_RESERVE_SIZE (16 * 1024)
+
+// Maximum number of distinct TRACE_TIMED call sites per thread
+#define CTB_MAX_TIMED_SITES 64
+
+// Maximum number of threads sampled by the profiler
+#define CTB_PROFILER_MAX_THREADS 32
+
+// Maximum number of distinct call stacks recorded per thread by the profiler
+#define CTB_PROFILER_MAX_STACKS 1024
+
+// Number of events buffered per thread while recording a Chrome trace
+#define CTB_CHROME_TRACE_BUFFER_SIZE 8192
+
+// Maximum number of application-defined error codes, starting at 1000
+#define CTB_MAX_CUSTOM_ERRORS 256
+
+// Maximum depth of the error hierarchy, CTB_ERROR being at depth 0
+#define CTB_MAX_ERROR_DEPTH 8
+
+// Maximum length of the name of an application-defined error code
+#define CTB_MAX_ERROR_NAME_LENGTH 64
+
+// Default number of records in the ring of a crash log file
+#define CTB_CRASH_LOG_NUM_RECORDS 1024
+
+// Maximum number of source files cached for the source context of tracebacks. Files
+// are never evicted; once the cache is full, frames of other files show the traced
+// expression instead of their source lines, without reading the files.
+#define CTB_SOURCE_CACHE_MAX_FILES 64
+
+// Maximum number of lines shown before and after the line of each frame
+#define CTB_MAX_SOURCE_CONTEXT_LINES 10
+
+// Maximum number of bytes of a source line shown in a traceback
+#define CTB_MAX_SOURCE_LINE_LENGTH 160
+
+// Maximum number of streams with a configured output format
+#define CTB_MAX_OUTPUT_STREAMS 8
+
 // Terminal width when it cannot be determined
 #define CTB_DEFAULT_TERMINAL_WIDTH 80
 
@@ -61,4 +123,8 @@
  */
 void ctb_print_compilation_info(void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* C_TRACEBACK_H */
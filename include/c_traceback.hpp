@@ -0,0 +1,319 @@
+/**
+ * \file c_traceback.hpp
+ * \brief Optional C++ header for c_traceback library.
+ *
+ * Including this header instead of c_traceback.h makes the tracing macros
+ * exception-safe: frames are owned by RAII guards, so they are popped when a C++
+ * exception unwinds through them and the call depth never drifts. It also bridges
+ * C Traceback errors and C++ exceptions in both directions.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_HPP
+#define C_TRACEBACK_HPP
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+#include "c_traceback.h"
+
+// clang-format off
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(likely) && __cplusplus >= 202002L
+#define CTB_CXX_LIKELY [[likely]]
+#define CTB_CXX_UNLIKELY [[unlikely]]
+#endif
+#endif
+#ifndef CTB_CXX_LIKELY
+#define CTB_CXX_LIKELY
+#define CTB_CXX_UNLIKELY
+#endif
+// clang-format on
+
+namespace ctb
+{
+
+/**
+ * \brief RAII guard owning a call stack frame. The destructor restores the call
+ * depth from before the push, which also drops frames left behind by C macros that
+ * were skipped by an exception.
+ */
+class FrameGuard
+{
+  public:
+    explicit FrameGuard(const CTB_Frame &site) noexcept
+        : call_depth_(ctb_push_call_stack_site(&site))
+    {
+    }
+
+    ~FrameGuard()
+    {
+        ctb_unwind_call_stack(call_depth_);
+    }
+
+    FrameGuard(const FrameGuard &) = delete;
+    FrameGuard &operator=(const FrameGuard &) = delete;
+
+  private:
+    int call_depth_;
+};
+
+/**
+ * \brief RAII guard recording the elapsed time of its lifetime for a TRACE_TIMED
+ * call site, including when it ends with an exception.
+ */
+class TimingGuard
+{
+  public:
+    explicit TimingGuard(const CTB_Frame &site) noexcept
+        : site_(site), start_(ctb_timing_begin())
+    {
+    }
+
+    ~TimingGuard()
+    {
+        ctb_timing_end(&site_, start_);
+    }
+
+    TimingGuard(const TimingGuard &) = delete;
+    TimingGuard &operator=(const TimingGuard &) = delete;
+
+  private:
+    const CTB_Frame &site_;
+    unsigned long long start_;
+};
+
+/**
+ * \brief C++ exception carrying a C Traceback error.
+ */
+class Error : public std::runtime_error
+{
+  public:
+    /**
+     * \param[in] error The error type.
+     * \param[in] message Error message, may be NULL.
+     * \param[in] recorded Whether the error is already recorded in the context.
+     */
+    Error(const CTB_Error error, const char *message, const bool recorded = false)
+        : std::runtime_error(format(error, message)),
+          error_(error),
+          message_(message ? message : ""),
+          recorded_(recorded)
+    {
+    }
+
+    /** \return The error type. */
+    CTB_Error error() const noexcept
+    {
+        return error_;
+    }
+
+    /** \return The error message without the error name. */
+    const char *message() const noexcept
+    {
+        return message_.c_str();
+    }
+
+    /** \return Whether the error is already recorded in the context. */
+    bool recorded() const noexcept
+    {
+        return recorded_;
+    }
+
+  private:
+    static std::string format(const CTB_Error error, const char *message)
+    {
+        std::string what = error_to_string(error);
+        if (message && message[0])
+        {
+            what += ": ";
+            what += message;
+        }
+        return what;
+    }
+
+    CTB_Error error_;
+    std::string message_;
+    bool recorded_;
+};
+
+/**
+ * \brief Throw the most recent recorded error as ctb::Error. The errors stay
+ * recorded, so the handler can still log the traceback before clearing them.
+ */
+inline void throw_if_error()
+{
+    if (!ctb_check_error()) CTB_CXX_LIKELY
+    {
+        return;
+    }
+
+    const char *message = nullptr;
+    const CTB_Error error = ctb_get_last_error(&message);
+    throw Error(error, message, true);
+}
+
+/**
+ * \brief Record the exception being handled as a C Traceback error. Must be called
+ * from a catch block.
+ *
+ * \param[in] file File where the exception is caught.
+ * \param[in] line Line number where the exception is caught.
+ * \param[in] func Function name where the exception is caught.
+ */
+inline void record_current_exception(
+    const char *file, const int line, const char *func
+) noexcept
+{
+    try
+    {
+        throw;
+    }
+    catch (const Error &e)
+    {
+        if (!e.recorded())
+        {
+            ctb_throw_error(e.error(), file, line, func, e.message());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        ctb_throw_error(CTB_RUNTIME_ERROR, file, line, func, e.what());
+    }
+    catch (...)
+    {
+        ctb_throw_error(CTB_UNKNOWN_ERROR, file, line, func, "Unknown C++ exception");
+    }
+}
+
+} // namespace ctb
+
+/**
+ * \brief Declare a constexpr call site descriptor named by the first argument.
+ */
+#define CTB_CXX_SITE_(name, source_code)                                               \
+    static constexpr CTB_Frame name = {__LINE__, __FILE__, __func__, source_code}
+
+/**
+ * \brief Trace the rest of the enclosing scope as a call stack frame.
+ */
+#define CTB_TRACE_SCOPE()                                                              \
+    CTB_CXX_SITE_(ctb_scope_site_, "<Scope>");                                         \
+    const ::ctb::FrameGuard ctb_scope_guard_(ctb_scope_site_)
+
+/**
+ * \brief Throw an error both into the C Traceback context and as ctb::Error.
+ *
+ * \param[in] ctb_error The error type.
+ * \param[in] msg Error message.
+ */
+#define CTB_THROW_CXX(ctb_error, msg)                                                  \
+    do                                                                                 \
+    {                                                                                  \
+        THROW(ctb_error, msg);                                                         \
+        ::ctb::throw_if_error();                                                       \
+    } while (0)
+
+/**
+ * \brief Run an expression, recording any escaping C++ exception as a C Traceback
+ * error, e.g. at the boundary of a callback called from C.
+ *
+ * \param[in] expr The expression to be traced.
+ */
+#define CTB_CATCH_CXX(expr)                                                            \
+    do                                                                                 \
+    {                                                                                  \
+        try                                                                            \
+        {                                                                              \
+            TRACE(expr);                                                               \
+        }                                                                              \
+        catch (...)                                                                    \
+        {                                                                              \
+            ::ctb::record_current_exception(__FILE__, __LINE__, __func__);             \
+        }                                                                              \
+    } while (0)
+
+/* Exception-safe versions of the tracing macros of trace.h and timing.h */
+#undef TRACE
+#undef TRACE_BLOCK
+#undef TRY
+#undef TRY_GOTO
+#undef TRY_CATCH
+#undef TRY_BLOCK_GOTO
+#undef TRACE_TIMED
+
+#define TRACE(expr)                                                                    \
+    do                                                                                 \
+    {                                                                                  \
+        CTB_CXX_SITE_(ctb_site_, #expr);                                               \
+        const ::ctb::FrameGuard ctb_guard_(ctb_site_);                                 \
+        (expr);                                                                        \
+    } while (0)
+
+#define TRACE_TIMED(expr)                                                              \
+    do                                                                                 \
+    {                                                                                  \
+        CTB_CXX_SITE_(ctb_site_, #expr);                                               \
+        const ::ctb::FrameGuard ctb_guard_(ctb_site_);                                 \
+        const ::ctb::TimingGuard ctb_timing_guard_(ctb_site_);                         \
+        (expr);                                                                        \
+    } while (0)
+
+#define TRACE_BLOCK(...)                                                               \
+    do                                                                                 \
+    {                                                                                  \
+        CTB_CXX_SITE_(ctb_site_, #__VA_ARGS__);                                        \
+        const ::ctb::FrameGuard ctb_guard_(ctb_site_);                                 \
+        __VA_ARGS__                                                                    \
+    } while (0)
+
+#define TRY(expr)                                                                      \
+    (::ctb::FrameGuard(CTB_Frame{__LINE__, __FILE__, __func__, #expr}),                \
+     (expr),                                                                           \
+     !ctb_check_error())
+
+#define TRY_GOTO(expr, label)                                                          \
+    do                                                                                 \
+    {                                                                                  \
+        {                                                                              \
+            CTB_CXX_SITE_(ctb_site_, #expr);                                           \
+            const ::ctb::FrameGuard ctb_guard_(ctb_site_);                             \
+            (expr);                                                                    \
+        }                                                                              \
+        if (ctb_check_error()) CTB_CXX_UNLIKELY                                        \
+        {                                                                              \
+            goto label;                                                                \
+        }                                                                              \
+    } while (0)
+
+#define TRY_CATCH(expr, base, label)                                                   \
+    do                                                                                 \
+    {                                                                                  \
+        {                                                                              \
+            CTB_CXX_SITE_(ctb_site_, #expr);                                           \
+            const ::ctb::FrameGuard ctb_guard_(ctb_site_);                             \
+            (expr);                                                                    \
+        }                                                                              \
+        if (ctb_check_error_is_a(base)) CTB_CXX_UNLIKELY                               \
+        {                                                                              \
+            goto label;                                                                \
+        }                                                                              \
+    } while (0)
+
+#define TRY_BLOCK_GOTO(label, ...)                                                     \
+    do                                                                                 \
+    {                                                                                  \
+        {                                                                              \
+            CTB_CXX_SITE_(ctb_site_, #__VA_ARGS__);                                    \
+            const ::ctb::FrameGuard ctb_guard_(ctb_site_);                             \
+            __VA_ARGS__                                                                \
+        }                                                                              \
+        if (ctb_check_error()) CTB_CXX_UNLIKELY                                        \
+        {                                                                              \
+            goto label;                                                                \
+        }                                                                              \
+    } while (0)
+
+#endif /* C_TRACEBACK_HPP */
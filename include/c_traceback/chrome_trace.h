@@ -0,0 +1,47 @@
+/**
+ * \file chrome_trace.h
+ * \brief Header file for exporting traced call stack spans as Chrome trace events.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_CHROME_TRACE_H
+#define C_TRACEBACK_CHROME_TRACE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Start recording call stack spans in Chrome Trace Event format.
+ *
+ * While recording, every pushed and popped call stack frame emits a begin / end
+ * event into a per-thread buffer, and every thrown error emits an instant event.
+ * The output file can be opened with chrome://tracing or https://ui.perfetto.dev.
+ *
+ * \param[in] path Path of the JSON file to write.
+ * \return true if recording has been started, false otherwise.
+ */
+bool ctb_chrome_trace_start(const char *path);
+
+/**
+ * \brief Write the buffered events of all threads to the trace file.
+ *
+ * Threads keep recording while events are flushed. Call it periodically for long
+ * recordings, since events are dropped when a per-thread buffer is full.
+ */
+void ctb_chrome_trace_flush(void);
+
+/**
+ * \brief Stop recording, flush all buffered events and close the trace file.
+ */
+void ctb_chrome_trace_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_CHROME_TRACE_H */
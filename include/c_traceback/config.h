@@ -0,0 +1,100 @@
+/**
+ * \file config.h
+ * \brief Header file for runtime configuration of C Traceback.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_CONFIG_H
+#define C_TRACEBACK_CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Allocator hooks for all memory owned by the library. Either set all three
+ * functions, or leave every function NULL to use the built-in pool allocator.
+ */
+typedef struct CTB_Allocator
+{
+    void *(*malloc_fn)(size_t size, void *user_data);
+    void *(*realloc_fn)(void *ptr, size_t size, void *user_data);
+    void (*free_fn)(void *ptr, void *user_data);
+    void *user_data;
+} CTB_Allocator;
+
+/**
+ * \brief Which errors are stored once more errors are pending than max_num_errors.
+ * The others are only counted as truncated.
+ */
+typedef enum CTB_Retention_Policy
+{
+    /* Keep the first errors and drop the new ones */
+    CTB_RETAIN_FIRST = 0,
+
+    /* Keep the most recent errors, overwriting the oldest ones in a ring */
+    CTB_RETAIN_LAST,
+
+    /* Keep one error per error code and throw site, counting its repetitions. A
+       repeated error becomes the most recent error again, but does not change the
+       number of errors, see CTB_Error_View.count. */
+    CTB_RETAIN_SAMPLE
+} CTB_Retention_Policy;
+
+/**
+ * \brief Runtime configuration of C Traceback. The limits size the call stack and
+ * error storage that is allocated for each thread on its first use of the library.
+ *
+ * The emergency reserve is allocated up front and only used when the allocator
+ * fails. Crash paths do not allocate, they render into buffers on the stack.
+ */
+typedef struct CTB_Config
+{
+    int max_call_stack_depth;
+    int max_num_errors;
+    int max_error_message_length;
+    CTB_Allocator allocator;
+    size_t emergency_reserve_size;
+    CTB_Retention_Policy retention_policy;
+} CTB_Config;
+
+/**
+ * \brief Get the default configuration, i.e. the compile-time defaults
+ * CTB_MAX_CALL_STACK_DEPTH, CTB_MAX_NUM_ERROR, CTB_MAX_ERROR_MESSAGE_LENGTH and
+ * CTB_EMERGENCY_RESERVE_SIZE with the built-in pool allocator, keeping the first
+ * errors.
+ *
+ * \return The default configuration.
+ */
+CTB_Config ctb_default_config(void);
+
+/**
+ * \brief Initialize C Traceback with the given configuration.
+ *
+ * Calling this function is optional. It must be called before any thread uses the
+ * library, since the storage of every thread is sized with the same limits and
+ * comes from the same allocator.
+ *
+ * \param[in] config The configuration, or NULL for the default configuration.
+ * \return true if the configuration has been applied, false if it is invalid or
+ * memory has already been allocated.
+ */
+bool ctb_init(const CTB_Config *config);
+
+/**
+ * \brief Get the active configuration.
+ *
+ * \return Pointer to the active configuration.
+ */
+const CTB_Config *ctb_get_config(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_CONFIG_H */
@@ -0,0 +1,60 @@
+/**
+ * \file context.h
+ * \brief Header file for per-task contexts used by fiber and coroutine schedulers.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_CONTEXT_H
+#define C_TRACEBACK_CONTEXT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Call stack and recorded errors of a thread or a task.
+ *
+ * Every thread has its own context. Tasks that share a thread (fibers, coroutines)
+ * can each own a context and switch it in while they run, so that they keep their
+ * own logical call stack across context switches.
+ */
+typedef struct CTB_Context CTB_Context;
+
+/**
+ * \brief Create a context for a task.
+ *
+ * \return Pointer to the new context, or NULL on allocation failure.
+ */
+CTB_Context *ctb_context_create(void);
+
+/**
+ * \brief Destroy a context created with ctb_context_create. The context must not be
+ * active on any thread.
+ *
+ * \param[in] context The context. NULL is ignored.
+ */
+void ctb_context_destroy(CTB_Context *context);
+
+/**
+ * \brief Make a context the active context of the calling thread, e.g. when a fiber
+ * scheduler resumes a task. This only swaps a pointer.
+ *
+ * \param[in] context The context to activate, or NULL for the thread's own context.
+ * \return The previously active context, or NULL if it was the thread's own context.
+ */
+CTB_Context *ctb_context_switch(CTB_Context *context);
+
+/**
+ * \brief Get the active context of the calling thread.
+ *
+ * \return The active context, or NULL if it is the thread's own context.
+ */
+CTB_Context *ctb_context_current(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_CONTEXT_H */
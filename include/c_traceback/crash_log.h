@@ -0,0 +1,49 @@
+/**
+ * \file crash_log.h
+ * \brief Header file for the memory-mapped crash log.
+ *
+ * The crash log is a file mapped into memory with shared write-back, into which
+ * thrown errors, inline logs and fatal signals are appended as compact records.
+ * The mapped pages belong to the operating system, so the most recent records
+ * survive a SIGKILL or an out-of-memory kill, which no signal handler can catch.
+ * Read the file after a crash with the ctb_crash_decode tool.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_CRASH_LOG_H
+#define C_TRACEBACK_CRASH_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Map a crash log file and start recording into it.
+ *
+ * An existing crash log with the same number of records is appended to, so that
+ * the records of a killed process are kept after a restart. Otherwise the file is
+ * created or overwritten.
+ *
+ * \param[in] path Path of the crash log file.
+ * \param[in] num_records Number of records kept in the ring, or 0 for
+ * CTB_CRASH_LOG_NUM_RECORDS.
+ * \return true if recording has been started, false otherwise.
+ */
+bool ctb_crash_log_open(const char *path, const size_t num_records);
+
+/**
+ * \brief Stop recording and unmap the crash log. No thread may be logging while it
+ * is closed.
+ */
+void ctb_crash_log_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_CRASH_LOG_H */
@@ -8,7 +8,16 @@
 #ifndef C_TRACEBACK_ERROR_H
 #define C_TRACEBACK_ERROR_H
 
+#include <errno.h>
+#include <stdint.h>
+
 #include "c_traceback/error_codes.h"
+#include "c_traceback/trace.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
 
 /**
  * \brief Wrapper for throwing an error with the current call stack.
@@ -38,6 +47,27 @@
         );                                                                             \
     } while (0)
 
+/**
+ * \brief Wrapper for throwing an error after a failed system call, recording errno
+ * with the current call stack.
+ *
+ * The error is refined to the error matching errno if it is a subclass of ctb_error,
+ * see ctb_error_from_errno, e.g. CTB_OS_ERROR becomes CTB_FILE_NOT_FOUND_ERROR for
+ * ENOENT. The description of errno is only looked up when the error is printed, as
+ * "[Errno 2] No such file or directory: <message>".
+ *
+ * \param[in] ctb_error The error type, e.g. CTB_OS_ERROR.
+ * \param[in] ... The format string of the message and its arguments.
+ */
+#define THROW_ERRNO(ctb_error, ...)                                                    \
+    do                                                                                 \
+    {                                                                                  \
+        const int ctb_errno_ = errno;                                                  \
+        ctb_throw_errno(                                                               \
+            ctb_error, ctb_errno_, __FILE__, __LINE__, __func__, __VA_ARGS__           \
+        );                                                                             \
+    } while (0)
+
 /**
  * \brief Throw an error with the current call stack.
  *
@@ -50,10 +80,10 @@
  */
 void ctb_throw_error(
     CTB_Error error,
-    const char *restrict file,
+    const char *CTB_RESTRICT file,
     const int line,
-    const char *restrict func,
-    const char *restrict msg
+    const char *CTB_RESTRICT func,
+    const char *CTB_RESTRICT msg
 );
 
 /**
@@ -68,10 +98,33 @@ void ctb_throw_error(
  */
 void ctb_throw_error_fmt(
     CTB_Error error,
-    const char *restrict file,
+    const char *CTB_RESTRICT file,
+    const int line,
+    const char *CTB_RESTRICT func,
+    const char *CTB_RESTRICT msg,
+    ...
+);
+
+/**
+ * \brief Throw an error with formatted message and an errno value with the current
+ * call stack.
+ *
+ * \param[in] error The error type, refined by ctb_error_from_errno if the matching
+ * error is a subclass of it.
+ * \param[in] os_errno The errno value.
+ * \param[in] file File where the message is sent.
+ * \param[in] line Line number where the message is sent.
+ * \param[in] func Function where the message is sent.
+ * \param[in] msg Error message.
+ * \param[in] ... Additional arguments for formatting the message.
+ */
+void ctb_throw_errno(
+    CTB_Error error,
+    const int os_errno,
+    const char *CTB_RESTRICT file,
     const int line,
-    const char *restrict func,
-    const char *restrict msg,
+    const char *CTB_RESTRICT func,
+    const char *CTB_RESTRICT msg,
     ...
 );
 
@@ -82,9 +135,114 @@ void ctb_throw_error_fmt(
  */
 bool ctb_check_error(void);
 
+/**
+ * \brief Get the most recent recorded error.
+ *
+ * \param[out] message If not NULL, set to the message of the error, which stays valid
+ * until the errors are cleared.
+ * \return The most recent recorded error, or CTB_SUCCESS if no error has occurred.
+ */
+CTB_Error ctb_get_last_error(const char **message);
+
+/**
+ * \brief Check if the most recent error is a base error or one of its descendants.
+ * The most recently thrown error is matched even if it has not been stored because
+ * too many errors occurred.
+ *
+ * \param[in] base The base error type.
+ * \return true if an error has occurred and matches base, false otherwise.
+ */
+bool ctb_check_error_is_a(const CTB_Error base);
+
+/**
+ * \brief Handle the most recent error if it is a base error or one of its
+ * descendants. Earlier and non-matching errors are left pending.
+ *
+ * If errors have been truncated, the number of errors drops by one but the stored
+ * errors are kept, so the traceback may still show the handled error, and the
+ * error before it is CTB_UNKNOWN_ERROR until a new error is thrown.
+ *
+ * \param[in] base The base error type.
+ * \return true if the error has been handled, false otherwise.
+ */
+bool ctb_catch_error(const CTB_Error base);
+
+/**
+ * \brief Read-only view of a pending error. It points into the error storage of the
+ * thread and stays valid until the next error is thrown or the errors are changed.
+ */
+typedef struct CTB_Error_View
+{
+    CTB_Error error;
+    const char *message;
+
+    /* Location where the error was thrown */
+    const CTB_Frame *throw_site;
+
+    /* Call stack when the error was thrown, outermost frame first */
+    const CTB_Frame *frames;
+    int num_frames;
+
+    /* Depth of the call stack, which exceeds num_frames if frames were dropped */
+    int call_depth;
+
+    /* Number of errors thrown at the same site, above 1 only with CTB_RETAIN_SAMPLE */
+    int count;
+
+    /* Hash of the file, function and line of every frame and of the throw site. It
+       is equal for the same call stack in every process running the same build. */
+    uint64_t signature;
+
+    /* Value of errno recorded by THROW_ERRNO, 0 for other errors */
+    int os_errno;
+} CTB_Error_View;
+
+/**
+ * \brief Get the number of pending errors that can be viewed. Errors beyond the
+ * configured maximum are counted but not stored, see CTB_Retention_Policy.
+ *
+ * \return The number of stored pending errors.
+ */
+int ctb_get_num_errors(void);
+
+/**
+ * \brief View a pending error without copying it.
+ *
+ * \param[in] index The index of the error, from 0 for the oldest to
+ * ctb_get_num_errors() - 1 for the most recent.
+ * \param[out] view The view of the error.
+ * \return false if the index is out of range.
+ */
+bool ctb_get_error_view(const int index, CTB_Error_View *view);
+
+/**
+ * \brief Discard a pending error, keeping the order of the others.
+ *
+ * It is refused while errors are truncated, since the error taking its place was not
+ * stored.
+ *
+ * \param[in] index The index of the error, as for ctb_get_error_view.
+ * \return true if the error has been discarded, false otherwise.
+ */
+bool ctb_discard_error(const int index);
+
+/**
+ * \brief Remove the most recent pending error and view it. The view stays valid until
+ * the next error is thrown.
+ *
+ * \param[out] view If not NULL, set to the view of the removed error.
+ * \return true if an error has been removed, false if there is none or errors are
+ * truncated.
+ */
+bool ctb_pop_error(CTB_Error_View *view);
+
 /**
  * \brief Clear all recorded errors.
  */
 void ctb_clear_error(void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // C_TRACEBACK_ERROR_H
\ No newline at end of file
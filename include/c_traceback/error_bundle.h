@@ -0,0 +1,83 @@
+/**
+ * \file error_bundle.h
+ * \brief Header file for propagating errors across threads.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_ERROR_BUNDLE_H
+#define C_TRACEBACK_ERROR_BUNDLE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Errors of a task moved out of the thread that ran it, together with the
+ * call stack of the thread that submitted the task.
+ *
+ * A bundle is used by one thread at a time, so handing it over between threads
+ * needs the same synchronization as the task itself (e.g. a queue or a join).
+ */
+typedef struct CTB_Error_Bundle CTB_Error_Bundle;
+
+/**
+ * \brief Wrapper for creating an error bundle at the spawn site of a task.
+ *
+ * \return Pointer to the new error bundle, or NULL on allocation failure.
+ */
+#define CTB_ERROR_BUNDLE_CREATE()                                                      \
+    ctb_error_bundle_create(__FILE__, __func__, __LINE__)
+
+/**
+ * \brief Create an error bundle, recording the call stack of the calling thread and
+ * the spawn site as the frames leading to the errors of the task.
+ *
+ * \param[in] file File where the task is spawned.
+ * \param[in] func Function name where the task is spawned.
+ * \param[in] line Line number where the task is spawned.
+ * \return Pointer to the new error bundle, or NULL on allocation failure.
+ */
+CTB_Error_Bundle *
+ctb_error_bundle_create(const char *file, const char *func, const int line);
+
+/**
+ * \brief Move the errors of the calling thread into the bundle. The errors of the
+ * calling thread are cleared. This is O(1) when the bundle holds no errors yet.
+ *
+ * \param[in,out] bundle The error bundle. NULL is ignored.
+ */
+void ctb_error_bundle_capture(CTB_Error_Bundle *bundle);
+
+/**
+ * \brief Check if the bundle holds any error.
+ *
+ * \param[in] bundle The error bundle. NULL holds no error.
+ * \return true if the bundle holds an error, false otherwise.
+ */
+bool ctb_error_bundle_has_error(const CTB_Error_Bundle *bundle);
+
+/**
+ * \brief Move the errors of the bundle into the calling thread, prepending the
+ * spawn frames to their call stacks. This is O(1) apart from shifting the frames
+ * when the calling thread holds no errors yet.
+ *
+ * \param[in,out] bundle The error bundle. NULL is ignored.
+ */
+void ctb_error_bundle_raise(CTB_Error_Bundle *bundle);
+
+/**
+ * \brief Destroy an error bundle and discard any errors it still holds.
+ *
+ * \param[in] bundle The error bundle. NULL is ignored.
+ */
+void ctb_error_bundle_destroy(CTB_Error_Bundle *bundle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_ERROR_BUNDLE_H */
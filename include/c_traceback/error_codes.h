@@ -8,6 +8,27 @@
 #ifndef C_TRACEBACK_ERROR_CODES_H
 #define C_TRACEBACK_ERROR_CODES_H
 
+#include <stdbool.h>
+
+/**
+ * \brief The C99 restrict qualifier of the public declarations, which C++ only
+ * provides as an extension.
+ */
+#ifndef CTB_RESTRICT
+#ifndef __cplusplus
+#define CTB_RESTRICT restrict
+#elif defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define CTB_RESTRICT __restrict
+#else
+#define CTB_RESTRICT
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
 /**
     C Traceback Error Hierarchy:
 
@@ -156,7 +177,8 @@ typedef enum CTB_Error
     CTB_DYNAMIC_LINK_ERROR = 900,
     CTB_LIBRARY_LOAD_ERROR,
 
-    /* --- 1000+: application-specific --- */
+    /* --- 1000+: application-specific, see ctb_register_error --- */
+    CTB_CUSTOM_ERROR_BASE = 1000
 
 } CTB_Error;
 
@@ -176,6 +198,88 @@ typedef enum CTB_Warning
     CTB_USER_WARNING
 } CTB_Warning;
 
+/**
+ * \brief Default severity of an error.
+ */
+typedef enum CTB_Severity
+{
+    CTB_SEVERITY_ERROR = 0,
+    CTB_SEVERITY_WARNING,
+    CTB_SEVERITY_CRITICAL
+} CTB_Severity;
+
+/**
+ * \brief Register the name and position in the hierarchy of an application-defined
+ * error code. Registered codes are rendered like built-in ones.
+ *
+ * Registration takes a lock, while lookups are lock-free and may run concurrently.
+ * A code cannot be registered twice.
+ *
+ * \param[in] code The error code, from CTB_CUSTOM_ERROR_BASE to
+ * CTB_CUSTOM_ERROR_BASE + CTB_MAX_CUSTOM_ERRORS - 1.
+ * \param[in] name The name of the error, e.g. "ConfigError". It is copied and
+ * truncated to CTB_MAX_ERROR_NAME_LENGTH - 1 characters.
+ * \param[in] parent The parent error, which must be a built-in or already registered
+ * code, or CTB_SUCCESS for CTB_ERROR.
+ * \param[in] severity The default severity of the error.
+ * \return false if the code is out of range or already registered, or if the parent
+ * is unknown.
+ */
+bool ctb_register_error(
+    const CTB_Error code,
+    const char *name,
+    const CTB_Error parent,
+    const CTB_Severity severity
+);
+
+/**
+ * \brief Get the parent of an error in the hierarchy.
+ *
+ * \param[in] error The error type.
+ * \return The parent error, or CTB_SUCCESS for CTB_ERROR and unknown codes.
+ */
+CTB_Error ctb_get_error_parent(const CTB_Error error);
+
+/**
+ * \brief Check whether an error is a base error or one of its descendants, e.g.
+ * CTB_FILE_NOT_FOUND_ERROR is a CTB_OS_ERROR and a CTB_ERROR.
+ *
+ * The ancestors of registered errors are precomputed, so the check takes constant
+ * time and no lock.
+ *
+ * \param[in] error The error type.
+ * \param[in] base The base error type.
+ * \return true if error is base or descends from it.
+ */
+bool ctb_error_is_a(const CTB_Error error, const CTB_Error base);
+
+/**
+ * \brief Map an errno value to the matching error, following the subclasses of
+ * OSError in Python, e.g. ENOENT to CTB_FILE_NOT_FOUND_ERROR and EACCES or EPERM to
+ * CTB_PERMISSION_ERROR. Connection and unreachable host errors map to network
+ * errors, and ENOMEM to CTB_OUT_OF_MEMORY_ERROR.
+ *
+ * \param[in] os_errno The errno value.
+ * \return The matching error, or CTB_OS_ERROR for other values.
+ */
+CTB_Error ctb_error_from_errno(const int os_errno);
+
+/**
+ * \brief Get the default severity of an error.
+ *
+ * \param[in] error The error type.
+ * \return The severity. Signal errors are critical, unknown codes are errors.
+ */
+CTB_Severity ctb_get_error_severity(const CTB_Error error);
+
+/**
+ * \brief Convert a severity to its string representation.
+ *
+ * \param[in] severity The severity.
+ * \return "error", "warning" or "critical".
+ */
+const char *severity_to_string(const CTB_Severity severity);
+
 /**
  * \brief Convert error type to its corresponding string representation.
  *
@@ -192,4 +296,8 @@ const char *error_to_string(CTB_Error error);
  */
 const char *warning_to_string(CTB_Warning warning);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* C_TRACEBACK_ERROR_CODES_H */
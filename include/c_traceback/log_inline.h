@@ -10,6 +10,11 @@
 
 #include "c_traceback/error_codes.h"
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
 /**
  * \brief Wrapper for logging an error to stderr without stacktrace.
  *
@@ -99,11 +104,11 @@
  * \param[in] msg Error message.
  */
 void ctb_log_error_inline(
-    const char *restrict file,
+    const char *CTB_RESTRICT file,
     const int line,
-    const char *restrict func,
+    const char *CTB_RESTRICT func,
     const CTB_Error error,
-    const char *restrict msg
+    const char *CTB_RESTRICT msg
 );
 
 /**
@@ -116,11 +121,11 @@ void ctb_log_error_inline(
  * \param[in] msg Warning message.
  */
 void ctb_log_warning_inline(
-    const char *restrict file,
+    const char *CTB_RESTRICT file,
     const int line,
-    const char *restrict func,
+    const char *CTB_RESTRICT func,
     const CTB_Warning warning,
-    const char *restrict msg
+    const char *CTB_RESTRICT msg
 );
 
 /**
@@ -132,10 +137,10 @@ void ctb_log_warning_inline(
  * \param[in] msg Message.
  */
 void ctb_log_message_inline(
-    const char *restrict file,
+    const char *CTB_RESTRICT file,
     const int line,
-    const char *restrict func,
-    const char *restrict msg
+    const char *CTB_RESTRICT func,
+    const char *CTB_RESTRICT msg
 );
 
 /**
@@ -149,11 +154,11 @@ void ctb_log_message_inline(
  * \param[in] ... Additional arguments for formatting the message.
  */
 void ctb_log_error_inline_fmt(
-    const char *restrict file,
+    const char *CTB_RESTRICT file,
     const int line,
-    const char *restrict func,
+    const char *CTB_RESTRICT func,
     const CTB_Error error,
-    const char *restrict msg,
+    const char *CTB_RESTRICT msg,
     ...
 );
 
@@ -168,11 +173,11 @@ void ctb_log_error_inline_fmt(
  * \param[in] ... Additional arguments for formatting the message.
  */
 void ctb_log_warning_inline_fmt(
-    const char *restrict file,
+    const char *CTB_RESTRICT file,
     const int line,
-    const char *restrict func,
+    const char *CTB_RESTRICT func,
     const CTB_Warning warning,
-    const char *restrict msg,
+    const char *CTB_RESTRICT msg,
     ...
 );
 
@@ -186,11 +191,15 @@ void ctb_log_warning_inline_fmt(
  * \param[in] ... Additional arguments for formatting the message.
  */
 void ctb_log_message_inline_fmt(
-    const char *restrict file,
+    const char *CTB_RESTRICT file,
     const int line,
-    const char *restrict func,
-    const char *restrict msg,
+    const char *CTB_RESTRICT func,
+    const char *CTB_RESTRICT msg,
     ...
 );
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // C_TRACEBACK_LOG_INLINE_H
\ No newline at end of file
@@ -0,0 +1,67 @@
+/**
+ * \file output_format.h
+ * \brief Header file for selecting the output format of each stream.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_OUTPUT_FORMAT_H
+#define C_TRACEBACK_OUTPUT_FORMAT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Output formats of tracebacks and inline logs.
+ *
+ * In the JSON Lines format every error of a traceback and every inline log is
+ * written as one JSON object per line, e.g.
+ *
+ * {"type":"traceback","index":0,"name":"ValueError","code":4,"message":"...",
+ *  "count":1,"frames":[{"file":"main.c","line":10,"function":"main",
+ *  "source":"f()"}]}
+ * {"type":"error","name":"ValueError","code":4,"file":"main.c","line":12,
+ *  "function":"main","message":"..."}
+ *
+ * The type of an inline log is "error", "warning" or "message", and messages have
+ * no name and code. The last frame of a traceback is the frame that raised the
+ * error, and "skipped_frames" counts the frames that exceed the maximum depth.
+ * "count" is the number of occurrences of a sampled or grouped error, and
+ * "signature" is CTB_Error_View.signature in 16 hexadecimal digits. Errors thrown
+ * by THROW_ERRNO also have "errno" and its description "strerror".
+ */
+typedef enum CTB_Output_Format
+{
+    CTB_OUTPUT_TEXT = 0,
+    CTB_OUTPUT_JSON_LINES
+} CTB_Output_Format;
+
+/**
+ * \brief Set the output format of a stream, e.g. stderr for tracebacks and error
+ * logs, or stdout for messages. Streams default to CTB_OUTPUT_TEXT.
+ *
+ * \param[in] stream The output stream.
+ * \param[in] format The output format.
+ * \return true on success, false if the arguments are invalid or more than
+ * CTB_MAX_OUTPUT_STREAMS streams have been configured.
+ */
+bool ctb_set_output_format(FILE *stream, const CTB_Output_Format format);
+
+/**
+ * \brief Get the output format of a stream.
+ *
+ * \param[in] stream The output stream.
+ * \return The output format.
+ */
+CTB_Output_Format ctb_get_output_format(FILE *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_OUTPUT_FORMAT_H */
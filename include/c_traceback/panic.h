@@ -0,0 +1,134 @@
+/**
+ * \file panic.h
+ * \brief Header file for assertions and panics on broken invariants.
+ *
+ * CTB_ASSERT throws a recoverable error like THROW when its condition is false,
+ * while CTB_PANIC prints the traceback and aborts. On the success path an assertion
+ * is a single branch predicted not taken, since the failure is handled by a cold
+ * function that is never inlined.
+ *
+ * Like assert, CTB_ASSERT is only checked if NDEBUG is not defined. Define
+ * CTB_ASSERT_ALWAYS (or configure with -DCTB_ASSERT_ALWAYS=ON) to check it in
+ * every build. CTB_PANIC is never compiled out.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_PANIC_H
+#define C_TRACEBACK_PANIC_H
+
+#include "c_traceback/error_codes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Branch and function attributes of the assertion macros */
+#if defined(__GNUC__) || defined(__clang__)
+#define CTB_UNLIKELY_(cond) __builtin_expect(!!(cond), 0)
+#define CTB_COLD_ __attribute__((cold, noinline))
+#define CTB_NORETURN_ __attribute__((noreturn))
+#elif defined(_MSC_VER)
+#define CTB_UNLIKELY_(cond) (cond)
+#define CTB_COLD_ __declspec(noinline)
+#define CTB_NORETURN_ __declspec(noreturn)
+#else
+#define CTB_UNLIKELY_(cond) (cond)
+#define CTB_COLD_
+#define CTB_NORETURN_
+#endif
+
+/**
+ * \brief Throw an error with the current call stack if a condition is false. The
+ * message states the condition, followed by the formatted message.
+ *
+ * Like THROW, a failed assertion does not leave the function, so the caller must
+ * return before relying on the condition, e.g. with ctb_check_error().
+ *
+ * \param[in] cond The condition, not evaluated if assertions are disabled.
+ * \param[in] ctb_error The error type.
+ * \param[in] ... The format string of the message and its arguments.
+ */
+#if defined(NDEBUG) && !defined(CTB_ASSERT_ALWAYS)
+#define CTB_ASSERT(cond, ctb_error, ...)                                               \
+    do                                                                                 \
+    {                                                                                  \
+        (void)sizeof(!(cond));                                                         \
+    } while (0)
+#else
+#define CTB_ASSERT(cond, ctb_error, ...)                                               \
+    do                                                                                 \
+    {                                                                                  \
+        if (CTB_UNLIKELY_(!(cond)))                                                    \
+        {                                                                              \
+            ctb_assert_failed(                                                         \
+                ctb_error, __FILE__, __LINE__, __func__, #cond, __VA_ARGS__            \
+            );                                                                         \
+        }                                                                              \
+    } while (0)
+#endif
+
+/**
+ * \brief Print the traceback of the recorded errors and of the current call stack,
+ * then abort. The traceback is printed by the async-signal-safe renderer of crash
+ * tracebacks, which allocates no memory and takes no lock.
+ *
+ * All stdio streams are flushed first, so that buffered output is not lost. This
+ * takes the stream locks, so CTB_PANIC is not async-signal-safe and must not be
+ * used while a stream lock is held, e.g. in a signal handler or in a sink writing
+ * to a FILE. The message is cut at CTB_MAX_ERROR_MESSAGE_LENGTH, since no memory
+ * is allocated for it.
+ *
+ * \param[in] ctb_error The error type.
+ * \param[in] ... The format string of the message and its arguments.
+ */
+#define CTB_PANIC(ctb_error, ...)                                                      \
+    ctb_panic(ctb_error, __FILE__, __LINE__, __func__, __VA_ARGS__)
+
+/**
+ * \brief Throw the error of a failed assertion.
+ *
+ * \param[in] error The error type.
+ * \param[in] file File of the assertion.
+ * \param[in] line Line number of the assertion.
+ * \param[in] func Function of the assertion.
+ * \param[in] condition The text of the condition.
+ * \param[in] msg The format string of the message.
+ * \param[in] ... Additional arguments for formatting the message.
+ */
+CTB_COLD_ void ctb_assert_failed(
+    CTB_Error error,
+    const char *CTB_RESTRICT file,
+    const int line,
+    const char *CTB_RESTRICT func,
+    const char *CTB_RESTRICT condition,
+    const char *CTB_RESTRICT msg,
+    ...
+);
+
+/**
+ * \brief Print the traceback with a final error at the current call stack and
+ * abort.
+ *
+ * \param[in] error The error type.
+ * \param[in] file File of the panic.
+ * \param[in] line Line number of the panic.
+ * \param[in] func Function of the panic.
+ * \param[in] msg The format string of the message.
+ * \param[in] ... Additional arguments for formatting the message.
+ */
+CTB_COLD_ CTB_NORETURN_ void ctb_panic(
+    CTB_Error error,
+    const char *CTB_RESTRICT file,
+    const int line,
+    const char *CTB_RESTRICT func,
+    const char *CTB_RESTRICT msg,
+    ...
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_PANIC_H */
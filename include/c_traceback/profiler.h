@@ -0,0 +1,55 @@
+/**
+ * \file profiler.h
+ * \brief Header file for the sampling profiler driven by the traced call stack.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_PROFILER_H
+#define C_TRACEBACK_PROFILER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Start sampling the traced call stack of running threads.
+ *
+ * A profiling timer interrupts the running thread at the given frequency, and the
+ * call stack frames pushed by the tracing macros are aggregated into a per-thread
+ * table of folded stacks. Samples keep accumulating across start / stop cycles until
+ * ctb_profiler_reset is called.
+ *
+ * \param[in] frequency_hz Number of samples per second of CPU time.
+ * \return true if the profiler has been started, false otherwise.
+ */
+bool ctb_profiler_start(const int frequency_hz);
+
+/**
+ * \brief Stop sampling and restore the previous SIGPROF handler.
+ */
+void ctb_profiler_stop(void);
+
+/**
+ * \brief Discard all recorded samples. Must be called while the profiler is stopped.
+ */
+void ctb_profiler_reset(void);
+
+/**
+ * \brief Write the recorded samples in the folded stack format understood by
+ * flamegraph.pl and speedscope, i.e. one "frame;frame;frame count" line per stack.
+ *
+ * \param[in] stream The output stream.
+ * \param[in] per_thread Whether to prefix each stack with a frame of its thread.
+ */
+void ctb_profiler_write_folded(FILE *stream, const bool per_thread);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_PROFILER_H */
@@ -8,9 +8,18 @@
 #ifndef C_TRACEBACK_SIGNAL_HANDLER_H
 #define C_TRACEBACK_SIGNAL_HANDLER_H
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
 /**
  * \brief Install signal handlers for C Traceback.
  */
 void ctb_install_signal_handler(void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* C_TRACEBACK_SIGNAL_HANDLER_H */
\ No newline at end of file
@@ -0,0 +1,207 @@
+/**
+ * \file sink.h
+ * \brief Header file for output sinks of tracebacks and inline logs.
+ *
+ * By default tracebacks and inline errors and warnings are written to stderr, and
+ * inline messages to stdout. A sink replaces both destinations, either for the
+ * whole process or for a single thread.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_SINK_H
+#define C_TRACEBACK_SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief A piece of output passed to a sink.
+ */
+typedef struct CTB_Sink_Buffer
+{
+    const char *data;
+    size_t length;
+} CTB_Sink_Buffer;
+
+/**
+ * \brief Destination of the output. Every call to write_fn carries complete lines,
+ * e.g. a whole traceback or a whole inline log. Crash tracebacks written from a
+ * signal handler are passed in pieces of whole lines, except that a line longer
+ * than 2 KB is split.
+ */
+typedef struct CTB_Sink
+{
+    /* Write a vector of buffers, returning false on failure */
+    bool (*write_fn)(void *user_data, const CTB_Sink_Buffer *buffers, int num_buffers);
+
+    /* Flush buffered output, may be NULL */
+    void (*flush_fn)(void *user_data);
+
+    void *user_data;
+
+    /* Whether ANSI colours may be written. NO_COLOR still disables them. */
+    bool color;
+
+    /* Whether write_fn may be called from a signal handler. Otherwise crash
+       tracebacks are written to stderr. */
+    bool async_signal_safe;
+} CTB_Sink;
+
+/**
+ * \brief Set the sink of all threads that have no sink of their own.
+ *
+ * \param[in] sink The sink, or NULL to restore stderr and stdout. It is copied.
+ * \return false if the sink has no write function or cannot be copied.
+ */
+bool ctb_set_sink(const CTB_Sink *sink);
+
+/**
+ * \brief Set the sink of the calling thread, which overrides the global sink.
+ *
+ * \param[in] sink The sink, or NULL to use the global sink again. It is copied.
+ * \return false if the sink has no write function or cannot be copied.
+ */
+bool ctb_set_thread_sink(const CTB_Sink *sink);
+
+/**
+ * \brief Write the output to stderr and stdout, when no sink is set, with direct
+ * write system calls in the order of an in-process queue instead of through stdio.
+ *
+ * Each traceback or inline log is rendered by its thread and then written whole,
+ * so the output of concurrent threads never interleaves. Rendering is not
+ * serialised, only the write system calls are. Outputs of up to PIPE_BUF bytes
+ * are written with a single call, which is also atomic for other processes
+ * writing to the same pipe. While a write blocks on a slow reader, the other
+ * threads wait for it, yielding the CPU in a loop. It is disabled by default.
+ *
+ * \param[in] enabled Whether to enable the atomic output mode.
+ */
+void ctb_set_atomic_output(const bool enabled);
+
+/**
+ * \brief Flush the active sink of the calling thread, or stderr and stdout.
+ */
+void ctb_flush_sink(void);
+
+/**
+ * \brief Create a sink writing to a stdio stream. It is not async-signal-safe.
+ *
+ * \param[in] stream The output stream, which must outlive the sink.
+ * \return The sink.
+ */
+CTB_Sink ctb_file_sink(FILE *stream);
+
+/**
+ * \brief Create a sink writing to a file descriptor with vectored writes, bypassing
+ * stdio. It is async-signal-safe.
+ *
+ * \param[in] fd The file descriptor, which must outlive the sink.
+ * \return The sink.
+ */
+CTB_Sink ctb_fd_sink(const int fd);
+
+/**
+ * \brief In-memory ring buffer keeping the most recent output, e.g. to attach the
+ * last tracebacks to a crash report. Writes are lock-free and async-signal-safe.
+ */
+typedef struct CTB_Ring_Sink CTB_Ring_Sink;
+
+/**
+ * \brief Create a ring buffer sink.
+ *
+ * \param[in] capacity The capacity in bytes.
+ * \return The ring buffer, or NULL on allocation failure.
+ */
+CTB_Ring_Sink *ctb_ring_sink_create(const size_t capacity);
+
+/**
+ * \brief Get the sink writing to a ring buffer.
+ */
+CTB_Sink ctb_ring_sink(CTB_Ring_Sink *ring);
+
+/**
+ * \brief Copy the most recent output of a ring buffer. Output written concurrently
+ * may appear partially.
+ *
+ * \param[in] ring The ring buffer.
+ * \param[out] buffer The output buffer.
+ * \param[in] size The size of the output buffer.
+ * \return The number of bytes copied, not null-terminated.
+ */
+size_t ctb_ring_sink_read(const CTB_Ring_Sink *ring, char *buffer, const size_t size);
+
+/**
+ * \brief Destroy a ring buffer. It must no longer be used by any sink.
+ *
+ * \param[in] ring The ring buffer. NULL is ignored.
+ */
+void ctb_ring_sink_destroy(CTB_Ring_Sink *ring);
+
+/**
+ * \brief Sink sending each write as one datagram to a local syslog socket. Only
+ * available on POSIX systems. It is async-signal-safe.
+ */
+typedef struct CTB_Syslog_Sink CTB_Syslog_Sink;
+
+/**
+ * \brief Connect to a local syslog socket.
+ *
+ * \param[in] socket_path The socket path, or NULL for /dev/log.
+ * \param[in] ident The identifier prefixed to every message, or NULL.
+ * \return The syslog sink, or NULL if the socket is unavailable.
+ */
+CTB_Syslog_Sink *ctb_syslog_sink_create(const char *socket_path, const char *ident);
+
+/**
+ * \brief Get the sink writing to a syslog socket.
+ */
+CTB_Sink ctb_syslog_sink(CTB_Syslog_Sink *syslog_sink);
+
+/**
+ * \brief Close a syslog socket. It must no longer be used by any sink.
+ *
+ * \param[in] syslog_sink The syslog sink. NULL is ignored.
+ */
+void ctb_syslog_sink_destroy(CTB_Syslog_Sink *syslog_sink);
+
+/**
+ * \brief Queue drained into another sink by a background thread, so that logging
+ * threads only copy their output. Writers block while the queue is full.
+ */
+typedef struct CTB_Async_Sink CTB_Async_Sink;
+
+/**
+ * \brief Create an asynchronous queue and start its thread.
+ *
+ * \param[in] target The sink written by the background thread. It is copied.
+ * \param[in] capacity The capacity of the queue in bytes.
+ * \return The queue, or NULL on failure.
+ */
+CTB_Async_Sink *ctb_async_sink_create(const CTB_Sink *target, const size_t capacity);
+
+/**
+ * \brief Get the sink writing to an asynchronous queue. Flushing it waits until the
+ * queue is drained.
+ */
+CTB_Sink ctb_async_sink(CTB_Async_Sink *async_sink);
+
+/**
+ * \brief Drain an asynchronous queue, stop its thread and destroy it. It must no
+ * longer be used by any sink.
+ *
+ * \param[in] async_sink The queue. NULL is ignored.
+ */
+void ctb_async_sink_destroy(CTB_Async_Sink *async_sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_SINK_H */
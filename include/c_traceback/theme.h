@@ -0,0 +1,64 @@
+/**
+ * \file theme.h
+ * \brief Header file for colour themes of the traceback output.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_THEME_H
+#define C_TRACEBACK_THEME_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief ANSI escape sequences used to colour the traceback output. A NULL member
+ * is treated as an empty string. Colours are only emitted when the output stream
+ * supports them, see NO_COLOR and CLICOLOR_FORCE.
+ */
+typedef struct CTB_Theme
+{
+    const char *reset;             /* Reset to normal text */
+    const char *error;             /* Error messages, source code and rules */
+    const char *error_bold;        /* Traceback header and error names */
+    const char *text;              /* Secondary text of the frames */
+    const char *counter;           /* Frame counters, e.g. (#00) */
+    const char *file_parent;       /* Parent directory of the file path */
+    const char *file;              /* File name */
+    const char *line;              /* Line number */
+    const char *function;          /* Function name */
+    const char *another_exception; /* "During handling of the above exception" */
+    const char *accent;            /* Rules of the compilation info */
+    const char *accent_bold;       /* Logo and labels of the compilation info */
+} CTB_Theme;
+
+/**
+ * \brief Get the default theme, i.e. the colours of color_codes.h.
+ *
+ * \return The default theme.
+ */
+CTB_Theme ctb_default_theme(void);
+
+/**
+ * \brief Set the colour theme of the traceback output.
+ *
+ * The theme is compiled once into templates, so a custom theme renders as fast as
+ * the default one. It should be set at startup: setting it while another thread
+ * prints a traceback may garble that output.
+ *
+ * \param[in] theme The theme, or NULL for the default theme. The strings are
+ * copied.
+ * \return true if the theme has been applied, false if its escape sequences are too
+ * long.
+ */
+bool ctb_set_theme(const CTB_Theme *theme);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_THEME_H */
@@ -0,0 +1,96 @@
+/**
+ * \file timing.h
+ * \brief Header file for scoped timing frames.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_TIMING_H
+#define C_TRACEBACK_TIMING_H
+
+#include "c_traceback/trace.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Wrapper macro for expression to automatically manage call stack frames and
+ * record the elapsed time of the expression for the call site.
+ *
+ * \param[in] expr The expression to be traced and timed.
+ */
+#define TRACE_TIMED(expr)                                                              \
+    do                                                                                 \
+    {                                                                                  \
+        static const CTB_Frame ctb_timed_site_ = {                                     \
+            __LINE__, __FILE__, __func__, #expr                                        \
+        };                                                                             \
+        ctb_push_call_stack_frame(__FILE__, __func__, __LINE__, #expr);                \
+        const unsigned long long ctb_timed_start_ = ctb_timing_begin();                \
+        (expr);                                                                        \
+        ctb_timing_end(&ctb_timed_site_, ctb_timed_start_);                            \
+        ctb_pop_call_stack_frame();                                                    \
+    } while (0)
+
+/**
+ * \brief Timing statistics of a single TRACE_TIMED call site, aggregated over all
+ * threads. All durations are in nanoseconds.
+ */
+typedef struct CTB_Timing_Stats
+{
+    const CTB_Frame *site;
+    unsigned long long count;
+    double total_ns;
+    double p50_ns;
+    double p99_ns;
+    double max_ns;
+} CTB_Timing_Stats;
+
+/**
+ * \brief Get the start timestamp of a timed region.
+ *
+ * \return Timestamp in ticks of the internal cycle counter.
+ */
+unsigned long long ctb_timing_begin(void);
+
+/**
+ * \brief Record the elapsed time of a timed region into the histogram of its call
+ * site for the calling thread.
+ *
+ * \param[in] site The static call site descriptor.
+ * \param[in] start The timestamp returned by ctb_timing_begin.
+ */
+void ctb_timing_end(const CTB_Frame *site, const unsigned long long start);
+
+/**
+ * \brief Get the aggregated timing statistics of all TRACE_TIMED call sites.
+ *
+ * Percentiles are computed from log-bucketed histograms and are accurate to about
+ * 25%. Statistics of threads that are still running are read without stopping them,
+ * so they may be slightly out of date.
+ *
+ * \param[out] stats Array to store the statistics, may be NULL if max_stats is 0.
+ * \param[in] max_stats The capacity of the array.
+ * \return The total number of timed call sites, which may exceed max_stats.
+ */
+int ctb_get_timing_stats(CTB_Timing_Stats *stats, const int max_stats);
+
+/**
+ * \brief Log the timing statistics of all TRACE_TIMED call sites to stderr.
+ */
+void ctb_log_timing_report(void);
+
+/**
+ * \brief Reset the timing statistics of all threads. Each thread zeroes its own
+ * statistics at its next timed call, and reports leave out statistics recorded
+ * before the reset.
+ */
+void ctb_reset_timing(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C_TRACEBACK_TIMING_H */
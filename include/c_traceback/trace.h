@@ -8,6 +8,24 @@
 #ifndef C_TRACEBACK_TRACE_H
 #define C_TRACEBACK_TRACE_H
 
+#include "c_traceback/error_codes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief A single call stack frame, i.e. the call site recorded by the tracing macros.
+ */
+typedef struct CTB_Frame
+{
+    int line_number;
+    const char *CTB_RESTRICT filename;
+    const char *CTB_RESTRICT function_name;
+    const char *CTB_RESTRICT source_code;
+} CTB_Frame;
+
 /**
  * \brief Wrapper macro for expression to automatically manage call stack frames without
  * checking for errors.
@@ -69,6 +87,29 @@
         }                                                                              \
     } while (0)
 
+/**
+ * \brief Wrapper for an expression. If the error occurring after the expression is the
+ * base error or one of its descendants, jump to label. Other errors are left pending.
+ *
+ * The error is still pending at the label, e.g. to be inspected with
+ * ctb_get_last_error before it is handled with ctb_catch_error.
+ *
+ * \param[in] expr The expression to be traced.
+ * \param[in] base The base error type to catch.
+ * \param[in] label The label to jump to on a matching error.
+ */
+#define TRY_CATCH(expr, base, label)                                                   \
+    do                                                                                 \
+    {                                                                                  \
+        ctb_push_call_stack_frame(__FILE__, __func__, __LINE__, #expr);                \
+        (expr);                                                                        \
+        ctb_pop_call_stack_frame();                                                    \
+        if (ctb_check_error_is_a(base))                                                \
+        {                                                                              \
+            goto label;                                                                \
+        }                                                                              \
+    } while (0)
+
 /**
  * \brief Wrapper for a block of code. If an error occurs after the block executes, jump
  * to label.
@@ -99,9 +140,29 @@ void ctb_push_call_stack_frame(
     const char *file, const char *func, const int line, const char *source_code
 );
 
+/**
+ * \brief Push a new call stack frame from a static call site descriptor.
+ *
+ * \param[in] site The call site descriptor.
+ * \return The call depth before the push, to be passed to ctb_unwind_call_stack.
+ */
+int ctb_push_call_stack_site(const CTB_Frame *site);
+
 /**
  * \brief Pop the top call stack frame.
  */
 void ctb_pop_call_stack_frame(void);
 
+/**
+ * \brief Pop call stack frames until the call depth is at most the given depth, e.g.
+ * to drop the frames skipped by a longjmp or a C++ exception.
+ *
+ * \param[in] call_depth The call depth to restore.
+ */
+void ctb_unwind_call_stack(const int call_depth);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* C_TRACEBACK_TRACE_H */
\ No newline at end of file
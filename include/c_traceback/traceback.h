@@ -8,6 +8,62 @@
 #ifndef C_TRACEBACK_TRACEBACK_H
 #define C_TRACEBACK_TRACEBACK_H
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Rendering modes of ctb_log_traceback.
+ *
+ * In the grouped mode, errors with the same error code, throw site and call stack
+ * are printed once, in the order of their first occurrence, with their number of
+ * occurrences and their first and last messages. In the JSON Lines format a group
+ * is one "traceback" object with "count" and, if it differs, "last_message".
+ */
+typedef enum CTB_Traceback_Mode
+{
+    CTB_TRACEBACK_FULL = 0,
+    CTB_TRACEBACK_GROUPED
+} CTB_Traceback_Mode;
+
+/**
+ * \brief Set the rendering mode of tracebacks for all threads. Tracebacks printed
+ * from a signal handler are never grouped.
+ *
+ * \param[in] mode The rendering mode.
+ */
+void ctb_set_traceback_mode(const CTB_Traceback_Mode mode);
+
+/**
+ * \brief Get the rendering mode of tracebacks.
+ *
+ * \return The rendering mode.
+ */
+CTB_Traceback_Mode ctb_get_traceback_mode(void);
+
+/* Value of ctb_set_source_context that shows the traced expression of frames */
+#define CTB_SOURCE_CONTEXT_DISABLED (-1)
+
+/**
+ * \brief Show the lines of the source files around each frame of a traceback in
+ * the text format, instead of the traced expression. Source files are read and
+ * indexed on first use and kept in memory, so that later tracebacks read no file.
+ * Frames whose source file cannot be read show the traced expression.
+ *
+ * \param[in] num_lines The number of lines shown before and after the line of each
+ * frame, at most CTB_MAX_SOURCE_CONTEXT_LINES, or CTB_SOURCE_CONTEXT_DISABLED (the
+ * default).
+ */
+void ctb_set_source_context(const int num_lines);
+
+/**
+ * \brief Get the number of source lines shown around each frame of a traceback.
+ *
+ * \return The number of lines, or CTB_SOURCE_CONTEXT_DISABLED.
+ */
+int ctb_get_source_context(void);
+
 /**
  * \brief Log the traceback of all recorded errors to stderr.
  */
@@ -18,4 +74,8 @@ void ctb_log_traceback(void);
  */
 void ctb_dump_traceback(void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* C_TRACEBACK_TRACEBACK_H */
\ No newline at end of file
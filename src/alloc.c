@@ -0,0 +1,386 @@
+/**
+ * \file alloc.c
+ * \brief Pool allocator, allocator hooks and emergency reserve for C Traceback.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/trace.h"
+
+/* Size classes of the pool: 32, 64, ..., 4096 bytes including the header */
+#define CTB_POOL_MIN_CLASS_SHIFT 5
+#define CTB_POOL_NUM_CLASSES 8
+#define CTB_POOL_CHUNK_SIZE (64 * 1024)
+
+/* Number of freed objects of each size class kept by a thread without locking */
+#define CTB_POOL_CACHE_SIZE 32
+
+/* Size class of allocations served directly by the backing allocator */
+#define CTB_ALLOC_LARGE_CLASS -1
+
+/**
+ * Header in front of every allocation made by the pool or the emergency reserve.
+ * It is padded to 16 bytes to keep the returned memory suitably aligned.
+ */
+typedef union CTB_Alloc_Header_
+{
+    struct
+    {
+        size_t size;
+        int size_class;
+    } info;
+    char padding[16];
+} CTB_Alloc_Header_;
+
+typedef struct CTB_Pool_Object_
+{
+    struct CTB_Pool_Object_ *next;
+} CTB_Pool_Object_;
+
+static CTB_Allocator ctb_allocator = {NULL, NULL, NULL, NULL};
+static bool ctb_alloc_in_use = false;
+static int ctb_alloc_lock = 0;
+
+/* Pool state, guarded by ctb_alloc_lock */
+static CTB_Pool_Object_ *ctb_pool_free_lists[CTB_POOL_NUM_CLASSES] = {NULL};
+static char *ctb_pool_chunk_cursor = NULL;
+static char *ctb_pool_chunk_end = NULL;
+
+/* Objects freed by the calling thread, reused by its next allocations */
+typedef struct CTB_Pool_Cache_
+{
+    CTB_Pool_Object_ *free_lists[CTB_POOL_NUM_CLASSES];
+    int num_objects[CTB_POOL_NUM_CLASSES];
+} CTB_Pool_Cache_;
+
+static ctb_thread_local CTB_Pool_Cache_ ctb_pool_cache;
+
+/* Emergency reserve, carved with an atomic bump pointer */
+static size_t ctb_reserve_size = CTB_EMERGENCY_RESERVE_SIZE;
+static char *ctb_reserve = NULL;
+static size_t ctb_reserve_offset = 0;
+
+/**
+ * \brief Whether the user has installed allocator hooks.
+ */
+static inline bool has_hooks(void)
+{
+    return ctb_allocator.malloc_fn != NULL;
+}
+
+/**
+ * \brief Allocate from the user hooks or the system allocator.
+ */
+static void *backing_malloc(const size_t size)
+{
+    if (has_hooks())
+    {
+        return ctb_allocator.malloc_fn(size, ctb_allocator.user_data);
+    }
+    return malloc(size);
+}
+
+/**
+ * \brief Whether a pointer lies in the emergency reserve.
+ */
+static inline bool in_reserve(const void *ptr)
+{
+    const char *p = ptr;
+    return ctb_reserve && p >= ctb_reserve && p < ctb_reserve + ctb_reserve_size;
+}
+
+/**
+ * \brief Allocate the emergency reserve and mark the allocator as in use.
+ */
+static void ensure_initialized(void)
+{
+    if (ctb_atomic_load_acquire(&ctb_alloc_in_use))
+    {
+        return;
+    }
+
+    ctb_spin_lock(&ctb_alloc_lock);
+    if (!ctb_alloc_in_use)
+    {
+        if (ctb_reserve_size > 0)
+        {
+            ctb_reserve = backing_malloc(ctb_reserve_size);
+        }
+        ctb_atomic_store_release(&ctb_alloc_in_use, true);
+    }
+    ctb_spin_unlock(&ctb_alloc_lock);
+}
+
+bool ctb_is_valid_allocator(const CTB_Allocator *allocator)
+{
+    /* Hooked allocations have no header recording their size, so ctb_realloc
+       cannot emulate a missing realloc_fn with malloc_fn and free_fn */
+    const bool has_malloc = (allocator->malloc_fn != NULL);
+    return (allocator->realloc_fn != NULL) == has_malloc &&
+           (allocator->free_fn != NULL) == has_malloc;
+}
+
+bool ctb_set_allocator(
+    const CTB_Allocator *allocator, const size_t emergency_reserve_size
+)
+{
+    const CTB_Allocator new_allocator =
+        allocator ? *allocator : (CTB_Allocator){NULL, NULL, NULL, NULL};
+    if (!ctb_is_valid_allocator(&new_allocator))
+    {
+        return false;
+    }
+
+    ctb_spin_lock(&ctb_alloc_lock);
+    if (ctb_alloc_in_use)
+    {
+        const bool unchanged = new_allocator.malloc_fn == ctb_allocator.malloc_fn &&
+                               new_allocator.realloc_fn == ctb_allocator.realloc_fn &&
+                               new_allocator.free_fn == ctb_allocator.free_fn &&
+                               new_allocator.user_data == ctb_allocator.user_data &&
+                               emergency_reserve_size == ctb_reserve_size;
+        ctb_spin_unlock(&ctb_alloc_lock);
+        return unchanged;
+    }
+
+    ctb_allocator = new_allocator;
+    ctb_reserve_size = emergency_reserve_size;
+    ctb_spin_unlock(&ctb_alloc_lock);
+    return true;
+}
+
+void *ctb_emergency_malloc(const size_t size)
+{
+    if (!ctb_atomic_load_acquire(&ctb_reserve))
+    {
+        return NULL;
+    }
+
+    const size_t total = (sizeof(CTB_Alloc_Header_) + size + 15) & ~(size_t)15;
+    const size_t offset = ctb_atomic_fetch_add(&ctb_reserve_offset, total);
+    if (offset + total > ctb_reserve_size)
+    {
+        return NULL;
+    }
+
+    CTB_Alloc_Header_ *header = (CTB_Alloc_Header_ *)(ctb_reserve + offset);
+    header->info.size = size;
+    header->info.size_class = CTB_ALLOC_LARGE_CLASS;
+    return header + 1;
+}
+
+/**
+ * \brief Get the pool size class of an allocation, or CTB_ALLOC_LARGE_CLASS.
+ */
+static int get_size_class(const size_t size)
+{
+    const size_t total = size + sizeof(CTB_Alloc_Header_);
+    for (int c = 0; c < CTB_POOL_NUM_CLASSES; c++)
+    {
+        if (total <= ((size_t)1 << (c + CTB_POOL_MIN_CLASS_SHIFT)))
+        {
+            return c;
+        }
+    }
+    return CTB_ALLOC_LARGE_CLASS;
+}
+
+/**
+ * \brief Take an object from the shared free list of a size class, or carve it out
+ * of the current chunk.
+ */
+static CTB_Alloc_Header_ *pool_malloc_shared(const int size_class)
+{
+    const size_t object_size = (size_t)1 << (size_class + CTB_POOL_MIN_CLASS_SHIFT);
+    CTB_Alloc_Header_ *header = NULL;
+
+    ctb_spin_lock(&ctb_alloc_lock);
+    CTB_Pool_Object_ *object = ctb_pool_free_lists[size_class];
+    if (object)
+    {
+        ctb_pool_free_lists[size_class] = object->next;
+        header = (CTB_Alloc_Header_ *)object;
+    }
+    else
+    {
+        if (!ctb_pool_chunk_cursor ||
+            (size_t)(ctb_pool_chunk_end - ctb_pool_chunk_cursor) < object_size)
+        {
+            /* The tail of the previous chunk is abandoned */
+            char *chunk = backing_malloc(CTB_POOL_CHUNK_SIZE);
+            ctb_pool_chunk_cursor = chunk;
+            ctb_pool_chunk_end = chunk ? chunk + CTB_POOL_CHUNK_SIZE : NULL;
+        }
+        if (ctb_pool_chunk_cursor)
+        {
+            header = (CTB_Alloc_Header_ *)ctb_pool_chunk_cursor;
+            ctb_pool_chunk_cursor += object_size;
+        }
+    }
+    ctb_spin_unlock(&ctb_alloc_lock);
+    return header;
+}
+
+/**
+ * \brief Allocate from the pool. Objects freed by the calling thread are reused
+ * without locking, other objects come from the shared free lists or are carved out
+ * of shared chunks.
+ */
+static void *pool_malloc(const size_t size)
+{
+    const int size_class = get_size_class(size);
+    CTB_Alloc_Header_ *header = NULL;
+
+    if (size_class == CTB_ALLOC_LARGE_CLASS)
+    {
+        header = backing_malloc(sizeof(CTB_Alloc_Header_) + size);
+    }
+    else
+    {
+        CTB_Pool_Cache_ *cache = &ctb_pool_cache;
+        CTB_Pool_Object_ *object = cache->free_lists[size_class];
+        if (object)
+        {
+            cache->free_lists[size_class] = object->next;
+            (cache->num_objects[size_class])--;
+            header = (CTB_Alloc_Header_ *)object;
+        }
+        else
+        {
+            header = pool_malloc_shared(size_class);
+        }
+    }
+
+    if (!header)
+    {
+        return NULL;
+    }
+    header->info.size = size;
+    header->info.size_class = size_class;
+    return header + 1;
+}
+
+void *ctb_malloc(const size_t size)
+{
+    ensure_initialized();
+
+    void *ptr = has_hooks() ? ctb_allocator.malloc_fn(size, ctb_allocator.user_data)
+                            : pool_malloc(size);
+    if (!ptr)
+    {
+        ptr = ctb_emergency_malloc(size);
+    }
+    return ptr;
+}
+
+void *ctb_calloc(const size_t count, const size_t size)
+{
+    if (size != 0 && count > (size_t)-1 / size)
+    {
+        return NULL;
+    }
+
+    void *ptr = ctb_malloc(count * size);
+    if (ptr)
+    {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void ctb_free(void *ptr)
+{
+    if (!ptr || in_reserve(ptr))
+    {
+        return;
+    }
+
+    if (has_hooks())
+    {
+        ctb_allocator.free_fn(ptr, ctb_allocator.user_data);
+        return;
+    }
+
+    CTB_Alloc_Header_ *header = (CTB_Alloc_Header_ *)ptr - 1;
+    const int size_class = header->info.size_class;
+    if (size_class == CTB_ALLOC_LARGE_CLASS)
+    {
+        free(header);
+        return;
+    }
+
+    CTB_Pool_Object_ *object = (CTB_Pool_Object_ *)header;
+    CTB_Pool_Cache_ *cache = &ctb_pool_cache;
+    if (cache->num_objects[size_class] < CTB_POOL_CACHE_SIZE)
+    {
+        object->next = cache->free_lists[size_class];
+        cache->free_lists[size_class] = object;
+        (cache->num_objects[size_class])++;
+        return;
+    }
+
+    ctb_spin_lock(&ctb_alloc_lock);
+    object->next = ctb_pool_free_lists[size_class];
+    ctb_pool_free_lists[size_class] = object;
+    ctb_spin_unlock(&ctb_alloc_lock);
+}
+
+void *ctb_realloc(void *ptr, const size_t size)
+{
+    if (!ptr)
+    {
+        return ctb_malloc(size);
+    }
+
+    if (has_hooks() && !in_reserve(ptr))
+    {
+        return ctb_allocator.realloc_fn(ptr, size, ctb_allocator.user_data);
+    }
+
+    CTB_Alloc_Header_ *header = (CTB_Alloc_Header_ *)ptr - 1;
+    const size_t old_size = header->info.size;
+    const int size_class = header->info.size_class;
+    if (!in_reserve(ptr) && size_class != CTB_ALLOC_LARGE_CLASS &&
+        get_size_class(size) == size_class)
+    {
+        header->info.size = size;
+        return ptr;
+    }
+
+    void *new_ptr = ctb_malloc(size);
+    if (!new_ptr)
+    {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, (old_size < size) ? old_size : size);
+    ctb_free(ptr);
+    return new_ptr;
+}
+
+void ctb_release_pool_cache(void)
+{
+    CTB_Pool_Cache_ *cache = &ctb_pool_cache;
+    ctb_spin_lock(&ctb_alloc_lock);
+    for (int c = 0; c < CTB_POOL_NUM_CLASSES; c++)
+    {
+        CTB_Pool_Object_ *object = cache->free_lists[c];
+        while (object)
+        {
+            CTB_Pool_Object_ *next = object->next;
+            object->next = ctb_pool_free_lists[c];
+            ctb_pool_free_lists[c] = object;
+            object = next;
+        }
+        cache->free_lists[c] = NULL;
+        cache->num_objects[c] = 0;
+    }
+    ctb_spin_unlock(&ctb_alloc_lock);
+}
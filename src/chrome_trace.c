@@ -0,0 +1,454 @@
+/**
+ * \file chrome_trace.c
+ * \brief Recording of call stack spans into per-thread buffers and export in Chrome
+ * Trace Event format.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/chrome_trace.h"
+#include "internal/clock.h"
+#include "internal/format.h"
+#include "internal/trace.h"
+
+#ifdef _WIN32
+#include <process.h>
+#define GETPID _getpid
+#else
+#include <unistd.h>
+#define GETPID getpid
+#endif
+
+/* Number of formatted bytes collected before they are written to the file */
+#define CHROME_TRACE_WRITE_SIZE (64 * 1024)
+
+typedef struct CTB_Chrome_Trace_Event_
+{
+    unsigned long long timestamp_ns;
+    const char *name;
+    const char *filename;
+    const char *function_name;
+    int line_number;
+    char phase;
+} CTB_Chrome_Trace_Event_;
+
+/**
+ * Single-producer single-consumer ring: the owning thread advances head, the
+ * flushing thread advances tail.
+ */
+typedef struct CTB_Chrome_Trace_Buffer_
+{
+    struct CTB_Chrome_Trace_Buffer_ *next;
+    int thread_id;
+    bool thread_name_written;
+
+    /* Set when the owning thread exits, so that another thread may reuse it */
+    bool released;
+
+    /* Spans of the owning thread that are open in the recording, and open spans
+       whose begin event was dropped, so that no end event is written without its
+       begin event. Reset when a new recording starts. */
+    int recorded_depth;
+    int dropped_depth;
+    unsigned int recording;
+    unsigned long long head;
+    unsigned long long tail;
+    unsigned long long num_dropped;
+    CTB_Chrome_Trace_Event_ events[CTB_CHROME_TRACE_BUFFER_SIZE];
+} CTB_Chrome_Trace_Buffer_;
+
+int ctb_chrome_trace_enabled = 0;
+
+static ctb_thread_local CTB_Chrome_Trace_Buffer_ *ctb_chrome_trace_buffer = NULL;
+static CTB_Chrome_Trace_Buffer_ *ctb_chrome_trace_buffers = NULL;
+static int ctb_chrome_trace_num_buffers = 0;
+/* Guards the list of buffers and the claiming of released buffers */
+static int ctb_chrome_trace_registry_lock = 0;
+
+/* Guards the output file, so that only one thread flushes at a time */
+static int ctb_chrome_trace_file_lock = 0;
+
+/* Incremented by every ctb_chrome_trace_start */
+static unsigned int ctb_chrome_trace_recording = 0;
+static FILE *ctb_chrome_trace_file = NULL;
+static bool ctb_chrome_trace_first_event = true;
+static unsigned long long ctb_chrome_trace_start_ns = 0;
+
+/**
+ * \brief Get the event buffer of the calling thread, creating it on first use.
+ *
+ * \return The event buffer, or NULL if it cannot be allocated.
+ */
+static CTB_Chrome_Trace_Buffer_ *get_buffer(void)
+{
+    CTB_Chrome_Trace_Buffer_ *buffer = ctb_chrome_trace_buffer;
+    if (buffer)
+    {
+        return buffer;
+    }
+
+    /* Reuse the buffer of an exited thread once its events have been written. A
+       flush skips a drained buffer, and the acquire load of the tail orders its
+       last writes before the buffer is reset. */
+    ctb_spin_lock(&ctb_chrome_trace_registry_lock);
+    for (buffer = ctb_chrome_trace_buffers; buffer; buffer = buffer->next)
+    {
+        if (ctb_atomic_load_acquire(&buffer->released) &&
+            ctb_atomic_load_acquire(&buffer->tail) == buffer->head)
+        {
+            buffer->thread_id = ++ctb_chrome_trace_num_buffers;
+            buffer->thread_name_written = false;
+            buffer->recorded_depth = 0;
+            buffer->dropped_depth = 0;
+            ctb_atomic_store_relaxed(&buffer->released, false);
+            break;
+        }
+    }
+    ctb_spin_unlock(&ctb_chrome_trace_registry_lock);
+    if (buffer)
+    {
+        ctb_chrome_trace_buffer = buffer;
+        return buffer;
+    }
+
+    buffer = ctb_calloc(1, sizeof(CTB_Chrome_Trace_Buffer_));
+    if (!buffer)
+    {
+        return NULL;
+    }
+
+    ctb_spin_lock(&ctb_chrome_trace_registry_lock);
+    buffer->thread_id = ++ctb_chrome_trace_num_buffers;
+    buffer->next = ctb_chrome_trace_buffers;
+    ctb_atomic_store_release(&ctb_chrome_trace_buffers, buffer);
+    ctb_spin_unlock(&ctb_chrome_trace_registry_lock);
+
+    ctb_chrome_trace_buffer = buffer;
+    return buffer;
+}
+
+/**
+ * \brief Append an event to the buffer of the calling thread.
+ *
+ * Room is kept for the end events of the open spans, and a span whose begin event
+ * is dropped is dropped with all its nested events, so that spans stay balanced.
+ */
+static void push_event(
+    const char phase,
+    const char *name,
+    const char *filename,
+    const char *function_name,
+    const int line_number
+)
+{
+    CTB_Chrome_Trace_Buffer_ *buffer = get_buffer();
+    if (!buffer)
+    {
+        return;
+    }
+
+    const unsigned int recording = ctb_atomic_load_acquire(&ctb_chrome_trace_recording);
+    if (buffer->recording != recording)
+    {
+        buffer->recording = recording;
+        buffer->recorded_depth = 0;
+        buffer->dropped_depth = 0;
+    }
+
+    const unsigned long long head = buffer->head;
+    const unsigned long long tail = ctb_atomic_load_acquire(&buffer->tail);
+    const unsigned long long num_free = CTB_CHROME_TRACE_BUFFER_SIZE - (head - tail);
+    const unsigned long long num_reserved = (unsigned long long)buffer->recorded_depth;
+
+    if (phase == 'E')
+    {
+        if (buffer->dropped_depth > 0)
+        {
+            (buffer->dropped_depth)--;
+            return;
+        }
+        /* The span was opened before the recording started */
+        if (buffer->recorded_depth == 0)
+        {
+            return;
+        }
+        (buffer->recorded_depth)--;
+    }
+    else
+    {
+        /* A begin event also needs room for its own end event */
+        const unsigned long long num_needed = (phase == 'B') ? 2 : 1;
+        if ((phase == 'B' && buffer->dropped_depth > 0) ||
+            num_free < num_reserved + num_needed)
+        {
+            if (phase == 'B')
+            {
+                (buffer->dropped_depth)++;
+            }
+            ctb_atomic_store_relaxed(&buffer->num_dropped, buffer->num_dropped + 1);
+            return;
+        }
+        if (phase == 'B')
+        {
+            (buffer->recorded_depth)++;
+        }
+    }
+
+    CTB_Chrome_Trace_Event_ *event =
+        &buffer->events[head % CTB_CHROME_TRACE_BUFFER_SIZE];
+    event->timestamp_ns = ctb_clock_ns();
+    event->phase = phase;
+    event->name = name;
+    event->filename = filename;
+    event->function_name = function_name;
+    event->line_number = line_number;
+    ctb_atomic_store_release(&buffer->head, head + 1);
+}
+
+void ctb_release_chrome_trace_buffer(void)
+{
+    CTB_Chrome_Trace_Buffer_ *buffer = ctb_chrome_trace_buffer;
+    if (buffer)
+    {
+        ctb_chrome_trace_buffer = NULL;
+        ctb_atomic_store_release(&buffer->released, true);
+    }
+}
+
+void ctb_chrome_trace_begin_event(const CTB_Frame *frame)
+{
+    push_event(
+        'B',
+        frame->source_code,
+        frame->filename,
+        frame->function_name,
+        frame->line_number
+    );
+}
+
+void ctb_chrome_trace_end_event(void)
+{
+    push_event('E', NULL, NULL, NULL, 0);
+}
+
+void ctb_chrome_trace_error_event(const CTB_Error error, const CTB_Frame *error_frame)
+{
+    push_event(
+        'i',
+        error_to_string(error),
+        error_frame->filename,
+        error_frame->function_name,
+        error_frame->line_number
+    );
+}
+
+/**
+ * \brief Append the separator before the next event in the JSON array.
+ */
+static void begin_json_event(CTB_Format_Arena_ *arena)
+{
+    if (ctb_chrome_trace_first_event)
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, "\n");
+    }
+    else
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\n");
+    }
+    ctb_chrome_trace_first_event = false;
+}
+
+/**
+ * \brief Append a single event as a JSON object.
+ */
+static void write_event(
+    CTB_Format_Arena_ *arena,
+    const int pid,
+    const int tid,
+    const CTB_Chrome_Trace_Event_ *event
+)
+{
+    const unsigned long long timestamp_ns =
+        (event->timestamp_ns > ctb_chrome_trace_start_ns)
+            ? event->timestamp_ns - ctb_chrome_trace_start_ns
+            : 0;
+
+    begin_json_event(arena);
+    ctb_format_appendf(
+        arena,
+        "{\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%d",
+        event->phase,
+        timestamp_ns / 1000,
+        timestamp_ns % 1000,
+        pid,
+        tid
+    );
+
+    if (event->phase != 'E')
+    {
+        if (event->phase == 'i')
+        {
+            CTB_FORMAT_APPEND_LITERAL(arena, ",\"cat\":\"error\",\"s\":\"t\"");
+        }
+        else
+        {
+            CTB_FORMAT_APPEND_LITERAL(arena, ",\"cat\":\"trace\"");
+        }
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"name\":");
+        ctb_format_append_json_string(arena, event->name);
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"args\":{\"file\":");
+        ctb_format_append_json_string(arena, event->filename);
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"line\":");
+        ctb_format_append_int(arena, event->line_number, 0);
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"function\":");
+        ctb_format_append_json_string(arena, event->function_name);
+        CTB_FORMAT_APPEND_LITERAL(arena, "}");
+    }
+    CTB_FORMAT_APPEND_LITERAL(arena, "}");
+}
+
+void ctb_chrome_trace_flush(void)
+{
+    ctb_spin_lock(&ctb_chrome_trace_file_lock);
+
+    FILE *stream = ctb_chrome_trace_file;
+    if (!stream)
+    {
+        ctb_spin_unlock(&ctb_chrome_trace_file_lock);
+        return;
+    }
+
+    const int pid = (int)GETPID();
+    CTB_Format_Arena_ *arena = ctb_format_arena_begin();
+    for (CTB_Chrome_Trace_Buffer_ *buffer =
+             ctb_atomic_load_acquire(&ctb_chrome_trace_buffers);
+         buffer;
+         buffer = buffer->next)
+    {
+        const unsigned long long head = ctb_atomic_load_acquire(&buffer->head);
+        unsigned long long tail = buffer->tail;
+        if (tail == head)
+        {
+            continue;
+        }
+
+        if (!buffer->thread_name_written)
+        {
+            begin_json_event(arena);
+            ctb_format_appendf(
+                arena,
+                "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"Thread %d\"}}",
+                pid,
+                buffer->thread_id,
+                buffer->thread_id
+            );
+            buffer->thread_name_written = true;
+        }
+
+        for (; tail != head; tail++)
+        {
+            write_event(
+                arena,
+                pid,
+                buffer->thread_id,
+                &buffer->events[tail % CTB_CHROME_TRACE_BUFFER_SIZE]
+            );
+            if (arena->length >= CHROME_TRACE_WRITE_SIZE)
+            {
+                ctb_format_arena_write(arena, stream);
+            }
+        }
+        ctb_atomic_store_release(&buffer->tail, tail);
+    }
+
+    ctb_format_arena_write(arena, stream);
+    fflush(stream);
+    ctb_spin_unlock(&ctb_chrome_trace_file_lock);
+}
+
+bool ctb_chrome_trace_start(const char *path)
+{
+    if (ctb_atomic_load_acquire(&ctb_chrome_trace_enabled))
+    {
+        return true;
+    }
+
+    FILE *stream = fopen(path, "w");
+    if (!stream)
+    {
+        LOG_WARNING_INLINE_FMT(
+            CTB_RESOURCE_WARNING, "Failed to open Chrome trace file: \"%s\"", path
+        );
+        return false;
+    }
+
+    ctb_spin_lock(&ctb_chrome_trace_file_lock);
+    ctb_spin_lock(&ctb_chrome_trace_registry_lock);
+
+    /* Discard events left over from a previous recording */
+    for (CTB_Chrome_Trace_Buffer_ *buffer = ctb_chrome_trace_buffers; buffer;
+         buffer = buffer->next)
+    {
+        ctb_atomic_store_release(&buffer->tail, ctb_atomic_load_acquire(&buffer->head));
+        buffer->thread_name_written = false;
+        ctb_atomic_store_relaxed(&buffer->num_dropped, 0);
+    }
+    ctb_spin_unlock(&ctb_chrome_trace_registry_lock);
+    ctb_atomic_store_release(
+        &ctb_chrome_trace_recording, ctb_chrome_trace_recording + 1u
+    );
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", stream);
+    ctb_chrome_trace_file = stream;
+    ctb_chrome_trace_first_event = true;
+    ctb_chrome_trace_start_ns = ctb_clock_ns();
+    ctb_spin_unlock(&ctb_chrome_trace_file_lock);
+
+    ctb_atomic_store_release(&ctb_chrome_trace_enabled, 1);
+    return true;
+}
+
+void ctb_chrome_trace_stop(void)
+{
+    /* Only one of concurrent calls stops the recording */
+    if (!ctb_atomic_exchange(&ctb_chrome_trace_enabled, 0))
+    {
+        return;
+    }
+
+    ctb_chrome_trace_flush();
+
+    unsigned long long num_dropped = 0;
+    for (CTB_Chrome_Trace_Buffer_ *buffer =
+             ctb_atomic_load_acquire(&ctb_chrome_trace_buffers);
+         buffer;
+         buffer = buffer->next)
+    {
+        num_dropped += ctb_atomic_load_relaxed(&buffer->num_dropped);
+    }
+
+    ctb_spin_lock(&ctb_chrome_trace_file_lock);
+    if (ctb_chrome_trace_file)
+    {
+        fputs("\n]}\n", ctb_chrome_trace_file);
+        fclose(ctb_chrome_trace_file);
+        ctb_chrome_trace_file = NULL;
+    }
+    ctb_spin_unlock(&ctb_chrome_trace_file_lock);
+
+    if (num_dropped > 0)
+    {
+        LOG_WARNING_INLINE_FMT(
+            CTB_PERFORMANCE_WARNING,
+            "Chrome trace dropped %llu events, call ctb_chrome_trace_flush more often",
+            num_dropped
+        );
+    }
+}
@@ -0,0 +1,86 @@
+/**
+ * \file clock.c
+ * \brief Timestamp sources for C Traceback library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include "internal/clock.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* Calibration window for ctb_clock_ticks_per_ns */
+#define CTB_CLOCK_CALIBRATION_NS 2000000ULL
+
+unsigned long long ctb_clock_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    const unsigned long long seconds = counter.QuadPart / frequency.QuadPart;
+    const unsigned long long remainder = counter.QuadPart % frequency.QuadPart;
+    return seconds * 1000000000ULL + remainder * 1000000000ULL / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL +
+           (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+unsigned long long ctb_clock_realtime_ns(void)
+{
+#ifdef _WIN32
+    /* 100-nanosecond intervals since 1601-01-01 */
+    FILETIME file_time;
+    GetSystemTimeAsFileTime(&file_time);
+    const unsigned long long intervals =
+        ((unsigned long long)file_time.dwHighDateTime << 32) | file_time.dwLowDateTime;
+    return (intervals - 116444736000000000ULL) * 100ULL;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL +
+           (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+double ctb_clock_ticks_per_ns(void)
+{
+    static double ticks_per_ns = 0.0;
+
+#if !CTB_HAS_CYCLE_COUNTER
+    return 1.0;
+#else
+    if (ticks_per_ns > 0.0)
+    {
+        return ticks_per_ns;
+    }
+
+    const unsigned long long start_ns = ctb_clock_ns();
+    const unsigned long long start_ticks = ctb_clock_ticks();
+    unsigned long long end_ns = start_ns;
+    while (end_ns - start_ns < CTB_CLOCK_CALIBRATION_NS)
+    {
+        end_ns = ctb_clock_ns();
+    }
+    const unsigned long long end_ticks = ctb_clock_ticks();
+
+    ticks_per_ns = (double)(end_ticks - start_ticks) / (double)(end_ns - start_ns);
+    if (ticks_per_ns <= 0.0)
+    {
+        ticks_per_ns = 1.0;
+    }
+    return ticks_per_ns;
+#endif
+}
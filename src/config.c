@@ -0,0 +1,250 @@
+/**
+ * \file config.c
+ * \brief Runtime configuration and pooled per-context storage for C Traceback.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/trace.h"
+
+#define CTB_STORAGE_ALIGNMENT 16
+
+/* Message length of the fallback storage used when allocation fails */
+#define CTB_FALLBACK_MESSAGE_LENGTH 64
+
+CTB_Config ctb_config = {
+    CTB_MAX_CALL_STACK_DEPTH,
+    CTB_MAX_NUM_ERROR,
+    CTB_MAX_ERROR_MESSAGE_LENGTH,
+    {NULL, NULL, NULL, NULL},
+    CTB_EMERGENCY_RESERVE_SIZE,
+    CTB_RETAIN_FIRST
+};
+
+/**
+ * Storage blocks all have the same size since the configuration cannot change
+ * after the first allocation, so blocks released by exited threads are pooled in
+ * a free list and handed to new threads.
+ */
+typedef struct CTB_Storage_Block_
+{
+    struct CTB_Storage_Block_ *next_free;
+} CTB_Storage_Block_;
+
+typedef struct CTB_Storage_Layout_
+{
+    size_t call_stack_frames;
+    size_t frame_signatures;
+    size_t error_snapshots;
+    size_t snapshot_frames;
+    size_t error_messages;
+    size_t total;
+} CTB_Storage_Layout_;
+
+typedef struct CTB_Fallback_Storage_
+{
+    CTB_Frame call_stack_frames[1];
+    uint64_t frame_signatures[1];
+    CTB_Error_Snapshot_ error_snapshots[1];
+    CTB_Frame snapshot_frames[1];
+    char error_message[CTB_FALLBACK_MESSAGE_LENGTH];
+} CTB_Fallback_Storage_;
+
+static CTB_Storage_Block_ *ctb_storage_free_list = NULL;
+static bool ctb_storage_in_use = false;
+static int ctb_storage_lock = 0;
+
+static ctb_thread_local CTB_Fallback_Storage_ ctb_fallback_storage;
+
+CTB_Config ctb_default_config(void)
+{
+    return (CTB_Config
+    ){.max_call_stack_depth = CTB_MAX_CALL_STACK_DEPTH,
+      .max_num_errors = CTB_MAX_NUM_ERROR,
+      .max_error_message_length = CTB_MAX_ERROR_MESSAGE_LENGTH,
+      .allocator = {NULL, NULL, NULL, NULL},
+      .emergency_reserve_size = CTB_EMERGENCY_RESERVE_SIZE,
+      .retention_policy = CTB_RETAIN_FIRST};
+}
+
+/**
+ * \brief Check whether two configurations are equal.
+ */
+static bool config_equal(const CTB_Config *a, const CTB_Config *b)
+{
+    return a->max_call_stack_depth == b->max_call_stack_depth &&
+           a->max_num_errors == b->max_num_errors &&
+           a->max_error_message_length == b->max_error_message_length &&
+           a->allocator.malloc_fn == b->allocator.malloc_fn &&
+           a->allocator.realloc_fn == b->allocator.realloc_fn &&
+           a->allocator.free_fn == b->allocator.free_fn &&
+           a->allocator.user_data == b->allocator.user_data &&
+           a->emergency_reserve_size == b->emergency_reserve_size &&
+           a->retention_policy == b->retention_policy;
+}
+
+bool ctb_init(const CTB_Config *config)
+{
+    const CTB_Config new_config = config ? *config : ctb_default_config();
+    if (new_config.max_call_stack_depth <= 0 || new_config.max_num_errors <= 0 ||
+        new_config.max_error_message_length <= 0 ||
+        new_config.retention_policy < CTB_RETAIN_FIRST ||
+        new_config.retention_policy > CTB_RETAIN_SAMPLE ||
+        !ctb_is_valid_allocator(&new_config.allocator))
+    {
+        LOG_WARNING_INLINE(CTB_USER_WARNING, "Invalid C Traceback configuration");
+        return false;
+    }
+
+    ctb_spin_lock(&ctb_storage_lock);
+    if ((ctb_storage_in_use && !config_equal(&new_config, &ctb_config)) ||
+        !ctb_set_allocator(&new_config.allocator, new_config.emergency_reserve_size))
+    {
+        ctb_spin_unlock(&ctb_storage_lock);
+        LOG_WARNING_INLINE(
+            CTB_USER_WARNING, "ctb_init must be called before C Traceback is used"
+        );
+        return false;
+    }
+    ctb_config = new_config;
+    ctb_spin_unlock(&ctb_storage_lock);
+
+    return true;
+}
+
+const CTB_Config *ctb_get_config(void)
+{
+    return &ctb_config;
+}
+
+/**
+ * \brief Round a size up to the storage alignment.
+ */
+static size_t align_size(const size_t size)
+{
+    return (size + CTB_STORAGE_ALIGNMENT - 1) & ~(size_t)(CTB_STORAGE_ALIGNMENT - 1);
+}
+
+/**
+ * \brief Compute the offsets of the arrays in a storage block.
+ *
+ * \param[in] config The configuration sizing the block.
+ * \return The layout of the block.
+ */
+static CTB_Storage_Layout_ get_storage_layout(const CTB_Config *config)
+{
+    const size_t depth = (size_t)config->max_call_stack_depth;
+    const size_t num_errors = (size_t)config->max_num_errors;
+    const size_t message_length = (size_t)config->max_error_message_length;
+
+    CTB_Storage_Layout_ layout;
+    layout.call_stack_frames = align_size(sizeof(CTB_Storage_Block_));
+    layout.frame_signatures =
+        layout.call_stack_frames + align_size(sizeof(CTB_Frame) * depth);
+    layout.error_snapshots =
+        layout.frame_signatures + align_size(sizeof(uint64_t) * depth);
+    layout.snapshot_frames =
+        layout.error_snapshots + align_size(sizeof(CTB_Error_Snapshot_) * num_errors);
+    layout.error_messages =
+        layout.snapshot_frames + align_size(sizeof(CTB_Frame) * depth * num_errors);
+    layout.total = layout.error_messages + message_length * num_errors;
+    return layout;
+}
+
+/**
+ * \brief Point a context at the fallback storage of the calling thread.
+ */
+static void use_fallback_storage(CTB_Context *context)
+{
+    CTB_Fallback_Storage_ *fallback = &ctb_fallback_storage;
+    fallback->error_snapshots[0].call_stack_frames = fallback->snapshot_frames;
+    fallback->error_snapshots[0].error_message = fallback->error_message;
+    fallback->error_message[0] = '\0';
+
+    context->max_call_stack_depth = 1;
+    context->max_num_errors = 1;
+    context->max_error_message_length = CTB_FALLBACK_MESSAGE_LENGTH;
+    context->call_stack_frames = fallback->call_stack_frames;
+    context->frame_signatures = fallback->frame_signatures;
+    context->num_frame_signatures = 0;
+    context->error_snapshots = fallback->error_snapshots;
+    context->storage = NULL;
+}
+
+bool ctb_alloc_context_storage(CTB_Context *context)
+{
+    ctb_spin_lock(&ctb_storage_lock);
+    ctb_storage_in_use = true;
+    const CTB_Config config = ctb_config;
+    CTB_Storage_Block_ *block = ctb_storage_free_list;
+    if (block)
+    {
+        ctb_storage_free_list = block->next_free;
+    }
+    ctb_spin_unlock(&ctb_storage_lock);
+
+    const CTB_Storage_Layout_ layout = get_storage_layout(&config);
+    if (!block)
+    {
+        block = ctb_malloc(layout.total);
+        if (!block)
+        {
+            return false;
+        }
+    }
+
+    char *base = (char *)block;
+    CTB_Error_Snapshot_ *snapshots =
+        (CTB_Error_Snapshot_ *)(base + layout.error_snapshots);
+    CTB_Frame *snapshot_frames = (CTB_Frame *)(base + layout.snapshot_frames);
+    char *messages = base + layout.error_messages;
+
+    for (int i = 0; i < config.max_num_errors; i++)
+    {
+        snapshots[i].call_stack_frames =
+            snapshot_frames + (size_t)i * config.max_call_stack_depth;
+        snapshots[i].error_message =
+            messages + (size_t)i * config.max_error_message_length;
+        snapshots[i].error_message[0] = '\0';
+    }
+
+    context->max_call_stack_depth = config.max_call_stack_depth;
+    context->max_num_errors = config.max_num_errors;
+    context->max_error_message_length = config.max_error_message_length;
+    context->call_stack_frames = (CTB_Frame *)(base + layout.call_stack_frames);
+    context->frame_signatures = (uint64_t *)(base + layout.frame_signatures);
+    context->num_frame_signatures = 0;
+    context->error_snapshots = snapshots;
+    context->storage = block;
+    return true;
+}
+
+void ctb_init_context_storage(CTB_Context *context)
+{
+    if (!ctb_alloc_context_storage(context))
+    {
+        use_fallback_storage(context);
+    }
+}
+
+void ctb_release_context_storage(CTB_Context *context)
+{
+    CTB_Storage_Block_ *block = context->storage;
+    if (block)
+    {
+        ctb_spin_lock(&ctb_storage_lock);
+        block->next_free = ctb_storage_free_list;
+        ctb_storage_free_list = block;
+        ctb_spin_unlock(&ctb_storage_lock);
+    }
+
+    memset(context, 0, sizeof(CTB_Context));
+}
@@ -0,0 +1,294 @@
+/**
+ * \file crash_log.c
+ * \brief Implementation of the memory-mapped crash log.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/atomic.h"
+#include "internal/clock.h"
+#include "internal/crash_log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+/* The layout is part of the file format, so check it at compile time */
+typedef char ctb_crash_record_size_check_
+    [(sizeof(CTB_Crash_Record_) == CTB_CRASH_LOG_RECORD_SIZE) ? 1 : -1];
+typedef char ctb_crash_record_fields_check_
+    [(offsetof(CTB_Crash_Record_, text) == CTB_CRASH_RECORD_FIELDS_SIZE) ? 1 : -1];
+typedef char ctb_crash_log_header_size_check_
+    [(sizeof(CTB_Crash_Log_Header_) == CTB_CRASH_LOG_RECORD_SIZE) ? 1 : -1];
+
+int ctb_crash_log_enabled = 0;
+
+/* Mapped file, NULL while no crash log is open */
+static CTB_Crash_Log_Header_ *ctb_crash_log_header = NULL;
+static size_t ctb_crash_log_size = 0;
+
+/**
+ * \brief Get the size of a crash log file.
+ */
+static size_t crash_log_file_size(const size_t num_records)
+{
+    return sizeof(CTB_Crash_Log_Header_) + num_records * sizeof(CTB_Crash_Record_);
+}
+
+/**
+ * \brief Check whether a mapped file is a crash log that can be appended to.
+ */
+static bool is_valid_header(
+    const CTB_Crash_Log_Header_ *header, const size_t num_records
+)
+{
+    return memcmp(
+               header->fields.magic, CTB_CRASH_LOG_MAGIC, CTB_CRASH_LOG_MAGIC_LENGTH
+           ) == 0 &&
+           header->fields.version == CTB_CRASH_LOG_VERSION &&
+           header->fields.record_size == CTB_CRASH_LOG_RECORD_SIZE &&
+           header->fields.num_records == num_records;
+}
+
+/**
+ * \brief Map a file of the given size, creating or resizing it if needed.
+ *
+ * \param[in] path Path of the file.
+ * \param[in] size Size of the file in bytes.
+ * \param[out] resized Whether the file did not have the given size.
+ * \return The mapped file, or NULL on failure.
+ */
+static void *map_file(const char *path, const size_t size, bool *resized)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    *resized = !GetFileSizeEx(file, &file_size) || (size_t)file_size.QuadPart != size;
+    if (*resized)
+    {
+        /* Drop the old content, the mapping zero-fills the file up to its size */
+        LARGE_INTEGER zero = {0};
+        SetFilePointerEx(file, zero, NULL, FILE_BEGIN);
+        SetEndOfFile(file);
+    }
+
+    HANDLE mapping = CreateFileMappingA(
+        file,
+        NULL,
+        PAGE_READWRITE,
+        (DWORD)((unsigned long long)size >> 32),
+        (DWORD)(size & 0xFFFFFFFFu),
+        NULL
+    );
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return NULL;
+    }
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    CloseHandle(mapping);
+    return data;
+#else
+    const int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    *resized = (fstat(fd, &st) == -1) || ((size_t)st.st_size != size);
+    if (*resized && (ftruncate(fd, 0) == -1 || ftruncate(fd, (off_t)size) == -1))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (data == MAP_FAILED) ? NULL : data;
+#endif
+}
+
+/**
+ * \brief Unmap a file mapped by map_file.
+ */
+static void unmap_file(void *data, const size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+/**
+ * \brief Get the identifiers of the calling process and thread.
+ */
+static void get_ids(uint32_t *pid, uint32_t *thread_id)
+{
+#ifdef _WIN32
+    *pid = (uint32_t)GetCurrentProcessId();
+    *thread_id = (uint32_t)GetCurrentThreadId();
+#else
+    *pid = (uint32_t)getpid();
+#ifdef SYS_gettid
+    *thread_id = (uint32_t)syscall(SYS_gettid);
+#else
+    *thread_id = 0;
+#endif
+#endif
+}
+
+/**
+ * \brief Copy a string into the text of a record.
+ *
+ * \param[in,out] destination The write position, advanced past the copy.
+ * \param[in] str The string, or NULL.
+ * \param[in] length The length of the string.
+ * \param[in] max_length The maximum number of bytes to copy.
+ * \param[in] keep_tail Whether to keep the end of a truncated string.
+ * \return The number of bytes copied.
+ */
+static uint16_t copy_text(
+    char **destination,
+    const char *str,
+    const size_t length,
+    const size_t max_length,
+    const bool keep_tail
+)
+{
+    if (!str)
+    {
+        return 0;
+    }
+
+    const size_t copy_length = (length < max_length) ? length : max_length;
+    memcpy(*destination, keep_tail ? str + length - copy_length : str, copy_length);
+    *destination += copy_length;
+    return (uint16_t)copy_length;
+}
+
+void ctb_crash_log_record(
+    const CTB_Crash_Record_Type_ type,
+    const int code,
+    const char *restrict file,
+    const int line,
+    const char *restrict func,
+    const char *restrict message,
+    const size_t message_length
+)
+{
+    CTB_Crash_Log_Header_ *header = ctb_atomic_load_acquire(&ctb_crash_log_header);
+    if (!header)
+    {
+        return;
+    }
+
+    const uint64_t num_records = header->fields.num_records;
+    const uint64_t sequence = ctb_atomic_fetch_add(&header->fields.sequence, 1) + 1;
+    CTB_Crash_Record_ *records = (CTB_Crash_Record_ *)(header + 1);
+    CTB_Crash_Record_ *record = &records[(sequence - 1) % num_records];
+
+    /* Invalidate the record before overwriting it */
+    ctb_atomic_exchange(&record->sequence, (uint64_t)0);
+
+    record->type = (uint32_t)type;
+    record->timestamp_ns = ctb_clock_realtime_ns();
+    record->code = (int32_t)code;
+    record->line = (int32_t)line;
+    get_ids(&record->pid, &record->thread_id);
+    record->reserved = 0;
+
+    char *text = record->text;
+    const char *text_end = record->text + sizeof(record->text);
+    record->file_length = copy_text(
+        &text, file, file ? strlen(file) : 0, CTB_CRASH_LOG_MAX_FILE_LENGTH, true
+    );
+    record->function_length = copy_text(
+        &text, func, func ? strlen(func) : 0, CTB_CRASH_LOG_MAX_FUNCTION_LENGTH, false
+    );
+    record->message_length =
+        copy_text(&text, message, message_length, (size_t)(text_end - text), false);
+    memset(text, 0, (size_t)(text_end - text));
+
+    record->checksum = ctb_crash_record_checksum(record);
+    ctb_atomic_store_release(&record->sequence, sequence);
+}
+
+bool ctb_crash_log_open(const char *path, const size_t num_records)
+{
+    if (ctb_atomic_load_acquire(&ctb_crash_log_enabled))
+    {
+        return false;
+    }
+
+    const size_t records = (num_records > 0) ? num_records : CTB_CRASH_LOG_NUM_RECORDS;
+    const size_t size = crash_log_file_size(records);
+
+    bool resized;
+    CTB_Crash_Log_Header_ *header = map_file(path, size, &resized);
+    if (!header)
+    {
+        LOG_WARNING_INLINE_FMT(
+            CTB_RESOURCE_WARNING, "Failed to map crash log file: \"%s\"", path
+        );
+        return false;
+    }
+
+    if (resized || !is_valid_header(header, records))
+    {
+        memset(header, 0, size);
+        memcpy(header->fields.magic, CTB_CRASH_LOG_MAGIC, CTB_CRASH_LOG_MAGIC_LENGTH);
+        header->fields.version = CTB_CRASH_LOG_VERSION;
+        header->fields.record_size = CTB_CRASH_LOG_RECORD_SIZE;
+        header->fields.num_records = records;
+        header->fields.sequence = 0;
+    }
+
+    ctb_crash_log_size = size;
+    ctb_atomic_store_release(&ctb_crash_log_header, header);
+    ctb_atomic_store_release(&ctb_crash_log_enabled, 1);
+    return true;
+}
+
+void ctb_crash_log_close(void)
+{
+    if (!ctb_atomic_load_acquire(&ctb_crash_log_enabled))
+    {
+        return;
+    }
+
+    ctb_atomic_store_release(&ctb_crash_log_enabled, 0);
+    CTB_Crash_Log_Header_ *header = ctb_crash_log_header;
+    ctb_atomic_store_release(&ctb_crash_log_header, NULL);
+    unmap_file(header, ctb_crash_log_size);
+}
@@ -10,6 +10,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "internal/atomic.h"
+#include "internal/chrome_trace.h"
+#include "internal/crash_log.h"
+#include "internal/format.h"
 #include "internal/trace.h"
 
 /**
@@ -37,20 +41,182 @@ static void ctb_setup_error_snapshot_core(
     error_snapshot->error_frame.line_number = line;
     error_snapshot->error_frame.function_name = func;
     error_snapshot->error_frame.source_code = "<Error thrown here>";
+    error_snapshot->count = 1;
+    error_snapshot->signature =
+        ctb_get_stack_signature(context, &error_snapshot->error_frame);
+    error_snapshot->os_errno = 0;
 
-    const int min_depth = (context->call_depth < CTB_MAX_CALL_STACK_DEPTH)
+    const int min_depth = (context->call_depth < context->max_call_stack_depth)
                               ? context->call_depth
-                              : CTB_MAX_CALL_STACK_DEPTH;
+                              : context->max_call_stack_depth;
     if (min_depth > 0)
     {
         memcpy(
             error_snapshot->call_stack_frames,
             context->call_stack_frames,
-            sizeof(CTB_Frame_) * min_depth
+            sizeof(CTB_Frame) * min_depth
         );
     }
 }
 
+/**
+ * \brief Record a thrown error for tracing tools that are currently enabled.
+ *
+ * \param[in] error The error type.
+ * \param[in] file File where the error is thrown.
+ * \param[in] line Line number where the error is thrown.
+ * \param[in] func Function name where the error is thrown.
+ */
+static void ctb_trace_thrown_error(
+    CTB_Error error, const char *restrict file, const int line, const char *restrict func
+)
+{
+    if (ctb_atomic_load_relaxed(&ctb_chrome_trace_enabled))
+    {
+        const CTB_Frame error_frame = {line, file, func, NULL};
+        ctb_chrome_trace_error_event(error, &error_frame);
+    }
+}
+
+/**
+ * \brief Append a thrown error to the crash log if one is open.
+ *
+ * \param[in] error The error type.
+ * \param[in] file File where the error is thrown.
+ * \param[in] line Line number where the error is thrown.
+ * \param[in] func Function name where the error is thrown.
+ * \param[in] message The error message, or NULL.
+ */
+static void ctb_crash_log_thrown_error(
+    CTB_Error error,
+    const char *restrict file,
+    const int line,
+    const char *restrict func,
+    const char *restrict message
+)
+{
+    ctb_crash_log_record(
+        CTB_CRASH_RECORD_ERROR,
+        (int)error,
+        file,
+        line,
+        func,
+        message,
+        message ? strlen(message) : 0
+    );
+}
+
+/**
+ * \brief Check whether two file paths are equal, comparing pointers first since
+ * they usually are the same __FILE__ literal.
+ */
+static bool same_file(const char *a, const char *b)
+{
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+CTB_Error_Snapshot_ *ctb_reserve_error_snapshot(
+    CTB_Context *context,
+    const CTB_Error error,
+    const CTB_Frame *error_frame,
+    CTB_Error_Snapshot_ **merged
+)
+{
+    *merged = NULL;
+
+    const int num_errors = context->num_errors;
+    if (num_errors < 0)
+    {
+        return NULL;
+    }
+
+    const CTB_Retention_Policy policy = ctb_config.retention_policy;
+    if (policy == CTB_RETAIN_SAMPLE)
+    {
+        /* Recent errors are the most likely to repeat */
+        const int num_stored = ctb_get_num_stored_errors(context);
+        for (int e = num_stored - 1; e >= 0; e--)
+        {
+            CTB_Error_Snapshot_ *snapshot = ctb_get_error_snapshot(context, e);
+            if (snapshot->error == error &&
+                snapshot->error_frame.line_number == error_frame->line_number &&
+                same_file(snapshot->error_frame.filename, error_frame->filename))
+            {
+                /* The repeated error is the most recent one, as in ctb_discard_error
+                   the snapshots are rotated without moving their buffers */
+                const CTB_Error_Snapshot_ repeated = *snapshot;
+                for (int i = e; i < num_stored - 1; i++)
+                {
+                    *ctb_get_error_snapshot(context, i) =
+                        *ctb_get_error_snapshot(context, i + 1);
+                }
+                *merged = ctb_get_error_snapshot(context, num_stored - 1);
+                **merged = repeated;
+                return NULL;
+            }
+        }
+    }
+
+    if (num_errors < context->max_num_errors)
+    {
+        return ctb_get_error_snapshot(context, num_errors);
+    }
+    if (policy == CTB_RETAIN_LAST)
+    {
+        /* Overwrite the oldest error */
+        return &context->error_snapshots[context->first_error_snapshot];
+    }
+    return NULL;
+}
+
+void ctb_commit_error_snapshot(CTB_Context *context, const bool stored)
+{
+    if (stored && context->num_errors >= context->max_num_errors)
+    {
+        const int next = context->first_error_snapshot + 1;
+        context->first_error_snapshot = (next < context->max_num_errors) ? next : 0;
+    }
+    (context->num_errors)++;
+}
+
+/**
+ * \brief Find the snapshot of a thrown error and set it up without message.
+ *
+ * \param[in,out] context The CTB_Context pointer.
+ * \param[in] error The error type.
+ * \param[in] file File where the error is thrown.
+ * \param[in] line Line number where the error is thrown.
+ * \param[in] func Function name where the error is thrown.
+ * \param[out] merged Whether the error has been merged into a previous snapshot.
+ * \return The snapshot whose message must be set before it is committed, or NULL.
+ */
+static CTB_Error_Snapshot_ *ctb_begin_error_snapshot(
+    CTB_Context *context,
+    CTB_Error error,
+    const char *restrict file,
+    const int line,
+    const char *restrict func,
+    bool *merged
+)
+{
+    const CTB_Frame error_frame = {line, file, func, NULL};
+    CTB_Error_Snapshot_ *merged_snapshot;
+    CTB_Error_Snapshot_ *error_snapshot =
+        ctb_reserve_error_snapshot(context, error, &error_frame, &merged_snapshot);
+
+    context->last_error = error;
+    *merged = (merged_snapshot != NULL);
+    if (merged_snapshot)
+    {
+        (merged_snapshot->count)++;
+    }
+    else if (error_snapshot)
+    {
+        ctb_setup_error_snapshot_core(context, error_snapshot, error, file, line, func);
+    }
+    return error_snapshot;
+}
+
 void ctb_throw_error(
     CTB_Error error,
     const char *restrict file,
@@ -60,15 +226,21 @@ void ctb_throw_error(
 )
 {
     CTB_Context *context = get_context();
+    ctb_trace_thrown_error(error, file, line, func);
 
-    const int num_errors = context->num_errors;
-    if (num_errors >= 0 && num_errors < CTB_MAX_NUM_ERROR)
+    bool merged;
+    CTB_Error_Snapshot_ *error_snapshot =
+        ctb_begin_error_snapshot(context, error, file, line, func, &merged);
+    if (error_snapshot)
     {
-        CTB_Error_Snapshot_ *error_snapshot = &(context->error_snapshots[num_errors]);
-        ctb_setup_error_snapshot_core(context, error_snapshot, error, file, line, func);
         if (msg != NULL)
         {
-            snprintf(error_snapshot->error_message, CTB_MAX_ERROR_MESSAGE_LENGTH, "%s", msg);
+            ctb_format(
+                error_snapshot->error_message,
+                context->max_error_message_length,
+                "%s",
+                msg
+            );
         }
         else
         {
@@ -76,7 +248,76 @@ void ctb_throw_error(
         }
     }
 
-    (context->num_errors)++;
+    if (ctb_atomic_load_relaxed(&ctb_crash_log_enabled))
+    {
+        ctb_crash_log_thrown_error(error, file, line, func, msg);
+    }
+
+    if (!merged)
+    {
+        ctb_commit_error_snapshot(context, error_snapshot != NULL);
+    }
+}
+
+/**
+ * \brief Throw an error with formatted message and an errno value.
+ *
+ * \param[in] error The error type.
+ * \param[in] os_errno The errno value, or 0.
+ * \param[in] file File where the error is thrown.
+ * \param[in] line Line number where the error is thrown.
+ * \param[in] func Function name where the error is thrown.
+ * \param[in] msg The format string of the message.
+ * \param[in] args Additional arguments for formatting the message.
+ */
+static void ctb_throw_error_va(
+    CTB_Error error,
+    const int os_errno,
+    const char *restrict file,
+    const int line,
+    const char *restrict func,
+    const char *restrict msg,
+    va_list args
+)
+{
+    CTB_Context *context = get_context();
+    ctb_trace_thrown_error(error, file, line, func);
+
+    bool merged;
+    CTB_Error_Snapshot_ *error_snapshot =
+        ctb_begin_error_snapshot(context, error, file, line, func, &merged);
+    const char *message = NULL;
+    if (error_snapshot)
+    {
+        va_list args_copy;
+        va_copy(args_copy, args);
+        ctb_vformat(
+            error_snapshot->error_message,
+            context->max_error_message_length,
+            msg,
+            args_copy
+        );
+        va_end(args_copy);
+        error_snapshot->os_errno = os_errno;
+        message = error_snapshot->error_message;
+    }
+
+    if (ctb_atomic_load_relaxed(&ctb_crash_log_enabled))
+    {
+        /* The message is not stored if the error is truncated or merged */
+        char overflow_message[CTB_CRASH_LOG_RECORD_SIZE];
+        if (!message)
+        {
+            ctb_vformat(overflow_message, sizeof(overflow_message), msg, args);
+            message = overflow_message;
+        }
+        ctb_crash_log_thrown_error(error, file, line, func, message);
+    }
+
+    if (!merged)
+    {
+        ctb_commit_error_snapshot(context, error_snapshot != NULL);
+    }
 }
 
 void ctb_throw_error_fmt(
@@ -88,31 +329,198 @@ void ctb_throw_error_fmt(
     ...
 )
 {
-    CTB_Context *context = get_context();
+    va_list args;
+    va_start(args, msg);
+    ctb_throw_error_va(error, 0, file, line, func, msg, args);
+    va_end(args);
+}
 
+void ctb_throw_errno(
+    CTB_Error error,
+    const int os_errno,
+    const char *restrict file,
+    const int line,
+    const char *restrict func,
+    const char *restrict msg,
+    ...
+)
+{
+    const CTB_Error matching_error = ctb_error_from_errno(os_errno);
+    if (ctb_error_is_a(matching_error, error))
+    {
+        error = matching_error;
+    }
+
+    va_list args;
+    va_start(args, msg);
+    ctb_throw_error_va(error, os_errno, file, line, func, msg, args);
+    va_end(args);
+}
+
+bool ctb_check_error(void)
+{
+    return peek_context()->num_errors > 0;
+}
+
+CTB_Error ctb_get_last_error(const char **message)
+{
+    const CTB_Context *context = peek_context();
+    const int num_errors = ctb_get_num_stored_errors(context);
+    if (num_errors <= 0)
+    {
+        if (message)
+        {
+            *message = "";
+        }
+        return CTB_SUCCESS;
+    }
+
+    const CTB_Error_Snapshot_ *snapshot =
+        ctb_get_error_snapshot(context, num_errors - 1);
+    if (message)
+    {
+        *message = snapshot->error_message;
+    }
+    return snapshot->error;
+}
+
+/**
+ * \brief Update the most recent error of a context after errors have been removed
+ * from its end.
+ *
+ * If errors have been truncated, the error before a removed one may not have been
+ * stored, so the most recent error becomes CTB_UNKNOWN_ERROR.
+ */
+static void update_last_error(CTB_Context *context)
+{
     const int num_errors = context->num_errors;
-    if (num_errors >= 0 && num_errors < CTB_MAX_NUM_ERROR)
+    if (num_errors <= 0)
     {
-        CTB_Error_Snapshot_ *error_snapshot = &(context->error_snapshots[num_errors]);
-        ctb_setup_error_snapshot_core(context, error_snapshot, error, file, line, func);
+        context->num_errors = 0;
+        context->first_error_snapshot = 0;
+        context->last_error = CTB_SUCCESS;
+    }
+    else if (num_errors <= context->max_num_errors &&
+             context->first_error_snapshot == 0)
+    {
+        context->last_error = context->error_snapshots[num_errors - 1].error;
+    }
+    else
+    {
+        context->last_error = CTB_UNKNOWN_ERROR;
+    }
+}
+
+bool ctb_check_error_is_a(const CTB_Error base)
+{
+    const CTB_Context *context = peek_context();
+    return context->num_errors > 0 && ctb_error_is_a(context->last_error, base);
+}
 
-        va_list args;
-        va_start(args, msg);
-        vsnprintf(
-            error_snapshot->error_message, CTB_MAX_ERROR_MESSAGE_LENGTH, msg, args
+bool ctb_catch_error(const CTB_Error base)
+{
+    CTB_Context *context = peek_context();
+    if (context->num_errors <= 0 || !ctb_error_is_a(context->last_error, base))
+    {
+        return false;
+    }
+
+    /* Once errors are truncated, the stored errors are kept for the traceback */
+    (context->num_errors)--;
+    update_last_error(context);
+    return true;
+}
+
+int ctb_get_num_errors(void)
+{
+    return ctb_get_num_stored_errors(peek_context());
+}
+
+/**
+ * \brief Fill a view of an error snapshot.
+ */
+static void fill_error_view(
+    const CTB_Context *context,
+    const CTB_Error_Snapshot_ *snapshot,
+    CTB_Error_View *view
+)
+{
+    view->error = snapshot->error;
+    view->message = snapshot->error_message;
+    view->throw_site = &snapshot->error_frame;
+    view->frames = snapshot->call_stack_frames;
+    view->num_frames = (snapshot->call_depth < context->max_call_stack_depth)
+                           ? snapshot->call_depth
+                           : context->max_call_stack_depth;
+    view->call_depth = snapshot->call_depth;
+    view->count = snapshot->count;
+    view->signature = snapshot->signature;
+    view->os_errno = snapshot->os_errno;
+}
+
+bool ctb_get_error_view(const int index, CTB_Error_View *view)
+{
+    const CTB_Context *context = peek_context();
+    if (index < 0 || index >= ctb_get_num_stored_errors(context) || !view)
+    {
+        return false;
+    }
+
+    fill_error_view(context, ctb_get_error_snapshot(context, index), view);
+    return true;
+}
+
+bool ctb_discard_error(const int index)
+{
+    CTB_Context *context = peek_context();
+    if (index < 0 || index >= context->num_errors ||
+        context->num_errors > context->max_num_errors)
+    {
+        return false;
+    }
+
+    /* Snapshots own their message and frame buffers through pointers, so rotating
+       them moves no message or frame, and the discarded buffers are reused last.
+       The ring of CTB_RETAIN_LAST only wraps around once errors are truncated. */
+    CTB_Error_Snapshot_ *snapshots = context->error_snapshots;
+    const CTB_Error_Snapshot_ discarded = snapshots[index];
+    const int num_moved = context->num_errors - 1 - index;
+    if (num_moved > 0)
+    {
+        memmove(
+            &snapshots[index],
+            &snapshots[index + 1],
+            sizeof(CTB_Error_Snapshot_) * (size_t)num_moved
         );
-        va_end(args);
     }
+    snapshots[context->num_errors - 1] = discarded;
 
-    (context->num_errors)++;
+    (context->num_errors)--;
+    update_last_error(context);
+    return true;
 }
 
-bool ctb_check_error(void)
+bool ctb_pop_error(CTB_Error_View *view)
 {
-    return get_context()->num_errors > 0;
+    CTB_Context *context = peek_context();
+    const int num_errors = context->num_errors;
+    if (num_errors <= 0 || num_errors > context->max_num_errors)
+    {
+        return false;
+    }
+
+    if (view)
+    {
+        fill_error_view(context, &context->error_snapshots[num_errors - 1], view);
+    }
+    (context->num_errors)--;
+    update_last_error(context);
+    return true;
 }
 
 void ctb_clear_error(void)
 {
-    get_context()->num_errors = 0;
+    CTB_Context *context = peek_context();
+    context->num_errors = 0;
+    context->first_error_snapshot = 0;
 }
@@ -0,0 +1,293 @@
+/**
+ * \file error_bundle.c
+ * \brief Implementation of error propagation across threads.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/trace.h"
+
+/**
+ * The errors are kept in a detached context, so that they are moved between
+ * threads by exchanging storage blocks instead of copying snapshots.
+ */
+struct CTB_Error_Bundle
+{
+    CTB_Context errors;
+    int num_spawn_frames;
+    CTB_Frame spawn_frames[];
+};
+
+static inline int min_int(const int a, const int b)
+{
+    return (a < b) ? a : b;
+}
+
+static inline int max_int(const int a, const int b)
+{
+    return (a > b) ? a : b;
+}
+
+CTB_Error_Bundle *
+ctb_error_bundle_create(const char *file, const char *func, const int line)
+{
+    const CTB_Context *context = get_context();
+    const int max_depth = ctb_config.max_call_stack_depth;
+
+    CTB_Error_Bundle *bundle =
+        ctb_malloc(sizeof(CTB_Error_Bundle) + sizeof(CTB_Frame) * max_depth);
+    if (!bundle)
+    {
+        return NULL;
+    }
+
+    memset(&bundle->errors, 0, sizeof(CTB_Context));
+    if (!ctb_alloc_context_storage(&bundle->errors))
+    {
+        ctb_free(bundle);
+        return NULL;
+    }
+
+    /* Keep the last slot for the spawn site */
+    const int num_frames = min_int(
+        min_int(context->call_depth, context->max_call_stack_depth), max_depth - 1
+    );
+    if (num_frames > 0)
+    {
+        memcpy(
+            bundle->spawn_frames,
+            context->call_stack_frames,
+            sizeof(CTB_Frame) * num_frames
+        );
+    }
+
+    CTB_Frame *spawn_frame = &bundle->spawn_frames[num_frames];
+    spawn_frame->filename = file;
+    spawn_frame->function_name = func;
+    spawn_frame->line_number = line;
+    spawn_frame->source_code = "<Task spawned here>";
+    bundle->num_spawn_frames = num_frames + 1;
+
+    return bundle;
+}
+
+/**
+ * \brief Exchange the error storage of the calling thread's context with a detached
+ * context, keeping the live call stack of the thread in place.
+ *
+ * Both contexts must own a storage block, which all have the same layout.
+ *
+ * \param[in,out] context The context of the calling thread.
+ * \param[in,out] detached The detached context.
+ */
+static void swap_error_storage(CTB_Context *context, CTB_Context *detached)
+{
+    const CTB_Context other = *detached;
+
+    const int depth = min_int(context->call_depth, context->max_call_stack_depth);
+    if (depth > 0)
+    {
+        memcpy(
+            other.call_stack_frames,
+            context->call_stack_frames,
+            sizeof(CTB_Frame) * depth
+        );
+    }
+
+    detached->num_errors = context->num_errors;
+    detached->first_error_snapshot = context->first_error_snapshot;
+    detached->last_error = context->last_error;
+    detached->call_stack_frames = context->call_stack_frames;
+    detached->frame_signatures = context->frame_signatures;
+    detached->num_frame_signatures = 0;
+    detached->error_snapshots = context->error_snapshots;
+    detached->storage = context->storage;
+
+    /* The profiler may sample the call stack from a signal handler on this thread, so
+       the copied frames must be complete before the switch. */
+    ctb_signal_fence();
+    context->call_stack_frames = other.call_stack_frames;
+    context->frame_signatures = other.frame_signatures;
+    context->num_frame_signatures = 0;
+    context->error_snapshots = other.error_snapshots;
+    context->storage = other.storage;
+    context->num_errors = other.num_errors;
+    context->first_error_snapshot = other.first_error_snapshot;
+    context->last_error = other.last_error;
+}
+
+/**
+ * \brief Append copies of the errors of one context to another. Used when the
+ * storage cannot be exchanged because both contexts hold errors.
+ *
+ * \param[in,out] dst The context receiving the errors.
+ * \param[in] src The context holding the errors.
+ */
+static void append_errors(CTB_Context *dst, const CTB_Context *src)
+{
+    const int num_errors = ctb_get_num_stored_errors(src);
+    for (int e = 0; e < num_errors; e++)
+    {
+        const CTB_Error_Snapshot_ *snapshot = ctb_get_error_snapshot(src, e);
+        CTB_Error_Snapshot_ *merged;
+        CTB_Error_Snapshot_ *copy = ctb_reserve_error_snapshot(
+            dst, snapshot->error, &snapshot->error_frame, &merged
+        );
+        if (merged)
+        {
+            merged->count += snapshot->count;
+            continue;
+        }
+
+        if (copy)
+        {
+            copy->error = snapshot->error;
+            copy->call_depth = snapshot->call_depth;
+            copy->error_frame = snapshot->error_frame;
+            copy->count = snapshot->count;
+            copy->signature = snapshot->signature;
+            copy->os_errno = snapshot->os_errno;
+
+            const int depth = min_int(
+                snapshot->call_depth,
+                min_int(src->max_call_stack_depth, dst->max_call_stack_depth)
+            );
+            if (depth > 0)
+            {
+                memcpy(
+                    copy->call_stack_frames,
+                    snapshot->call_stack_frames,
+                    sizeof(CTB_Frame) * depth
+                );
+            }
+            snprintf(
+                copy->error_message,
+                dst->max_error_message_length,
+                "%s",
+                snapshot->error_message
+            );
+        }
+        ctb_commit_error_snapshot(dst, copy != NULL);
+    }
+
+    /* Keep the count of errors that were truncated in the source */
+    dst->num_errors += src->num_errors - num_errors;
+    if (src->num_errors > 0)
+    {
+        dst->last_error = src->last_error;
+    }
+}
+
+/**
+ * \brief Prepend the spawn frames of a bundle to the call stack of a snapshot. The
+ * most recent frames are dropped if the call stack becomes too deep.
+ *
+ * \param[in] context The context holding the snapshot.
+ * \param[in,out] snapshot The error snapshot.
+ * \param[in] bundle The error bundle.
+ */
+static void prepend_spawn_frames(
+    const CTB_Context *context,
+    CTB_Error_Snapshot_ *snapshot,
+    const CTB_Error_Bundle *bundle
+)
+{
+    const int max_depth = context->max_call_stack_depth;
+    const int shift = min_int(bundle->num_spawn_frames, max_depth);
+    const int num_kept =
+        min_int(min_int(snapshot->call_depth, max_depth), max_depth - shift);
+
+    if (num_kept > 0)
+    {
+        memmove(
+            snapshot->call_stack_frames + shift,
+            snapshot->call_stack_frames,
+            sizeof(CTB_Frame) * num_kept
+        );
+    }
+    memcpy(
+        snapshot->call_stack_frames, bundle->spawn_frames, sizeof(CTB_Frame) * shift
+    );
+    snapshot->call_depth += bundle->num_spawn_frames;
+    snapshot->signature = ctb_compute_stack_signature(
+        snapshot->call_stack_frames,
+        min_int(snapshot->call_depth, max_depth),
+        snapshot->call_depth,
+        &snapshot->error_frame
+    );
+}
+
+void ctb_error_bundle_capture(CTB_Error_Bundle *bundle)
+{
+    CTB_Context *context = peek_context();
+    if (!bundle || context->num_errors <= 0)
+    {
+        return;
+    }
+
+    if (bundle->errors.num_errors == 0 && context->storage)
+    {
+        swap_error_storage(context, &bundle->errors);
+    }
+    else
+    {
+        append_errors(&bundle->errors, context);
+        context->num_errors = 0;
+        context->first_error_snapshot = 0;
+    }
+}
+
+bool ctb_error_bundle_has_error(const CTB_Error_Bundle *bundle)
+{
+    return bundle && bundle->errors.num_errors > 0;
+}
+
+void ctb_error_bundle_raise(CTB_Error_Bundle *bundle)
+{
+    if (!bundle || bundle->errors.num_errors <= 0)
+    {
+        return;
+    }
+
+    CTB_Context *context = get_context();
+    const int first_error = context->num_errors;
+    if (first_error == 0 && context->storage)
+    {
+        swap_error_storage(context, &bundle->errors);
+    }
+    else
+    {
+        append_errors(context, &bundle->errors);
+        bundle->errors.num_errors = 0;
+        bundle->errors.first_error_snapshot = 0;
+    }
+
+    /* A ring keeps the raised errors last, overwriting earlier ones */
+    const int num_stored = ctb_get_num_stored_errors(context);
+    const int first_raised =
+        (ctb_config.retention_policy == CTB_RETAIN_LAST)
+            ? max_int(num_stored - (context->num_errors - first_error), 0)
+            : first_error;
+    for (int e = first_raised; e < num_stored; e++)
+    {
+        prepend_spawn_frames(context, ctb_get_error_snapshot(context, e), bundle);
+    }
+}
+
+void ctb_error_bundle_destroy(CTB_Error_Bundle *bundle)
+{
+    if (!bundle)
+    {
+        return;
+    }
+
+    ctb_release_context_storage(&bundle->errors);
+    ctb_free(bundle);
+}
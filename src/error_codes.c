@@ -5,94 +5,366 @@
  * \author Ching-Yin Ng
  */
 
-#include "c_traceback/error_codes.h"
+#include <errno.h>
+#include <stdbool.h>
+
+#include "c_traceback.h"
+#include "internal/atomic.h"
+#include "internal/format.h"
+
+/* Built-in errors, indexed by code */
+typedef struct
+{
+    const char *name;
+    CTB_Error parent;
+} Builtin_Error;
+
+static const Builtin_Error ctb_builtin_errors[CTB_CUSTOM_ERROR_BASE] = {
+    /* Base */
+    [CTB_ERROR] = {"Error", CTB_SUCCESS},
+    [CTB_SYSTEM_ERROR] = {"SystemError", CTB_ERROR},
+    [CTB_RESOURCE_ERROR] = {"ResourceError", CTB_ERROR},
+    [CTB_VALUE_ERROR] = {"ValueError", CTB_ERROR},
+
+    /* Signal */
+    [CTB_SIGNAL_ERROR] = {"SignalError", CTB_ERROR},
+    [CTB_SIGNAL_ABORT] = {"SignalAbort", CTB_SIGNAL_ERROR},
+    [CTB_SIGNAL_SEGMENTATION_FAULT] = {"SignalSegmentationFault", CTB_SIGNAL_ERROR},
+    [CTB_SIGNAL_INVALID_INSTRUCTION] = {"SignalInvalidInstruction", CTB_SIGNAL_ERROR},
+    [CTB_SIGNAL_TERMINATION] = {"SignalTermination", CTB_SIGNAL_ERROR},
+    [CTB_SIGNAL_FLOATING_POINT_EXCEPTION] =
+        {"SignalFloatingPointException", CTB_SIGNAL_ERROR},
+    [CTB_SIGNAL_KEYBOARD_INTERRUPT] = {"SignalKeyboardInterrupt", CTB_SIGNAL_ERROR},
+
+    /* Memory */
+    [CTB_MEMORY_ERROR] = {"MemoryError", CTB_ERROR},
+    [CTB_OUT_OF_MEMORY_ERROR] = {"OutOfMemoryError", CTB_MEMORY_ERROR},
+    [CTB_BUFFER_ERROR] = {"BufferError", CTB_MEMORY_ERROR},
+
+    /* Pointer */
+    [CTB_POINTER_ERROR] = {"PointerError", CTB_ERROR},
+    [CTB_NULL_POINTER_ERROR] = {"NullPointerError", CTB_POINTER_ERROR},
+
+    /* Runtime */
+    [CTB_RUNTIME_ERROR] = {"RuntimeError", CTB_ERROR},
+    [CTB_NOT_IMPLEMENTED_ERROR] = {"NotImplementedError", CTB_RUNTIME_ERROR},
+
+    /* Lookup */
+    [CTB_LOOKUP_ERROR] = {"LookupError", CTB_ERROR},
+    [CTB_INDEX_ERROR] = {"IndexError", CTB_LOOKUP_ERROR},
+    [CTB_KEY_ERROR] = {"KeyError", CTB_LOOKUP_ERROR},
+
+    /* Math */
+    [CTB_MATH_ERROR] = {"MathError", CTB_ERROR},
+    [CTB_MATH_DOMAIN_ERROR] = {"MathDomainError", CTB_MATH_ERROR},
+    [CTB_MATH_OVERFLOW_ERROR] = {"MathOverflowError", CTB_MATH_ERROR},
+    [CTB_MATH_UNDERFLOW_ERROR] = {"MathUnderflowError", CTB_MATH_ERROR},
+    [CTB_ZERO_DIVISION_ERROR] = {"ZeroDivisionError", CTB_MATH_ERROR},
+
+    /* OS */
+    [CTB_OS_ERROR] = {"OSError", CTB_ERROR},
+    [CTB_BLOCKING_IO_ERROR] = {"BlockingIOError", CTB_OS_ERROR},
+    [CTB_CHILD_PROCESS_ERROR] = {"ChildProcessError", CTB_OS_ERROR},
+    [CTB_FILE_EXISTS_ERROR] = {"FileExistsError", CTB_OS_ERROR},
+    [CTB_FILE_NOT_FOUND_ERROR] = {"FileNotFoundError", CTB_OS_ERROR},
+    [CTB_INTERRUPTED_ERROR] = {"InterruptedError", CTB_OS_ERROR},
+    [CTB_IS_DIRECTORY_ERROR] = {"IsDirectoryError", CTB_OS_ERROR},
+    [CTB_NOT_DIRECTORY_ERROR] = {"NotDirectoryError", CTB_OS_ERROR},
+    [CTB_PERMISSION_ERROR] = {"PermissionError", CTB_OS_ERROR},
+    [CTB_PROCESS_LOOKUP_ERROR] = {"ProcessLookupError", CTB_OS_ERROR},
+    [CTB_TIMEOUT_ERROR] = {"TimeoutError", CTB_OS_ERROR},
+
+    /* Network */
+    [CTB_NETWORK_ERROR] = {"NetworkError", CTB_ERROR},
+    [CTB_CONNECTION_FAILED_ERROR] = {"ConnectionFailedError", CTB_NETWORK_ERROR},
+    [CTB_HOST_UNREACHABLE_ERROR] = {"HostUnreachableError", CTB_NETWORK_ERROR},
+
+    /* Concurrency */
+    [CTB_CONCURRENCY_ERROR] = {"ConcurrencyError", CTB_ERROR},
+    [CTB_THREAD_CREATION_ERROR] = {"ThreadCreationError", CTB_CONCURRENCY_ERROR},
+
+    /* Parse */
+    [CTB_PARSE_ERROR] = {"ParseError", CTB_ERROR},
+    [CTB_ENCODING_ERROR] = {"EncodingError", CTB_PARSE_ERROR},
+    [CTB_INVALID_FORMAT_ERROR] = {"InvalidFormatError", CTB_PARSE_ERROR},
+    [CTB_SYNTAX_ERROR] = {"SyntaxError", CTB_PARSE_ERROR},
+    [CTB_UNEXPECTED_EOF_ERROR] = {"UnexpectedEOFError", CTB_PARSE_ERROR},
+    [CTB_CHECKSUM_MISMATCH_ERROR] = {"ChecksumMismatchError", CTB_PARSE_ERROR},
+
+    /* Dynamic Link */
+    [CTB_DYNAMIC_LINK_ERROR] = {"DynamicLinkError", CTB_ERROR},
+    [CTB_LIBRARY_LOAD_ERROR] = {"LibraryLoadError", CTB_DYNAMIC_LINK_ERROR},
+};
+
+/* Application-defined errors, indexed by code - CTB_CUSTOM_ERROR_BASE */
+typedef struct
+{
+    /* Non-zero once the other fields are written */
+    int registered;
+    CTB_Error parent;
+    CTB_Severity severity;
+    char name[CTB_MAX_ERROR_NAME_LENGTH];
+
+    /* Ancestors by depth from CTB_ERROR at depth 0 to the error itself */
+    int depth;
+    CTB_Error ancestors[CTB_MAX_ERROR_DEPTH];
+} Custom_Error;
+
+static Custom_Error ctb_custom_errors[CTB_MAX_CUSTOM_ERRORS];
+static int ctb_custom_errors_lock = 0;
+
+/**
+ * \brief Get a registered application-defined error.
+ *
+ * \return The entry, or NULL if the code is not registered.
+ */
+static const Custom_Error *get_custom_error(const CTB_Error error)
+{
+    const unsigned int index = (unsigned int)error - CTB_CUSTOM_ERROR_BASE;
+    if (index >= CTB_MAX_CUSTOM_ERRORS)
+    {
+        return NULL;
+    }
+
+    const Custom_Error *entry = &ctb_custom_errors[index];
+    return ctb_atomic_load_acquire(&entry->registered) ? entry : NULL;
+}
+
+/**
+ * \brief Check whether an error is built-in or registered.
+ */
+static bool is_known_error(const CTB_Error error)
+{
+    if (error > CTB_SUCCESS && error < CTB_CUSTOM_ERROR_BASE)
+    {
+        return ctb_builtin_errors[error].name != NULL;
+    }
+    return get_custom_error(error) != NULL;
+}
+
+/**
+ * \brief Get the depth of a known error in the hierarchy, 0 for CTB_ERROR.
+ */
+static int get_error_depth(const CTB_Error error)
+{
+    if (error > CTB_SUCCESS && error < CTB_CUSTOM_ERROR_BASE)
+    {
+        /* Built-in errors are at most two levels below CTB_ERROR */
+        if (error == CTB_ERROR)
+        {
+            return 0;
+        }
+        return (ctb_builtin_errors[error].parent == CTB_ERROR) ? 1 : 2;
+    }
+
+    const Custom_Error *entry = get_custom_error(error);
+    return entry ? entry->depth : -1;
+}
+
+bool ctb_register_error(
+    const CTB_Error code,
+    const char *name,
+    const CTB_Error parent,
+    const CTB_Severity severity
+)
+{
+    const unsigned int index = (unsigned int)code - CTB_CUSTOM_ERROR_BASE;
+    if (index >= CTB_MAX_CUSTOM_ERRORS || !name)
+    {
+        return false;
+    }
+
+    const CTB_Error parent_error = (parent == CTB_SUCCESS) ? CTB_ERROR : parent;
+    if (!is_known_error(parent_error) || parent_error == code)
+    {
+        return false;
+    }
+
+    const int depth = get_error_depth(parent_error) + 1;
+    if (depth >= CTB_MAX_ERROR_DEPTH)
+    {
+        return false;
+    }
+
+    bool registered = false;
+    ctb_spin_lock(&ctb_custom_errors_lock);
+    Custom_Error *entry = &ctb_custom_errors[index];
+    if (!entry->registered)
+    {
+        entry->parent = parent_error;
+        entry->severity = severity;
+        ctb_format(entry->name, sizeof(entry->name), "%s", name);
+
+        entry->depth = depth;
+        entry->ancestors[depth] = code;
+        CTB_Error ancestor = parent_error;
+        for (int d = depth - 1; d >= 0; d--)
+        {
+            entry->ancestors[d] = ancestor;
+            ancestor = ctb_get_error_parent(ancestor);
+        }
+
+        /* Publish the entry to lock-free readers */
+        ctb_atomic_store_release(&entry->registered, 1);
+        registered = true;
+    }
+    ctb_spin_unlock(&ctb_custom_errors_lock);
+
+    return registered;
+}
+
+CTB_Error ctb_get_error_parent(const CTB_Error error)
+{
+    if (error > CTB_SUCCESS && error < CTB_CUSTOM_ERROR_BASE)
+    {
+        return ctb_builtin_errors[error].parent;
+    }
+
+    const Custom_Error *entry = get_custom_error(error);
+    return entry ? entry->parent : CTB_SUCCESS;
+}
+
+bool ctb_error_is_a(const CTB_Error error, const CTB_Error base)
+{
+    if (error == base)
+    {
+        return true;
+    }
+
+    if (error > CTB_SUCCESS && error < CTB_CUSTOM_ERROR_BASE)
+    {
+        /* Built-in errors are at most two levels below CTB_ERROR */
+        const CTB_Error parent = ctb_builtin_errors[error].parent;
+        if (base <= CTB_SUCCESS || parent == CTB_SUCCESS)
+        {
+            return false;
+        }
+        return parent == base || ctb_builtin_errors[parent].parent == base;
+    }
+
+    const Custom_Error *entry = get_custom_error(error);
+    if (!entry)
+    {
+        return false;
+    }
+
+    const int base_depth = get_error_depth(base);
+    return base_depth >= 0 && base_depth < entry->depth &&
+           entry->ancestors[base_depth] == base;
+}
+
+CTB_Error ctb_error_from_errno(const int os_errno)
+{
+    switch (os_errno)
+    {
+    case EAGAIN:
+#if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+    case EWOULDBLOCK:
+#endif
+#ifdef EINPROGRESS
+    case EINPROGRESS:
+#endif
+#ifdef EALREADY
+    case EALREADY:
+#endif
+        return CTB_BLOCKING_IO_ERROR;
+    case ECHILD:
+        return CTB_CHILD_PROCESS_ERROR;
+    case EEXIST:
+        return CTB_FILE_EXISTS_ERROR;
+    case ENOENT:
+        return CTB_FILE_NOT_FOUND_ERROR;
+    case EINTR:
+        return CTB_INTERRUPTED_ERROR;
+    case EISDIR:
+        return CTB_IS_DIRECTORY_ERROR;
+    case ENOTDIR:
+        return CTB_NOT_DIRECTORY_ERROR;
+    case EACCES:
+    case EPERM:
+        return CTB_PERMISSION_ERROR;
+    case ESRCH:
+        return CTB_PROCESS_LOOKUP_ERROR;
+#ifdef ETIMEDOUT
+    case ETIMEDOUT:
+        return CTB_TIMEOUT_ERROR;
+#endif
+    case EPIPE:
+#ifdef ECONNREFUSED
+    case ECONNREFUSED:
+#endif
+#ifdef ECONNRESET
+    case ECONNRESET:
+#endif
+#ifdef ECONNABORTED
+    case ECONNABORTED:
+#endif
+        return CTB_CONNECTION_FAILED_ERROR;
+#ifdef EHOSTUNREACH
+    case EHOSTUNREACH:
+#endif
+#ifdef ENETUNREACH
+    case ENETUNREACH:
+#endif
+        return CTB_HOST_UNREACHABLE_ERROR;
+    case ENOMEM:
+        return CTB_OUT_OF_MEMORY_ERROR;
+    default:
+        return CTB_OS_ERROR;
+    }
+}
+
+CTB_Severity ctb_get_error_severity(const CTB_Error error)
+{
+    if (error >= CTB_SIGNAL_ERROR && error < CTB_MEMORY_ERROR)
+    {
+        return CTB_SEVERITY_CRITICAL;
+    }
+
+    const Custom_Error *entry = get_custom_error(error);
+    return entry ? entry->severity : CTB_SEVERITY_ERROR;
+}
+
+const char *severity_to_string(const CTB_Severity severity)
+{
+    switch (severity)
+    {
+        case CTB_SEVERITY_WARNING:
+            return "warning";
+        case CTB_SEVERITY_CRITICAL:
+            return "critical";
+        case CTB_SEVERITY_ERROR:
+        default:
+            return "error";
+    }
+}
 
-// clang-format off
 const char *error_to_string(CTB_Error error)
 {
+    if (error > CTB_SUCCESS && error < CTB_CUSTOM_ERROR_BASE)
+    {
+        const char *name = ctb_builtin_errors[error].name;
+        return name ? name : "Unrecognized Error Code";
+    }
+
+    const Custom_Error *entry = get_custom_error(error);
+    if (entry)
+    {
+        return entry->name;
+    }
+
     switch (error)
     {
-        case CTB_SUCCESS:                       return "Success";
-        case CTB_UNKNOWN_ERROR:                 return "Unknown Error";
-        
-        /* Base */
-        case CTB_ERROR:                         return "Error";
-        case CTB_SYSTEM_ERROR:                  return "SystemError";
-        case CTB_RESOURCE_ERROR:                return "ResourceError";
-        case CTB_VALUE_ERROR:                   return "ValueError";
-
-        /* Signal */
-        case CTB_SIGNAL_ERROR:                  return "SignalError";
-        case CTB_SIGNAL_ABORT:                  return "SignalAbort";
-        case CTB_SIGNAL_SEGMENTATION_FAULT:     return "SignalSegmentationFault";
-        case CTB_SIGNAL_INVALID_INSTRUCTION:    return "SignalInvalidInstruction";
-        case CTB_SIGNAL_TERMINATION:            return "SignalTermination";
-        case CTB_SIGNAL_FLOATING_POINT_EXCEPTION: return "SignalFloatingPointException";
-        case CTB_SIGNAL_KEYBOARD_INTERRUPT:     return "SignalKeyboardInterrupt";
-
-        /* Memory */
-        case CTB_MEMORY_ERROR:                  return "MemoryError";
-        case CTB_OUT_OF_MEMORY_ERROR:           return "OutOfMemoryError";
-        case CTB_BUFFER_ERROR:                  return "BufferError";
-
-        /* Pointer */
-        case CTB_POINTER_ERROR:                 return "PointerError";
-        case CTB_NULL_POINTER_ERROR:            return "NullPointerError";
-
-        /* Runtime */
-        case CTB_RUNTIME_ERROR:                 return "RuntimeError";
-        case CTB_NOT_IMPLEMENTED_ERROR:         return "NotImplementedError";
-
-        /* Lookup */
-        case CTB_LOOKUP_ERROR:                  return "LookupError";
-        case CTB_INDEX_ERROR:                   return "IndexError";
-        case CTB_KEY_ERROR:                     return "KeyError";
-        
-        /* Math */
-        case CTB_MATH_ERROR:                    return "MathError";
-        case CTB_MATH_DOMAIN_ERROR:             return "MathDomainError";
-        case CTB_MATH_OVERFLOW_ERROR:           return "MathOverflowError";
-        case CTB_MATH_UNDERFLOW_ERROR:          return "MathUnderflowError";
-        case CTB_ZERO_DIVISION_ERROR:           return "ZeroDivisionError";
-
-        /* OS */
-        case CTB_OS_ERROR:                      return "OSError";
-        case CTB_BLOCKING_IO_ERROR:             return "BlockingIOError";
-        case CTB_CHILD_PROCESS_ERROR:           return "ChildProcessError";
-        case CTB_FILE_EXISTS_ERROR:             return "FileExistsError";
-        case CTB_FILE_NOT_FOUND_ERROR:          return "FileNotFoundError";
-        case CTB_INTERRUPTED_ERROR:             return "InterruptedError";
-        case CTB_IS_DIRECTORY_ERROR:            return "IsDirectoryError";
-        case CTB_NOT_DIRECTORY_ERROR:           return "NotDirectoryError";
-        case CTB_PERMISSION_ERROR:              return "PermissionError";
-        case CTB_PROCESS_LOOKUP_ERROR:          return "ProcessLookupError";
-        case CTB_TIMEOUT_ERROR:                 return "TimeoutError";
-
-        /* Network */
-        case CTB_NETWORK_ERROR:                 return "NetworkError";
-        case CTB_CONNECTION_FAILED_ERROR:       return "ConnectionFailedError";
-        case CTB_HOST_UNREACHABLE_ERROR:        return "HostUnreachableError";
-
-        /* Concurrency */
-        case CTB_CONCURRENCY_ERROR:             return "ConcurrencyError";
-        case CTB_THREAD_CREATION_ERROR:         return "ThreadCreationError";
-
-        /* Parse */
-        case CTB_PARSE_ERROR:                   return "ParseError";
-        case CTB_ENCODING_ERROR:                return "EncodingError";
-        case CTB_INVALID_FORMAT_ERROR:          return "InvalidFormatError";
-        case CTB_SYNTAX_ERROR:                  return "SyntaxError";
-        case CTB_UNEXPECTED_EOF_ERROR:          return "UnexpectedEOFError";
-        case CTB_CHECKSUM_MISMATCH_ERROR:       return "ChecksumMismatchError";
-
-        /* Dynamic Link */
-        case CTB_DYNAMIC_LINK_ERROR:            return "DynamicLinkError";
-        case CTB_LIBRARY_LOAD_ERROR:            return "LibraryLoadError";
-
-        default:                                return "Unrecognized Error Code";
+        case CTB_SUCCESS:
+            return "Success";
+        case CTB_UNKNOWN_ERROR:
+            return "Unknown Error";
+        default:
+            return "Unrecognized Error Code";
     }
 }
 
+// clang-format off
 const char *warning_to_string(CTB_Warning warning)
 {
     switch (warning)
@@ -0,0 +1,691 @@
+/**
+ * \file format.c
+ * \brief Fast string formatting and per-thread formatting arena for C Traceback.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "internal/alloc.h"
+#include "internal/format.h"
+#include "internal/trace.h"
+
+/* Size of the thread-local buffer used before the arena moves to the heap */
+#define CTB_FORMAT_INLINE_SIZE 1024
+
+typedef struct CTB_Format_Output_
+{
+    char *buffer;
+    size_t size;
+    size_t length;
+} CTB_Format_Output_;
+
+static ctb_thread_local char ctb_format_inline_buffer[CTB_FORMAT_INLINE_SIZE];
+static ctb_thread_local CTB_Format_Arena_ ctb_format_arena = {NULL, 0, 0};
+
+/**
+ * \brief Append a character to the output, counting it even if it does not fit.
+ */
+static inline void put_char(CTB_Format_Output_ *out, const char c)
+{
+    if (out->length + 1 < out->size)
+    {
+        out->buffer[out->length] = c;
+    }
+    out->length++;
+}
+
+/**
+ * \brief Append a repeated character to the output.
+ */
+static void put_repeat(CTB_Format_Output_ *out, const char c, int count)
+{
+    for (; count > 0; count--)
+    {
+        put_char(out, c);
+    }
+}
+
+/**
+ * \brief Append a string to the output.
+ */
+static void put_string(CTB_Format_Output_ *out, const char *str, const size_t length)
+{
+    if (out->length + 1 < out->size)
+    {
+        const size_t space = out->size - 1 - out->length;
+        memcpy(out->buffer + out->length, str, (length < space) ? length : space);
+    }
+    out->length += length;
+}
+
+/**
+ * \brief Append a field padded to the given width. Zero padding goes between the
+ * prefix (sign or "0x") and the body.
+ */
+static void put_field(
+    CTB_Format_Output_ *out,
+    const char *prefix,
+    const char *body,
+    const size_t body_length,
+    const int width,
+    const bool left_align,
+    const bool zero_pad
+)
+{
+    const size_t prefix_length = strlen(prefix);
+    const int padding = width - (int)(prefix_length + body_length);
+
+    if (!left_align && !zero_pad)
+    {
+        put_repeat(out, ' ', padding);
+    }
+    put_string(out, prefix, prefix_length);
+    if (!left_align && zero_pad)
+    {
+        put_repeat(out, '0', padding);
+    }
+    put_string(out, body, body_length);
+    if (left_align)
+    {
+        put_repeat(out, ' ', padding);
+    }
+}
+
+/* Decimal digits of 00 to 99, two characters per entry */
+static const char ctb_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/**
+ * \brief Convert an unsigned integer to decimal digits, two at a time, written
+ * backwards from the end of the buffer. Async-signal-safe.
+ *
+ * \return Pointer to the first digit.
+ */
+static char *decimal_to_digits(unsigned long long value, char *end)
+{
+    char *p = end;
+    while (value >= 100)
+    {
+        const size_t pair = (size_t)(value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        memcpy(p, &ctb_digit_pairs[pair], 2);
+    }
+
+    if (value >= 10)
+    {
+        p -= 2;
+        memcpy(p, &ctb_digit_pairs[value * 2], 2);
+    }
+    else
+    {
+        *--p = (char)('0' + value);
+    }
+    return p;
+}
+
+/**
+ * \brief Convert an unsigned integer to digits, written backwards from the end of
+ * the buffer.
+ *
+ * \return Pointer to the first digit.
+ */
+static char *
+unsigned_to_digits(unsigned long long value, const unsigned base, char *end)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    if (base == 10)
+    {
+        return decimal_to_digits(value, end);
+    }
+
+    char *p = end;
+    do
+    {
+        *--p = hex[value % base];
+        value /= base;
+    } while (value > 0);
+    return p;
+}
+
+size_t ctb_format_uint(char *buffer, const unsigned long long value, int min_width)
+{
+    /* Digits are written over zeros, so padding is just a longer copy */
+    char digits[CTB_FORMAT_INT_SIZE];
+    memset(digits, '0', sizeof(digits));
+    char *const end = digits + sizeof(digits);
+    const size_t num_digits = (size_t)(end - decimal_to_digits(value, end));
+
+    min_width = (min_width < 0) ? 0 : min_width;
+    min_width = (min_width > CTB_FORMAT_INT_SIZE) ? CTB_FORMAT_INT_SIZE : min_width;
+    const size_t length =
+        (num_digits > (size_t)min_width) ? num_digits : (size_t)min_width;
+
+    memcpy(buffer, end - length, length);
+    return length;
+}
+
+size_t ctb_format_int(char *buffer, const long long value, const int min_width)
+{
+    const bool negative = (value < 0);
+    const unsigned long long magnitude =
+        negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    buffer[0] = '-';
+    return (size_t)negative +
+           ctb_format_uint(buffer + negative, magnitude, min_width - negative);
+}
+
+int ctb_vformat(
+    char *restrict buffer, const size_t size, const char *restrict fmt, va_list args
+)
+{
+    CTB_Format_Output_ out = {buffer, size, 0};
+    char digits[32];
+    char *const digits_end = digits + sizeof(digits);
+
+    va_list fast_args;
+    va_copy(fast_args, args);
+
+    for (const char *p = fmt; *p; p++)
+    {
+        if (*p != '%')
+        {
+            put_char(&out, *p);
+            continue;
+        }
+        p++;
+
+        /* Flags */
+        bool left_align = false;
+        bool zero_pad = false;
+        for (;; p++)
+        {
+            if (*p == '-')
+            {
+                left_align = true;
+            }
+            else if (*p == '0')
+            {
+                zero_pad = true;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        /* Width */
+        int width = 0;
+        if (*p == '*')
+        {
+            width = va_arg(fast_args, int);
+            if (width < 0)
+            {
+                left_align = true;
+                width = -width;
+            }
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+        {
+            width = width * 10 + (*p - '0');
+            p++;
+        }
+
+        /* Precision, only supported for strings */
+        int precision = -1;
+        if (*p == '.')
+        {
+            p++;
+            precision = 0;
+            if (*p == '*')
+            {
+                precision = va_arg(fast_args, int);
+                p++;
+            }
+            while (*p >= '0' && *p <= '9')
+            {
+                precision = precision * 10 + (*p - '0');
+                p++;
+            }
+            if (*p != 's')
+            {
+                goto fallback;
+            }
+        }
+
+        /* Length modifier: 1 for l, 2 for ll, 3 for z */
+        int modifier = 0;
+        if (*p == 'l')
+        {
+            modifier = (p[1] == 'l') ? 2 : 1;
+            p += modifier;
+        }
+        else if (*p == 'z')
+        {
+            modifier = 3;
+            p++;
+        }
+
+        switch (*p)
+        {
+            case '%':
+                put_char(&out, '%');
+                break;
+
+            case 'c':
+            {
+                if (modifier != 0)
+                {
+                    goto fallback;
+                }
+                const char c = (char)va_arg(fast_args, int);
+                put_field(&out, "", &c, 1, width, left_align, false);
+                break;
+            }
+
+            case 's':
+            {
+                if (modifier != 0)
+                {
+                    goto fallback;
+                }
+                const char *str = va_arg(fast_args, const char *);
+                if (!str)
+                {
+                    str = "(null)";
+                }
+                size_t length = 0;
+                if (precision >= 0)
+                {
+                    while (length < (size_t)precision && str[length])
+                    {
+                        length++;
+                    }
+                }
+                else
+                {
+                    length = strlen(str);
+                }
+                put_field(&out, "", str, length, width, left_align, false);
+                break;
+            }
+
+            case 'd':
+            case 'i':
+            {
+                long long value;
+                if (modifier == 2)
+                {
+                    value = va_arg(fast_args, long long);
+                }
+                else if (modifier == 1)
+                {
+                    value = va_arg(fast_args, long);
+                }
+                else if (modifier == 3)
+                {
+                    value = va_arg(fast_args, ptrdiff_t);
+                }
+                else
+                {
+                    value = va_arg(fast_args, int);
+                }
+
+                const unsigned long long magnitude =
+                    (value < 0) ? 0ULL - (unsigned long long)value
+                                : (unsigned long long)value;
+                const char *first = unsigned_to_digits(magnitude, 10, digits_end);
+                put_field(
+                    &out,
+                    (value < 0) ? "-" : "",
+                    first,
+                    (size_t)(digits_end - first),
+                    width,
+                    left_align,
+                    zero_pad
+                );
+                break;
+            }
+
+            case 'u':
+            case 'x':
+            {
+                unsigned long long value;
+                if (modifier == 2)
+                {
+                    value = va_arg(fast_args, unsigned long long);
+                }
+                else if (modifier == 1)
+                {
+                    value = va_arg(fast_args, unsigned long);
+                }
+                else if (modifier == 3)
+                {
+                    value = va_arg(fast_args, size_t);
+                }
+                else
+                {
+                    value = va_arg(fast_args, unsigned int);
+                }
+
+                const char *first =
+                    unsigned_to_digits(value, (*p == 'x') ? 16 : 10, digits_end);
+                put_field(
+                    &out,
+                    "",
+                    first,
+                    (size_t)(digits_end - first),
+                    width,
+                    left_align,
+                    zero_pad
+                );
+                break;
+            }
+
+            case 'p':
+            {
+                if (modifier != 0)
+                {
+                    goto fallback;
+                }
+                const uintptr_t value = (uintptr_t)va_arg(fast_args, void *);
+                if (value == 0)
+                {
+                    /* The C library decides how to print NULL, e.g. "(nil)" */
+                    goto fallback;
+                }
+                const char *first = unsigned_to_digits(value, 16, digits_end);
+                put_field(
+                    &out,
+                    "0x",
+                    first,
+                    (size_t)(digits_end - first),
+                    width,
+                    left_align,
+                    zero_pad
+                );
+                break;
+            }
+
+            default:
+                goto fallback;
+        }
+    }
+
+    va_end(fast_args);
+    if (size > 0)
+    {
+        buffer[(out.length < size) ? out.length : size - 1] = '\0';
+    }
+    return (int)out.length;
+
+fallback:
+    va_end(fast_args);
+    return vsnprintf(buffer, size, fmt, args);
+}
+
+int ctb_format(char *restrict buffer, const size_t size, const char *restrict fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    const int length = ctb_vformat(buffer, size, fmt, args);
+    va_end(args);
+    return length;
+}
+
+/**
+ * \brief Grow an arena to hold at least the given number of bytes.
+ *
+ * \return true if the arena is large enough, false if it cannot grow.
+ */
+static bool reserve_arena(CTB_Format_Arena_ *arena, const size_t capacity)
+{
+    if (capacity <= arena->capacity)
+    {
+        return true;
+    }
+
+    size_t new_capacity = 2 * arena->capacity;
+    if (new_capacity < capacity)
+    {
+        new_capacity = capacity;
+    }
+
+    char *data;
+    if (arena->data == ctb_format_inline_buffer)
+    {
+        data = ctb_malloc(new_capacity);
+        if (data)
+        {
+            memcpy(data, arena->data, arena->length + 1);
+        }
+    }
+    else
+    {
+        data = ctb_realloc(arena->data, new_capacity);
+    }
+
+    if (!data)
+    {
+        return false;
+    }
+    arena->data = data;
+    arena->capacity = new_capacity;
+    return true;
+}
+
+CTB_Format_Arena_ *ctb_format_arena_begin(void)
+{
+    CTB_Format_Arena_ *arena = &ctb_format_arena;
+    if (!arena->data)
+    {
+        arena->data = ctb_format_inline_buffer;
+        arena->capacity = CTB_FORMAT_INLINE_SIZE;
+    }
+    arena->length = 0;
+    arena->data[0] = '\0';
+    return arena;
+}
+
+void ctb_format_append(CTB_Format_Arena_ *arena, const char *str, size_t length)
+{
+    if (!reserve_arena(arena, arena->length + length + 1))
+    {
+        length = arena->capacity - arena->length - 1;
+    }
+    memcpy(arena->data + arena->length, str, length);
+    arena->length += length;
+    arena->data[arena->length] = '\0';
+}
+
+void ctb_format_append_str(CTB_Format_Arena_ *arena, const char *str)
+{
+    if (!str)
+    {
+        str = "(null)";
+    }
+    ctb_format_append(arena, str, strlen(str));
+}
+
+void ctb_format_append_int(
+    CTB_Format_Arena_ *arena, const long long value, const int min_width
+)
+{
+    char digits[CTB_FORMAT_INT_SIZE + 1];
+    ctb_format_append(arena, digits, ctb_format_int(digits, value, min_width));
+}
+
+void ctb_format_vappendf(CTB_Format_Arena_ *arena, const char *fmt, va_list args)
+{
+    va_list retry_args;
+    va_copy(retry_args, args);
+
+    const size_t space = arena->capacity - arena->length;
+    const int length = ctb_vformat(arena->data + arena->length, space, fmt, args);
+    if (length < 0)
+    {
+        arena->data[arena->length] = '\0';
+        va_end(retry_args);
+        return;
+    }
+
+    size_t appended = (size_t)length;
+    if (appended >= space)
+    {
+        if (reserve_arena(arena, arena->length + appended + 1))
+        {
+            ctb_vformat(
+                arena->data + arena->length,
+                arena->capacity - arena->length,
+                fmt,
+                retry_args
+            );
+        }
+        else
+        {
+            /* Keep the truncated output */
+            appended = space - 1;
+        }
+    }
+    va_end(retry_args);
+
+    arena->length += appended;
+}
+
+void ctb_format_appendf(CTB_Format_Arena_ *arena, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    ctb_format_vappendf(arena, fmt, args);
+    va_end(args);
+}
+
+/**
+ * \brief Get the length of a byte escaped in a JSON string literal.
+ */
+static inline size_t json_escaped_length(const unsigned char c)
+{
+    if (c == '"' || c == '\\' || c == '\n' || c == '\t')
+    {
+        return 2;
+    }
+    return (c < 0x20) ? 6 : 1;
+}
+
+void ctb_format_escape_json(CTB_Format_Arena_ *arena, const size_t offset)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    const size_t raw_length = arena->length - offset;
+    size_t escaped_length = raw_length + 2;
+    for (size_t i = offset; i < arena->length; i++)
+    {
+        escaped_length += json_escaped_length((unsigned char)arena->data[i]) - 1;
+    }
+
+    if (!reserve_arena(arena, offset + escaped_length + 1))
+    {
+        arena->length = offset;
+        ctb_format_append(arena, "\"\"", 2);
+        return;
+    }
+
+    /*
+     * Move the raw text to the end of the escaped range and escape it forwards.
+     * The write position never overtakes the read position.
+     */
+    char *const data = arena->data;
+    const size_t shift = escaped_length - raw_length;
+    memmove(data + offset + shift, data + offset, raw_length);
+
+    const unsigned char *read = (const unsigned char *)data + offset + shift;
+    const unsigned char *const end = read + raw_length;
+    char *write = data + offset;
+
+    *write++ = '"';
+    while (read < end)
+    {
+        /* Copy runs that need no escaping with a single memmove */
+        const unsigned char *run = read;
+        while (run < end && json_escaped_length(*run) == 1)
+        {
+            run++;
+        }
+        if (run > read)
+        {
+            memmove(write, read, (size_t)(run - read));
+            write += run - read;
+            read = run;
+            continue;
+        }
+
+        const unsigned char c = *read++;
+        *write++ = '\\';
+        switch (c)
+        {
+            case '"':
+                *write++ = '"';
+                break;
+            case '\\':
+                *write++ = '\\';
+                break;
+            case '\n':
+                *write++ = 'n';
+                break;
+            case '\t':
+                *write++ = 't';
+                break;
+            default:
+                memcpy(write, "u00", 3);
+                write[3] = hex[c >> 4];
+                write[4] = hex[c & 0xF];
+                write += 5;
+                break;
+        }
+    }
+    *write++ = '"';
+
+    arena->length = offset + escaped_length;
+    data[arena->length] = '\0';
+}
+
+void ctb_format_append_json_string(CTB_Format_Arena_ *arena, const char *str)
+{
+    const size_t offset = arena->length;
+    ctb_format_append(arena, str ? str : "", str ? strlen(str) : 0);
+    ctb_format_escape_json(arena, offset);
+}
+
+void ctb_format_arena_write(CTB_Format_Arena_ *arena, FILE *stream)
+{
+    if (arena->length > 0)
+    {
+        fwrite(arena->data, 1, arena->length, stream);
+    }
+    arena->length = 0;
+    arena->data[0] = '\0';
+}
+
+void ctb_release_format_arena(void)
+{
+    CTB_Format_Arena_ *arena = &ctb_format_arena;
+    if (arena->data && arena->data != ctb_format_inline_buffer)
+    {
+        ctb_free(arena->data);
+    }
+    arena->data = NULL;
+    arena->length = 0;
+    arena->capacity = 0;
+}
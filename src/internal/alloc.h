@@ -0,0 +1,84 @@
+/**
+ * \file alloc.h
+ * \brief Memory allocation for all memory owned by C Traceback library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_ALLOC_H
+#define C_TRACEBACK_INTERNAL_ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "c_traceback.h"
+
+/**
+ * \brief Check that allocator hooks are either all set or all NULL.
+ *
+ * \param[in] allocator The allocator hooks.
+ * \return true if the hooks can be installed.
+ */
+bool ctb_is_valid_allocator(const CTB_Allocator *allocator);
+
+/**
+ * \brief Set the allocator and the size of the emergency reserve.
+ *
+ * \param[in] allocator The allocator hooks, all NULL for the pool allocator.
+ * \param[in] emergency_reserve_size Size of the emergency reserve in bytes.
+ * \return true on success, false if the hooks are invalid or memory has already
+ * been allocated.
+ */
+bool ctb_set_allocator(
+    const CTB_Allocator *allocator, const size_t emergency_reserve_size
+);
+
+/**
+ * \brief Allocate memory, falling back to the emergency reserve on failure.
+ *
+ * \param[in] size Number of bytes to allocate.
+ * \return Pointer to the memory, or NULL on failure.
+ */
+void *ctb_malloc(const size_t size);
+
+/**
+ * \brief Allocate zero-initialized memory for an array.
+ *
+ * \param[in] count Number of elements.
+ * \param[in] size Size of each element.
+ * \return Pointer to the memory, or NULL on failure.
+ */
+void *ctb_calloc(const size_t count, const size_t size);
+
+/**
+ * \brief Resize memory returned by ctb_malloc.
+ *
+ * \param[in] ptr Pointer to the memory, or NULL.
+ * \param[in] size New size in bytes.
+ * \return Pointer to the resized memory, or NULL on failure (ptr stays valid).
+ */
+void *ctb_realloc(void *ptr, const size_t size);
+
+/**
+ * \brief Free memory returned by ctb_malloc. Memory from the emergency reserve is
+ * never reclaimed.
+ *
+ * \param[in] ptr Pointer to the memory, or NULL.
+ */
+void ctb_free(void *ptr);
+
+/**
+ * \brief Return the objects cached by the calling thread to the shared pool when
+ * it exits.
+ */
+void ctb_release_pool_cache(void);
+
+/**
+ * \brief Async-signal-safe allocation from the emergency reserve only.
+ *
+ * \param[in] size Number of bytes to allocate.
+ * \return Pointer to the memory, or NULL if the reserve is exhausted.
+ */
+void *ctb_emergency_malloc(const size_t size);
+
+#endif /* C_TRACEBACK_INTERNAL_ALLOC_H */
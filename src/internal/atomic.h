@@ -0,0 +1,112 @@
+/**
+ * \file atomic.h
+ * \brief Minimal atomic operations and spinlock for C Traceback library.
+ *
+ * The library is written in C99, which has no <stdatomic.h>, so the compiler
+ * builtins are wrapped here instead.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_ATOMIC_H
+#define C_TRACEBACK_INTERNAL_ATOMIC_H
+
+#include <stdbool.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+
+// clang-format off
+#define ctb_atomic_load_relaxed(ptr)        __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define ctb_atomic_load_acquire(ptr)        __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define ctb_atomic_store_relaxed(ptr, val)  __atomic_store_n((ptr), (val), __ATOMIC_RELAXED)
+#define ctb_atomic_store_release(ptr, val)  __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define ctb_atomic_fetch_add(ptr, val)      __atomic_fetch_add((ptr), (val), __ATOMIC_ACQ_REL)
+#define ctb_atomic_exchange(ptr, val)       __atomic_exchange_n((ptr), (val), __ATOMIC_ACQ_REL)
+#define ctb_atomic_compare_exchange(ptr, expected, desired)                            \
+    __atomic_compare_exchange_n(                                                       \
+        (ptr), (expected), (desired), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE        \
+    )
+
+/* Compiler-only barrier: orders memory accesses against a signal handler on the
+   same thread without emitting a fence instruction. */
+#define ctb_signal_fence()                  __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#define ctb_cpu_relax()                     ((void)0)
+// clang-format on
+
+#elif defined(_MSC_VER)
+#include <intrin.h>
+
+/* Aligned word-sized loads and stores are atomic on every target MSVC supports. */
+#define ctb_atomic_load_relaxed(ptr) (*(ptr))
+#define ctb_atomic_load_acquire(ptr) (*(ptr))
+#define ctb_atomic_store_relaxed(ptr, val) ((void)(*(ptr) = (val)))
+#define ctb_atomic_store_release(ptr, val) ((void)(*(ptr) = (val)))
+#define ctb_atomic_fetch_add(ptr, val)                                                 \
+    ((sizeof(*(ptr)) == 8)                                                             \
+         ? _InterlockedExchangeAdd64((volatile __int64 *)(ptr), (__int64)(val))        \
+         : _InterlockedExchangeAdd((volatile long *)(ptr), (long)(val)))
+#define ctb_atomic_exchange(ptr, val)                                                  \
+    ((sizeof(*(ptr)) == 8)                                                             \
+         ? _InterlockedExchange64((volatile __int64 *)(ptr), (__int64)(val))           \
+         : _InterlockedExchange((volatile long *)(ptr), (long)(val)))
+#define ctb_atomic_compare_exchange(ptr, expected, desired)                            \
+    ctb_msvc_compare_exchange_(                                                        \
+        (volatile void *)(ptr), (void *)(expected), (__int64)(desired), sizeof(*(ptr)) \
+    )
+#define ctb_signal_fence() _ReadWriteBarrier()
+#define ctb_cpu_relax() _mm_pause()
+
+static inline bool ctb_msvc_compare_exchange_(
+    volatile void *ptr, void *expected, __int64 desired, size_t size
+)
+{
+    if (size == 8)
+    {
+        const __int64 old = *(__int64 *)expected;
+        const __int64 prev =
+            _InterlockedCompareExchange64((volatile __int64 *)ptr, desired, old);
+        *(__int64 *)expected = prev;
+        return prev == old;
+    }
+
+    const long old = *(long *)expected;
+    const long prev =
+        _InterlockedCompareExchange((volatile long *)ptr, (long)desired, old);
+    *(long *)expected = prev;
+    return prev == old;
+}
+
+#else
+#error "Atomic operations are not supported for this compiler."
+#endif
+
+/**
+ * \brief Acquire a spinlock.
+ *
+ * Only used to guard rare operations (e.g. registering a new thread), never on
+ * the tracing hot path.
+ *
+ * \param[in,out] lock The lock word, zero when unlocked.
+ */
+static inline void ctb_spin_lock(int *lock)
+{
+    while (ctb_atomic_exchange(lock, 1))
+    {
+        while (ctb_atomic_load_relaxed(lock))
+        {
+            ctb_cpu_relax();
+        }
+    }
+}
+
+/**
+ * \brief Release a spinlock.
+ *
+ * \param[in,out] lock The lock word.
+ */
+static inline void ctb_spin_unlock(int *lock)
+{
+    ctb_atomic_store_release(lock, 0);
+}
+
+#endif /* C_TRACEBACK_INTERNAL_ATOMIC_H */
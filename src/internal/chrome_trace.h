@@ -0,0 +1,42 @@
+/**
+ * \file chrome_trace.h
+ * \brief Internal hooks for recording Chrome trace events.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_CHROME_TRACE_H
+#define C_TRACEBACK_INTERNAL_CHROME_TRACE_H
+
+#include "c_traceback.h"
+
+/* Non-zero while a Chrome trace is being recorded */
+extern int ctb_chrome_trace_enabled;
+
+/**
+ * \brief Record the begin event of a call stack frame.
+ *
+ * \param[in] frame The pushed frame.
+ */
+void ctb_chrome_trace_begin_event(const CTB_Frame *frame);
+
+/**
+ * \brief Record the end event of the innermost call stack frame.
+ */
+void ctb_chrome_trace_end_event(void);
+
+/**
+ * \brief Record an instant event for a thrown error.
+ *
+ * \param[in] error The error type.
+ * \param[in] error_frame The frame where the error is thrown.
+ */
+void ctb_chrome_trace_error_event(const CTB_Error error, const CTB_Frame *error_frame);
+
+/**
+ * \brief Release the event buffer of the calling thread when it exits. The buffer
+ * is reused by a new thread once its remaining events have been written.
+ */
+void ctb_release_chrome_trace_buffer(void);
+
+#endif /* C_TRACEBACK_INTERNAL_CHROME_TRACE_H */
@@ -0,0 +1,69 @@
+/**
+ * \file clock.h
+ * \brief Timestamp sources for C Traceback library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_CLOCK_H
+#define C_TRACEBACK_INTERNAL_CLOCK_H
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CTB_HAS_CYCLE_COUNTER 1
+#elif (defined(__GNUC__) || defined(__clang__)) &&                                     \
+    (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define CTB_HAS_CYCLE_COUNTER 1
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+#define CTB_HAS_CYCLE_COUNTER 1
+#else
+#define CTB_HAS_CYCLE_COUNTER 0
+#endif
+
+/**
+ * \brief Get a monotonic timestamp in nanoseconds.
+ *
+ * \return Nanoseconds since an unspecified starting point.
+ */
+unsigned long long ctb_clock_ns(void);
+
+/**
+ * \brief Get the wall clock time in nanoseconds. It is async-signal-safe on POSIX
+ * systems.
+ *
+ * \return Nanoseconds since the Unix epoch.
+ */
+unsigned long long ctb_clock_realtime_ns(void);
+
+/**
+ * \brief Get the number of ticks returned by ctb_clock_ticks per nanosecond.
+ *
+ * The ratio is calibrated against ctb_clock_ns once and cached afterwards.
+ *
+ * \return Ticks per nanosecond.
+ */
+double ctb_clock_ticks_per_ns(void);
+
+/**
+ * \brief Read the cheapest available timestamp counter.
+ *
+ * On x86 and AArch64 this reads the hardware cycle counter directly, falling back to
+ * ctb_clock_ns elsewhere.
+ *
+ * \return Ticks since an unspecified starting point.
+ */
+static inline unsigned long long ctb_clock_ticks(void)
+{
+#if CTB_HAS_CYCLE_COUNTER && (defined(__aarch64__) && !defined(_MSC_VER))
+    unsigned long long ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#elif CTB_HAS_CYCLE_COUNTER
+    return (unsigned long long)__rdtsc();
+#else
+    return ctb_clock_ns();
+#endif
+}
+
+#endif /* C_TRACEBACK_INTERNAL_CLOCK_H */
@@ -0,0 +1,134 @@
+/**
+ * \file crash_log.h
+ * \brief File layout of the memory-mapped crash log and internal recording hooks.
+ *
+ * The layout is shared with the ctb_crash_decode tool. A crash log file is a header
+ * followed by a ring of fixed-size records:
+ *
+ *     [header][record 0][record 1] ... [record N - 1]
+ *
+ * A writer reserves a sequence number with an atomic increment of the header and
+ * owns record (sequence - 1) % N. The sequence of the record is cleared first and
+ * published last, so a record torn by a kill has either a zero sequence or a wrong
+ * checksum and is skipped by the decoder.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_CRASH_LOG_H
+#define C_TRACEBACK_INTERNAL_CRASH_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CTB_CRASH_LOG_MAGIC "CTBCRASH"
+#define CTB_CRASH_LOG_MAGIC_LENGTH 8
+#define CTB_CRASH_LOG_VERSION 1
+
+/* Size of the header and of each record in bytes */
+#define CTB_CRASH_LOG_RECORD_SIZE 256
+
+/* Maximum number of bytes of the file path and function name kept in a record */
+#define CTB_CRASH_LOG_MAX_FILE_LENGTH 64
+#define CTB_CRASH_LOG_MAX_FUNCTION_LENGTH 48
+
+typedef enum CTB_Crash_Record_Type_
+{
+    CTB_CRASH_RECORD_ERROR = 1,
+    CTB_CRASH_RECORD_WARNING = 2,
+    CTB_CRASH_RECORD_MESSAGE = 3,
+    CTB_CRASH_RECORD_SIGNAL = 4
+} CTB_Crash_Record_Type_;
+
+typedef union CTB_Crash_Log_Header_
+{
+    struct
+    {
+        char magic[CTB_CRASH_LOG_MAGIC_LENGTH];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t num_records;
+
+        /* Last reserved sequence number */
+        uint64_t sequence;
+    } fields;
+    char padding[CTB_CRASH_LOG_RECORD_SIZE];
+} CTB_Crash_Log_Header_;
+
+/* Size of the fixed fields of a record */
+#define CTB_CRASH_RECORD_FIELDS_SIZE 48
+
+typedef struct CTB_Crash_Record_
+{
+    /* 1-based sequence number, 0 while the record is being written */
+    uint64_t sequence;
+
+    /* FNV-1a hash of every byte after this field */
+    uint32_t checksum;
+    uint32_t type;
+
+    /* Wall clock time in nanoseconds since the Unix epoch */
+    uint64_t timestamp_ns;
+
+    int32_t code;
+    int32_t line;
+    uint32_t pid;
+    uint32_t thread_id;
+
+    /* Lengths of the file path, function name and message in text */
+    uint16_t file_length;
+    uint16_t function_length;
+    uint16_t message_length;
+    uint16_t reserved;
+
+    /* File path, function name and message, not null-terminated */
+    char text[CTB_CRASH_LOG_RECORD_SIZE - CTB_CRASH_RECORD_FIELDS_SIZE];
+} CTB_Crash_Record_;
+
+/* Offset of the first byte covered by the checksum */
+#define CTB_CRASH_RECORD_CHECKSUM_OFFSET 12
+
+/**
+ * \brief Compute the checksum of a record.
+ *
+ * \param[in] record The record.
+ * \return The FNV-1a hash of every byte after the checksum field.
+ */
+static inline uint32_t ctb_crash_record_checksum(const CTB_Crash_Record_ *record)
+{
+    const unsigned char *bytes = (const unsigned char *)record;
+    uint32_t hash = 2166136261u;
+    for (size_t i = CTB_CRASH_RECORD_CHECKSUM_OFFSET; i < CTB_CRASH_LOG_RECORD_SIZE;
+         i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Non-zero while a crash log is mapped */
+extern int ctb_crash_log_enabled;
+
+/**
+ * \brief Append a record to the crash log. It is lock-free and async-signal-safe.
+ *
+ * \param[in] type The type of the record.
+ * \param[in] code The error or warning code, or -1 for messages.
+ * \param[in] file The file path, or NULL.
+ * \param[in] line The line number.
+ * \param[in] func The function name, or NULL.
+ * \param[in] message The message, or NULL.
+ * \param[in] message_length The length of the message.
+ */
+void ctb_crash_log_record(
+    const CTB_Crash_Record_Type_ type,
+    const int code,
+    const char *restrict file,
+    const int line,
+    const char *restrict func,
+    const char *restrict message,
+    const size_t message_length
+);
+
+#endif /* C_TRACEBACK_INTERNAL_CRASH_LOG_H */
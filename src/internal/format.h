@@ -0,0 +1,143 @@
+/**
+ * \file format.h
+ * \brief Fast string formatting and per-thread formatting arena for C Traceback.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_FORMAT_H
+#define C_TRACEBACK_INTERNAL_FORMAT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * \brief Growable output buffer. Each thread has one arena that is reused by all
+ * formatting paths, so steady-state formatting does not allocate.
+ */
+typedef struct CTB_Format_Arena_
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+} CTB_Format_Arena_;
+
+/* Maximum number of decimal digits of a 64-bit integer */
+#define CTB_FORMAT_INT_SIZE 20
+
+/**
+ * \brief Append a string literal to an arena without measuring it at runtime.
+ */
+#define CTB_FORMAT_APPEND_LITERAL(arena, literal)                                      \
+    ctb_format_append(arena, literal, sizeof(literal) - 1)
+
+/**
+ * \brief Write an unsigned integer in decimal, zero-padded to a minimum width of at
+ * most CTB_FORMAT_INT_SIZE. The output is not null-terminated. Async-signal-safe.
+ *
+ * \param[out] buffer The output buffer of at least CTB_FORMAT_INT_SIZE bytes.
+ * \param[in] value The value.
+ * \param[in] min_width The minimum number of digits.
+ * \return The number of characters written.
+ */
+size_t ctb_format_uint(char *buffer, const unsigned long long value, int min_width);
+
+/**
+ * \brief Write a signed integer in decimal, zero-padded to a minimum width. The
+ * output is not null-terminated. Async-signal-safe.
+ *
+ * \param[out] buffer The output buffer of at least CTB_FORMAT_INT_SIZE + 1 bytes.
+ * \param[in] value The value.
+ * \param[in] min_width The minimum width including the sign.
+ * \return The number of characters written.
+ */
+size_t ctb_format_int(char *buffer, const long long value, const int min_width);
+
+/**
+ * \brief Format a string like vsnprintf. The specifiers %s, %c, %d, %i, %u, %x and %p
+ * with the flags '-' and '0', a width, a string precision and the length modifiers
+ * l, ll and z are handled without the C library. Other specifiers and NULL pointers
+ * fall back to vsnprintf.
+ *
+ * \param[out] buffer The output buffer, may be NULL if size is 0.
+ * \param[in] size The size of the buffer.
+ * \param[in] fmt The format string.
+ * \param[in] args The arguments.
+ * \return The length of the formatted string, which may exceed size - 1.
+ */
+int ctb_vformat(
+    char *restrict buffer, const size_t size, const char *restrict fmt, va_list args
+);
+
+/**
+ * \brief Format a string like snprintf. See ctb_vformat.
+ */
+int ctb_format(char *restrict buffer, const size_t size, const char *restrict fmt, ...);
+
+/**
+ * \brief Get the empty formatting arena of the calling thread. The arena is not
+ * reentrant: its content is valid until the next call on the same thread.
+ *
+ * \return The formatting arena.
+ */
+CTB_Format_Arena_ *ctb_format_arena_begin(void);
+
+/**
+ * \brief Append a string of the given length to an arena. The string is truncated
+ * if the arena cannot grow.
+ */
+void ctb_format_append(CTB_Format_Arena_ *arena, const char *str, const size_t length);
+
+/**
+ * \brief Append a null-terminated string to an arena.
+ */
+void ctb_format_append_str(CTB_Format_Arena_ *arena, const char *str);
+
+/**
+ * \brief Append a signed integer to an arena. See ctb_format_int.
+ */
+void ctb_format_append_int(
+    CTB_Format_Arena_ *arena, const long long value, const int min_width
+);
+
+/**
+ * \brief Append a formatted string to an arena. See ctb_vformat.
+ */
+void ctb_format_vappendf(CTB_Format_Arena_ *arena, const char *fmt, va_list args);
+
+/**
+ * \brief Append a formatted string to an arena. See ctb_vformat.
+ */
+void ctb_format_appendf(CTB_Format_Arena_ *arena, const char *fmt, ...);
+
+/**
+ * \brief Escape the content of an arena from an offset to its end in place as a JSON
+ * string literal, including the quotes. This allows text to be formatted directly
+ * into the arena and escaped afterwards.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in] offset The offset of the text to escape.
+ */
+void ctb_format_escape_json(CTB_Format_Arena_ *arena, const size_t offset);
+
+/**
+ * \brief Append a string to an arena as a JSON string literal. NULL is written as an
+ * empty string.
+ */
+void ctb_format_append_json_string(CTB_Format_Arena_ *arena, const char *str);
+
+/**
+ * \brief Write the content of an arena to a stream with a single call and empty it.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in,out] stream The output stream.
+ */
+void ctb_format_arena_write(CTB_Format_Arena_ *arena, FILE *stream);
+
+/**
+ * \brief Free the heap memory of the formatting arena of the calling thread.
+ */
+void ctb_release_format_arena(void);
+
+#endif /* C_TRACEBACK_INTERNAL_FORMAT_H */
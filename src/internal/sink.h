@@ -0,0 +1,62 @@
+/**
+ * \file sink.h
+ * \brief Routing of the output to the active sink or the default streams.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_SINK_H
+#define C_TRACEBACK_INTERNAL_SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "format.h"
+
+/**
+ * \brief Determine if ANSI color codes should be used for output that would go to
+ * the given stream.
+ *
+ * \param[in] stream The default output stream.
+ * \return true if the active sink accepts colours, or, without a sink, if the
+ * stream does.
+ */
+bool ctb_output_use_color(FILE *stream);
+
+/**
+ * \brief Determine if UTF-8 should be used for output that would go to the given
+ * stream.
+ *
+ * \param[in] stream The default output stream.
+ * \return true if UTF-8 encoding should be used, false otherwise.
+ */
+bool ctb_output_use_utf8(FILE *stream);
+
+/**
+ * \brief Get the width of the output that would go to the given stream.
+ *
+ * \param[in] stream The default output stream.
+ * \return The terminal width, or the file width if a sink is active.
+ */
+int ctb_output_width(FILE *stream);
+
+/**
+ * \brief Write the content of an arena to the active sink, or to the stream if no
+ * sink is active, and empty it.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in,out] stream The default output stream.
+ */
+void ctb_output_write(CTB_Format_Arena_ *arena, FILE *stream);
+
+/**
+ * \brief Async-signal-safe write to the active sink if it is async-signal-safe, or
+ * to stderr otherwise.
+ *
+ * \param[in] data The data.
+ * \param[in] length The length of the data.
+ */
+void ctb_output_write_signal(const char *data, const size_t length);
+
+#endif /* C_TRACEBACK_INTERNAL_SINK_H */
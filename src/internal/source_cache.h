@@ -0,0 +1,51 @@
+/**
+ * \file source_cache.h
+ * \brief Cache of source files indexed by line.
+ *
+ * Source files are read into memory on their first lookup, and the offset of
+ * every line is recorded, so that later lookups of any line cost no I/O. Later
+ * changes to the files on disk are not seen. Files that cannot be opened are cached
+ * as missing, so that tracebacks of a deployment without sources do not retry
+ * them. Entries are only appended and stay in memory until the process exits, so
+ * lookups need no lock.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_SOURCE_CACHE_H
+#define C_TRACEBACK_INTERNAL_SOURCE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct CTB_Source_File_ CTB_Source_File_;
+
+/**
+ * \brief Find a source file in the cache, reading and indexing it on first use.
+ *
+ * \param[in] path The path of the source file, e.g. __FILE__.
+ * \return The source file, or NULL if it cannot be read or the cache is full.
+ */
+const CTB_Source_File_ *ctb_source_cache_get(const char *path);
+
+/**
+ * \brief Get the number of lines of a source file.
+ *
+ * \param[in] file The source file.
+ * \return The number of lines.
+ */
+int ctb_source_file_num_lines(const CTB_Source_File_ *file);
+
+/**
+ * \brief Get a line of a source file without its line terminator.
+ *
+ * \param[in] file The source file.
+ * \param[in] line_number The 1-based line number.
+ * \param[out] length The length of the line.
+ * \return The line, not null-terminated, or NULL if the line does not exist.
+ */
+const char *ctb_source_file_get_line(
+    const CTB_Source_File_ *file, const int line_number, size_t *length
+);
+
+#endif /* C_TRACEBACK_INTERNAL_SOURCE_CACHE_H */
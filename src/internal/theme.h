@@ -0,0 +1,147 @@
+/**
+ * \file theme.h
+ * \brief Precompiled output templates of the traceback renderer.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_TRACEBACK_INTERNAL_THEME_H
+#define C_TRACEBACK_INTERNAL_THEME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "c_traceback.h"
+#include "format.h"
+
+/**
+ * \brief Fixed pieces of the traceback layout. Each span holds the literal text and
+ * colour codes between two variable fields, e.g. CTB_SPAN_FRAME_LINE is everything
+ * between the file name and the line number of a frame.
+ */
+typedef enum CTB_Span_Id_
+{
+    /* "(#NN) File "dir/file", line N in func:\n    source\n" */
+    CTB_SPAN_FRAME_INDEX,
+    CTB_SPAN_FRAME_FILE_PARENT,
+    CTB_SPAN_FRAME_FILE,
+    CTB_SPAN_FRAME_LINE,
+    CTB_SPAN_FRAME_FUNCTION,
+    CTB_SPAN_FRAME_SOURCE,
+    CTB_SPAN_FRAME_END,
+
+    /* ":\n" then "       NN | line\n" around "    >  NN | line\n" of the frame */
+    CTB_SPAN_EXCERPT,
+    CTB_SPAN_EXCERPT_LINE,
+    CTB_SPAN_EXCERPT_CURRENT,
+    CTB_SPAN_EXCERPT_TEXT,
+    CTB_SPAN_EXCERPT_CURRENT_TEXT,
+    CTB_SPAN_EXCERPT_END,
+    CTB_SPAN_EXCERPT_CURRENT_END,
+
+    /* "(#NN) Traceback (most recent call last):\n" */
+    CTB_SPAN_ERROR_INDEX,
+    CTB_SPAN_ERROR_INDEX_END,
+    CTB_SPAN_HEADER,
+    CTB_SPAN_HEADER_END,
+
+    /* "[... Skipped N frames ...]" */
+    CTB_SPAN_SKIPPED,
+    CTB_SPAN_SKIPPED_END,
+
+    /* "ErrorName: message\n" */
+    CTB_SPAN_ERROR_NAME,
+    CTB_SPAN_ERROR_NAME_END,
+    CTB_SPAN_ERROR_MESSAGE,
+    CTB_SPAN_ERROR_MESSAGE_END,
+
+    /* "[... Thrown N times ...]" */
+    CTB_SPAN_REPEATED,
+    CTB_SPAN_REPEATED_END,
+
+    /* "Last message: message\n" of grouped errors */
+    CTB_SPAN_LAST_MESSAGE,
+    CTB_SPAN_LAST_MESSAGE_END,
+
+    /* "During handling of the above exception, ..." */
+    CTB_SPAN_ANOTHER_EXCEPTION,
+
+    /* "[... Truncated N errors ...]" */
+    CTB_SPAN_TRUNCATED,
+    CTB_SPAN_TRUNCATED_END,
+
+    /* Horizontal rules */
+    CTB_SPAN_ERROR_RULE,
+    CTB_SPAN_ACCENT_RULE,
+    CTB_SPAN_RULE_END,
+
+    /* Highlighted text */
+    CTB_SPAN_ACCENT,
+    CTB_SPAN_ACCENT_END,
+
+    CTB_NUM_SPANS
+} CTB_Span_Id_;
+
+/* Capacity of the text of a compiled template */
+#define CTB_THEME_TEMPLATE_SIZE 2048
+
+typedef struct CTB_Template_Span_
+{
+    unsigned short offset;
+    unsigned short length;
+} CTB_Template_Span_;
+
+/**
+ * \brief A theme compiled into byte spans, so that rendering is a sequence of
+ * memcpy calls.
+ */
+typedef struct CTB_Theme_Template_
+{
+    CTB_Template_Span_ spans[CTB_NUM_SPANS];
+    char data[CTB_THEME_TEMPLATE_SIZE];
+} CTB_Theme_Template_;
+
+/**
+ * \brief Get the compiled template of the active theme.
+ *
+ * \param[in] use_color Whether to use color in the output.
+ * \return The template.
+ */
+const CTB_Theme_Template_ *ctb_get_theme_template(const bool use_color);
+
+/**
+ * \brief Get a precomputed run of horizontal rule dashes.
+ *
+ * \param[in] use_utf8 Whether to use the UTF-8 box drawing character.
+ * \param[in] count The number of dashes, clamped to CTB_HRULE_MAX_WIDTH.
+ * \param[out] length The length of the run in bytes.
+ * \return The dashes, not null-terminated.
+ */
+const char *ctb_get_rule_dashes(const bool use_utf8, int count, size_t *length);
+
+/**
+ * \brief Append a span of a template to an arena.
+ */
+static inline void ctb_template_append(
+    CTB_Format_Arena_ *arena,
+    const CTB_Theme_Template_ *theme_template,
+    const CTB_Span_Id_ id
+)
+{
+    const CTB_Template_Span_ span = theme_template->spans[id];
+    ctb_format_append(arena, theme_template->data + span.offset, span.length);
+}
+
+/**
+ * \brief Append a run of horizontal rule dashes to an arena.
+ */
+static inline void ctb_rule_append(
+    CTB_Format_Arena_ *arena, const bool use_utf8, const int count
+)
+{
+    size_t length;
+    const char *dashes = ctb_get_rule_dashes(use_utf8, count, &length);
+    ctb_format_append(arena, dashes, length);
+}
+
+#endif /* C_TRACEBACK_INTERNAL_THEME_H */
@@ -9,6 +9,8 @@
 #ifndef C_TRACEBACK_INTERNAL_TRACE_H
 #define C_TRACEBACK_INTERNAL_TRACE_H
 
+#include <stdint.h>
+
 #include "c_traceback.h"
 
 #ifndef ctb_thread_local
@@ -30,36 +32,186 @@
 #endif
 #endif
 
-typedef struct CTB_Frame_
-{
-    int line_number;
-    const char *restrict filename;
-    const char *restrict function_name;
-    const char *restrict source_code;
-} CTB_Frame_;
-
 typedef struct CTB_Error_Snapshot_
 {
     CTB_Error error;
     int call_depth;
-    CTB_Frame_ error_frame;
-    char error_message[CTB_MAX_ERROR_MESSAGE_LENGTH];
-    CTB_Frame_ call_stack_frames[CTB_MAX_CALL_STACK_DEPTH];
+    CTB_Frame error_frame;
+    char *error_message;
+    CTB_Frame *call_stack_frames;
+
+    /* Number of errors merged into the snapshot by CTB_RETAIN_SAMPLE */
+    int count;
+
+    /* Hash of the call stack and throw site, see ctb_get_stack_signature */
+    uint64_t signature;
+
+    /* Value of errno recorded by THROW_ERRNO, 0 for other errors */
+    int os_errno;
 } CTB_Error_Snapshot_;
 
-typedef struct CTB_Context
+/**
+ * The arrays are sized by the limits in ctb_config and point into a storage block
+ * that is allocated on the first use of the context.
+ */
+struct CTB_Context
 {
     int num_errors;
     int call_depth;
-    CTB_Frame_ call_stack_frames[CTB_MAX_CALL_STACK_DEPTH];
-    CTB_Error_Snapshot_ error_snapshots[CTB_MAX_NUM_ERROR];
-} CTB_Context;
+    int max_call_stack_depth;
+    int max_num_errors;
+    int max_error_message_length;
+    CTB_Frame *call_stack_frames;
+    CTB_Error_Snapshot_ *error_snapshots;
+    void *storage;
+
+    /* Slot of the oldest stored error once CTB_RETAIN_LAST wraps around, 0 before */
+    int first_error_snapshot;
+
+    /* Code of the most recently thrown error, whether or not it has been stored */
+    CTB_Error last_error;
+
+    /* Signatures of the call stack prefixes ending at each frame. The first
+       num_frame_signatures are valid, pushing a frame invalidates those from it. */
+    uint64_t *frame_signatures;
+    int num_frame_signatures;
+};
+
+/* Active configuration, fixed once the first storage block is allocated */
+extern CTB_Config ctb_config;
+
+/**
+ * \brief Get the number of stored errors of a context.
+ */
+static inline int ctb_get_num_stored_errors(const CTB_Context *context)
+{
+    const int num_errors = context->num_errors;
+    if (num_errors <= 0)
+    {
+        return 0;
+    }
+    return (num_errors < context->max_num_errors) ? num_errors
+                                                  : context->max_num_errors;
+}
+
+/**
+ * \brief Get a stored error of a context in the order the errors were thrown.
+ *
+ * \param[in] context The context.
+ * \param[in] index The index, from 0 to ctb_get_num_stored_errors() - 1.
+ * \return The error snapshot.
+ */
+static inline CTB_Error_Snapshot_ *ctb_get_error_snapshot(
+    const CTB_Context *context, const int index
+)
+{
+    int slot = context->first_error_snapshot + index;
+    if (slot >= context->max_num_errors)
+    {
+        slot -= context->max_num_errors;
+    }
+    return &context->error_snapshots[slot];
+}
+
+/**
+ * \brief Find the snapshot to store a new error in, according to the retention
+ * policy. The caller fills it and then calls ctb_commit_error_snapshot.
+ *
+ * \param[in,out] context The context.
+ * \param[in] error The error type.
+ * \param[in] error_frame The frame where the error is thrown.
+ * \param[out] merged Set to the snapshot of the same error code and throw site if
+ * CTB_RETAIN_SAMPLE merges the error into it, NULL otherwise. The snapshot is moved
+ * to the end of the stored errors, so that it is the most recent error. The error
+ * must then be added to its count and not committed.
+ * \return The snapshot to fill, or NULL if the error is not stored.
+ */
+CTB_Error_Snapshot_ *ctb_reserve_error_snapshot(
+    CTB_Context *context,
+    const CTB_Error error,
+    const CTB_Frame *error_frame,
+    CTB_Error_Snapshot_ **merged
+);
+
+/**
+ * \brief Count a new error after its snapshot has been filled.
+ *
+ * \param[in,out] context The context.
+ * \param[in] stored Whether ctb_reserve_error_snapshot returned a snapshot.
+ */
+void ctb_commit_error_snapshot(CTB_Context *context, const bool stored);
+
+/**
+ * \brief Compute the signature of a call stack and throw site from scratch.
+ *
+ * \param[in] frames The recorded frames, outermost first.
+ * \param[in] num_frames The number of recorded frames.
+ * \param[in] call_depth The depth of the call stack.
+ * \param[in] error_frame The frame where the error is thrown.
+ * \return The signature.
+ */
+uint64_t ctb_compute_stack_signature(
+    const CTB_Frame *frames,
+    const int num_frames,
+    const int call_depth,
+    const CTB_Frame *error_frame
+);
+
+/**
+ * \brief Get the signature of the current call stack of a context and a throw
+ * site, hashing only the frames pushed since the last call.
+ *
+ * \param[in,out] context The context.
+ * \param[in] error_frame The frame where the error is thrown.
+ * \return The signature, equal to ctb_compute_stack_signature of the frames.
+ */
+uint64_t ctb_get_stack_signature(CTB_Context *context, const CTB_Frame *error_frame);
+
+/**
+ * \brief Allocate the storage of a context sized by the active configuration,
+ * without falling back to the thread-local storage on failure.
+ *
+ * \param[in,out] context The context to set up.
+ * \return true on success, false if the storage cannot be allocated.
+ */
+bool ctb_alloc_context_storage(CTB_Context *context);
+
+/**
+ * \brief Allocate the storage of a context sized by the active configuration.
+ *
+ * \param[in,out] context The context to set up.
+ */
+void ctb_init_context_storage(CTB_Context *context);
+
+/**
+ * \brief Return the storage of a context to the pool and reset the context.
+ *
+ * \param[in,out] context The context to release.
+ */
+void ctb_release_context_storage(CTB_Context *context);
 
 /**
- * \brief Get the global C Traceback context.
+ * \brief Release the timing table of the calling thread when it exits. The table
+ * keeps its statistics and is reused by a new thread.
+ */
+void ctb_release_timing_table(void);
+
+/**
+ * \brief Get the active C Traceback context of the calling thread, allocating its
+ * storage on first use. This is the context switched in with ctb_context_switch, or
+ * the thread's own context.
  *
- * \return Pointer to the global C Traceback context.
+ * \return Pointer to the C Traceback context.
  */
 CTB_Context *get_context(void);
 
+/**
+ * \brief Get the active C Traceback context of the calling thread without allocating.
+ * Async-signal-safe. The context has no frames or errors if its storage has not
+ * been allocated yet.
+ *
+ * \return Pointer to the C Traceback context.
+ */
+CTB_Context *peek_context(void);
+
 #endif /* C_TRACEBACK_INTERNAL_TRACE_H */
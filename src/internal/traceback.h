@@ -18,4 +18,16 @@
  */
 void ctb_dump_traceback_signal(const CTB_Error ctb_error);
 
+/**
+ * \brief Dump the traceback to stderr on panic, with a final error at the frame of
+ * the panic. Like ctb_dump_traceback_signal, it allocates no memory.
+ *
+ * \param[in] ctb_error Error type.
+ * \param[in] error_frame The frame of the panic.
+ * \param[in] message The message of the panic.
+ */
+void ctb_dump_traceback_panic(
+    const CTB_Error ctb_error, const CTB_Frame *error_frame, const char *message
+);
+
 #endif /* C_TRACEBACK_INTERNAL_TRACEBACK_H */
@@ -9,6 +9,7 @@
 #define C_TRACEBACK_INTERNAL_UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * \brief Determine if we should use UTF-8 encoding for the given output stream.
@@ -43,4 +44,15 @@ int get_parent_path_length(const char *restrict path);
  */
 int get_terminal_width(FILE *stream);
 
+/**
+ * \brief Get the description of an errno value in a thread-safe way, i.e. with
+ * strerror_r or strerror_s instead of strerror.
+ *
+ * \param[in] os_errno The errno value.
+ * \param[out] buffer The buffer that may receive the description.
+ * \param[in] size The size of the buffer.
+ * \return The description, in the buffer or in static storage.
+ */
+const char *get_errno_description(const int os_errno, char *buffer, const size_t size);
+
 #endif /* C_TRACEBACK_INTERNAL_UTILS_H */
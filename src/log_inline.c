@@ -12,13 +12,17 @@
 #include <string.h>
 
 #include "c_traceback.h"
+#include "internal/atomic.h"
+#include "internal/crash_log.h"
+#include "internal/format.h"
+#include "internal/sink.h"
 #include "internal/utils.h"
 
 /**
  * \brief Helper for logging inline messages without the message body.
  *
  * \param[in] use_color Whether to use color in the output.
- * \param[in, out] stream The output stream.
+ * \param[in, out] arena The formatting arena.
  * \param[in] header_color The color code for the header.
  * \param[in] message_color The color code for the message.
  * \param[in] file_address The file address.
@@ -28,7 +32,7 @@
  */
 static void ctb_log_inline_core(
     const bool use_color,
-    FILE *stream,
+    CTB_Format_Arena_ *arena,
     const char *header_color,
     const char *message_color,
     const char *restrict file_address,
@@ -42,8 +46,8 @@ static void ctb_log_inline_core(
         const int dir_len = get_parent_path_length(file_address);
 
         // clang-format off
-        fprintf(
-            stream,
+        ctb_format_appendf(
+            arena,
             "%s%s:%s %sFile \"%s",
             header_color, header, CTB_RESET_COLOR,
             CTB_TRACEBACK_TEXT_COLOR, CTB_RESET_COLOR
@@ -53,16 +57,16 @@ static void ctb_log_inline_core(
         /* Print file address */
         if (dir_len > 0)
         {
-            fprintf(
-                stream,
+            ctb_format_appendf(
+                arena,
                 "%s%.*s%s",
                 CTB_TRACEBACK_TEXT_COLOR,
                 dir_len,
                 file_address,
                 CTB_RESET_COLOR
             );
-            fprintf(
-                stream,
+            ctb_format_appendf(
+                arena,
                 "%s%s%s",
                 CTB_TRACEBACK_FILE_COLOR,
                 file_address + dir_len,
@@ -71,8 +75,8 @@ static void ctb_log_inline_core(
         }
         else
         {
-            fprintf(
-                stream,
+            ctb_format_appendf(
+                arena,
                 "%s%s%s",
                 CTB_TRACEBACK_FILE_COLOR,
                 file_address,
@@ -81,8 +85,8 @@ static void ctb_log_inline_core(
         }
 
         // clang-format off
-        fprintf(
-            stream,
+        ctb_format_appendf(
+            arena,
             "%s\", line%s %s%d%s %sin%s %s%s%s:\n   %s",
             CTB_TRACEBACK_TEXT_COLOR, CTB_RESET_COLOR,
             CTB_TRACEBACK_LINE_COLOR, line, CTB_RESET_COLOR,
@@ -94,8 +98,8 @@ static void ctb_log_inline_core(
     }
     else
     {
-        fprintf(
-            stream,
+        ctb_format_appendf(
+            arena,
             "%s: File \"%s\", line %d in %s:\n    ",
             header,
             file_address,
@@ -105,10 +109,97 @@ static void ctb_log_inline_core(
     }
 }
 
+/**
+ * \brief Helper for logging inline messages in the JSON Lines format without the
+ * message body, which is left open for the caller to append.
+ *
+ * \param[in, out] arena The formatting arena.
+ * \param[in] type The type of the log.
+ * \param[in] code The error or warning code, or -1 for messages.
+ * \param[in] file_address The file address.
+ * \param[in] line The line number.
+ * \param[in] func The function name.
+ * \param[in] header The error or warning name.
+ */
+static void ctb_log_inline_json_core(
+    CTB_Format_Arena_ *arena,
+    const CTB_Crash_Record_Type_ type,
+    const int code,
+    const char *restrict file_address,
+    const int line,
+    const char *restrict func,
+    const char *restrict header
+)
+{
+    if (type == CTB_CRASH_RECORD_ERROR)
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, "{\"type\":\"error\"");
+    }
+    else if (type == CTB_CRASH_RECORD_WARNING)
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, "{\"type\":\"warning\"");
+    }
+    else
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, "{\"type\":\"message\"");
+    }
+    if (code >= 0)
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"name\":");
+        ctb_format_append_json_string(arena, header);
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"code\":");
+        ctb_format_append_int(arena, code, 0);
+    }
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"file\":");
+    ctb_format_append_json_string(arena, file_address);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"line\":");
+    ctb_format_append_int(arena, line, 0);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"function\":");
+    ctb_format_append_json_string(arena, func);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"message\":");
+}
+
+/**
+ * \brief Append a message formatted into an arena to the crash log if one is open.
+ *
+ * \param[in] arena The formatting arena.
+ * \param[in] message_offset The offset of the message in the arena.
+ * \param[in] type The type of the log.
+ * \param[in] code The error or warning code, or -1 for messages.
+ * \param[in] file_address The file address.
+ * \param[in] line The line number.
+ * \param[in] func The function name.
+ */
+static void record_formatted_message(
+    const CTB_Format_Arena_ *arena,
+    const size_t message_offset,
+    const CTB_Crash_Record_Type_ type,
+    const int code,
+    const char *restrict file_address,
+    const int line,
+    const char *restrict func
+)
+{
+    if (ctb_atomic_load_relaxed(&ctb_crash_log_enabled))
+    {
+        ctb_crash_log_record(
+            type,
+            code,
+            file_address,
+            line,
+            func,
+            arena->data + message_offset,
+            arena->length - message_offset
+        );
+    }
+}
+
 /**
  * \brief Log inline message.
  *
  * \param[in, out] stream The output stream.
+ * \param[in] type The type of the log.
+ * \param[in] code The error or warning code, or -1 for messages.
  * \param[in] header_color The color code for the header.
  * \param[in] message_color The color code for the message.
  * \param[in] file_address The file address.
@@ -119,6 +210,8 @@ static void ctb_log_inline_core(
  */
 static void ctb_log_inline(
     FILE *stream,
+    const CTB_Crash_Record_Type_ type,
+    const int code,
     const char *header_color,
     const char *message_color,
     const char *restrict file_address,
@@ -128,10 +221,25 @@ static void ctb_log_inline(
     const char *restrict msg
 )
 {
-    const bool use_color = should_use_color(stream);
+    if (ctb_atomic_load_relaxed(&ctb_crash_log_enabled))
+    {
+        ctb_crash_log_record(type, code, file_address, line, func, msg, strlen(msg));
+    }
+
+    CTB_Format_Arena_ *arena = ctb_format_arena_begin();
+    if (ctb_get_output_format(stream) == CTB_OUTPUT_JSON_LINES)
+    {
+        ctb_log_inline_json_core(arena, type, code, file_address, line, func, header);
+        ctb_format_append_json_string(arena, msg);
+        CTB_FORMAT_APPEND_LITERAL(arena, "}\n");
+        ctb_output_write(arena, stream);
+        return;
+    }
+
+    const bool use_color = ctb_output_use_color(stream);
     ctb_log_inline_core(
         use_color,
-        stream,
+        arena,
         header_color,
         message_color,
         file_address,
@@ -140,22 +248,22 @@ static void ctb_log_inline(
         header
     );
 
+    ctb_format_append_str(arena, msg);
     if (use_color)
     {
-        fprintf(stream, "%s%s\n", msg, CTB_RESET_COLOR);
-    }
-    else
-    {
-        fprintf(stream, "%s\n", msg);
+        ctb_format_append_str(arena, CTB_RESET_COLOR);
     }
+    ctb_format_append(arena, "\n", 1);
 
-    fflush(stream);
+    ctb_output_write(arena, stream);
 }
 
 /**
  * \brief Log inline message with variadic arguments.
  *
  * \param[in, out] stream The output stream.
+ * \param[in] type The type of the log.
+ * \param[in] code The error or warning code, or -1 for messages.
  * \param[in] header_color The color code for the header.
  * \param[in] message_color The color code for the message.
  * \param[in] file_address The file address.
@@ -167,6 +275,8 @@ static void ctb_log_inline(
  */
 static void ctb_log_inline_fmt(
     FILE *stream,
+    const CTB_Crash_Record_Type_ type,
+    const int code,
     const char *header_color,
     const char *message_color,
     const char *restrict file_address,
@@ -177,10 +287,28 @@ static void ctb_log_inline_fmt(
     va_list args
 )
 {
-    const bool use_color = should_use_color(stream);
+    CTB_Format_Arena_ *arena = ctb_format_arena_begin();
+    if (ctb_get_output_format(stream) == CTB_OUTPUT_JSON_LINES)
+    {
+        ctb_log_inline_json_core(arena, type, code, file_address, line, func, header);
+
+        /* Format the message in place and escape it afterwards */
+        const size_t message_offset = arena->length;
+        ctb_format_vappendf(arena, msg, args);
+        record_formatted_message(
+            arena, message_offset, type, code, file_address, line, func
+        );
+        ctb_format_escape_json(arena, message_offset);
+
+        CTB_FORMAT_APPEND_LITERAL(arena, "}\n");
+        ctb_output_write(arena, stream);
+        return;
+    }
+
+    const bool use_color = ctb_output_use_color(stream);
     ctb_log_inline_core(
         use_color,
-        stream,
+        arena,
         header_color,
         message_color,
         file_address,
@@ -189,17 +317,18 @@ static void ctb_log_inline_fmt(
         header
     );
 
+    const size_t message_offset = arena->length;
+    ctb_format_vappendf(arena, msg, args);
+    record_formatted_message(
+        arena, message_offset, type, code, file_address, line, func
+    );
     if (use_color)
     {
-        vfprintf(stream, msg, args);
-        fprintf(stream, "%s\n", CTB_RESET_COLOR);
+        ctb_format_append_str(arena, CTB_RESET_COLOR);
     }
-    else
-    {
-        vfprintf(stream, msg, args);
-        fputc('\n', stream);
-    }
-    fflush(stream);
+    ctb_format_append(arena, "\n", 1);
+
+    ctb_output_write(arena, stream);
 }
 
 void ctb_log_error_inline(
@@ -213,6 +342,8 @@ void ctb_log_error_inline(
     FILE *stream = stderr;
     ctb_log_inline(
         stream,
+        CTB_CRASH_RECORD_ERROR,
+        (int)error,
         CTB_ERROR_BOLD_COLOR,
         CTB_ERROR_COLOR,
         file,
@@ -234,6 +365,8 @@ void ctb_log_warning_inline(
     FILE *stream = stderr;
     ctb_log_inline(
         stream,
+        CTB_CRASH_RECORD_WARNING,
+        (int)warning,
         CTB_WARNING_BOLD_COLOR,
         CTB_WARNING_COLOR,
         file,
@@ -254,6 +387,8 @@ void ctb_log_message_inline(
     FILE *stream = stdout;
     ctb_log_inline(
         stream,
+        CTB_CRASH_RECORD_MESSAGE,
+        -1,
         CTB_NORMAL_BOLD_COLOR,
         CTB_NORMAL_COLOR,
         file,
@@ -278,6 +413,8 @@ void ctb_log_error_inline_fmt(
     va_start(args, msg);
     ctb_log_inline_fmt(
         stream,
+        CTB_CRASH_RECORD_ERROR,
+        (int)error,
         CTB_ERROR_BOLD_COLOR,
         CTB_ERROR_COLOR,
         file,
@@ -304,6 +441,8 @@ void ctb_log_warning_inline_fmt(
     va_start(args, msg);
     ctb_log_inline_fmt(
         stream,
+        CTB_CRASH_RECORD_WARNING,
+        (int)warning,
         CTB_WARNING_BOLD_COLOR,
         CTB_WARNING_COLOR,
         file,
@@ -329,6 +468,8 @@ void ctb_log_message_inline_fmt(
     va_start(args, msg);
     ctb_log_inline_fmt(
         stream,
+        CTB_CRASH_RECORD_MESSAGE,
+        -1,
         CTB_NORMAL_BOLD_COLOR,
         CTB_NORMAL_COLOR,
         file,
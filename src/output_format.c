@@ -0,0 +1,71 @@
+/**
+ * \file output_format.c
+ * \brief Function definitions for selecting the output format of each stream.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "c_traceback.h"
+#include "internal/atomic.h"
+
+typedef struct
+{
+    FILE *stream;
+    int format;
+} Stream_Format;
+
+/* Configured streams. Entries are only appended, so readers need no lock. */
+static Stream_Format ctb_stream_formats[CTB_MAX_OUTPUT_STREAMS];
+static int ctb_num_stream_formats = 0;
+static int ctb_stream_formats_lock = 0;
+
+bool ctb_set_output_format(FILE *stream, const CTB_Output_Format format)
+{
+    if (!stream || (format != CTB_OUTPUT_TEXT && format != CTB_OUTPUT_JSON_LINES))
+    {
+        return false;
+    }
+
+    ctb_spin_lock(&ctb_stream_formats_lock);
+
+    const int num_streams = ctb_num_stream_formats;
+    for (int i = 0; i < num_streams; i++)
+    {
+        if (ctb_stream_formats[i].stream == stream)
+        {
+            ctb_atomic_store_relaxed(&ctb_stream_formats[i].format, (int)format);
+            ctb_spin_unlock(&ctb_stream_formats_lock);
+            return true;
+        }
+    }
+
+    if (num_streams >= CTB_MAX_OUTPUT_STREAMS)
+    {
+        ctb_spin_unlock(&ctb_stream_formats_lock);
+        return false;
+    }
+
+    ctb_stream_formats[num_streams].stream = stream;
+    ctb_stream_formats[num_streams].format = (int)format;
+    ctb_atomic_store_release(&ctb_num_stream_formats, num_streams + 1);
+
+    ctb_spin_unlock(&ctb_stream_formats_lock);
+    return true;
+}
+
+CTB_Output_Format ctb_get_output_format(FILE *stream)
+{
+    const int num_streams = ctb_atomic_load_acquire(&ctb_num_stream_formats);
+    for (int i = 0; i < num_streams; i++)
+    {
+        if (ctb_stream_formats[i].stream == stream)
+        {
+            const int format = ctb_atomic_load_relaxed(&ctb_stream_formats[i].format);
+            return (CTB_Output_Format)format;
+        }
+    }
+    return CTB_OUTPUT_TEXT;
+}
@@ -0,0 +1,87 @@
+/**
+ * \file panic.c
+ * \brief Implementation of the failure paths of assertions and panics.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/format.h"
+#include "internal/traceback.h"
+
+void ctb_assert_failed(
+    CTB_Error error,
+    const char *restrict file,
+    const int line,
+    const char *restrict func,
+    const char *restrict condition,
+    const char *restrict msg,
+    ...
+)
+{
+    /* Size the message like the error snapshots, falling back to the default limit
+       if it cannot be allocated */
+    char fallback[CTB_MAX_ERROR_MESSAGE_LENGTH];
+    size_t size = (size_t)ctb_get_config()->max_error_message_length;
+    char *message = ctb_malloc(size);
+    if (!message)
+    {
+        message = fallback;
+        size = sizeof(fallback);
+    }
+
+    const bool has_message = (msg && msg[0]);
+    const int length = ctb_format(
+        message,
+        size,
+        has_message ? "Assertion `%s` failed: " : "Assertion `%s` failed",
+        condition
+    );
+    if (has_message && length < (int)size - 1)
+    {
+        va_list args;
+        va_start(args, msg);
+        ctb_vformat(message + length, size - (size_t)length, msg, args);
+        va_end(args);
+    }
+
+    ctb_throw_error(error, file, line, func, message);
+    if (message != fallback)
+    {
+        ctb_free(message);
+    }
+}
+
+void ctb_panic(
+    CTB_Error error,
+    const char *restrict file,
+    const int line,
+    const char *restrict func,
+    const char *restrict msg,
+    ...
+)
+{
+    char message[CTB_MAX_ERROR_MESSAGE_LENGTH];
+    va_list args;
+    va_start(args, msg);
+    ctb_vformat(message, sizeof(message), msg, args);
+    va_end(args);
+
+    /* Write out buffered output first, since abort discards it. This takes the
+       stream locks, see the CTB_PANIC documentation. */
+    fflush(NULL);
+
+    const CTB_Frame frame = {line, file, func, "<Panicked here>"};
+    ctb_dump_traceback_panic(error, &frame, message);
+
+    /* Do not let the signal handler print the traceback a second time */
+    signal(SIGABRT, SIG_DFL);
+    abort();
+}
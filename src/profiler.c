@@ -0,0 +1,405 @@
+/**
+ * \file profiler.c
+ * \brief Sampling profiler that aggregates the traced call stack on SIGPROF.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/trace.h"
+#include "internal/utils.h"
+
+/* Per-thread capacity of distinct call sites and stack frame indices */
+#define CTB_PROFILER_MAX_SITES 1024
+#define CTB_PROFILER_MAX_STACK_FRAMES (8 * CTB_PROFILER_MAX_STACKS)
+
+/* Deeper stacks are truncated to their outermost frames */
+#define CTB_PROFILER_MAX_DEPTH 128
+
+typedef struct CTB_Profiler_Stack_
+{
+    uint64_t hash;
+    unsigned long long count;
+    int offset;
+    int depth;
+} CTB_Profiler_Stack_;
+
+/**
+ * Folded stacks of one thread. Call sites are interned so that each stack only
+ * stores 16-bit site indices.
+ */
+typedef struct CTB_Profiler_Table_
+{
+    int num_sites;
+    int num_stacks;
+    int num_stack_frames;
+    unsigned long long num_dropped;
+    CTB_Frame sites[CTB_PROFILER_MAX_SITES];
+    int16_t site_slots[2 * CTB_PROFILER_MAX_SITES];
+    CTB_Profiler_Stack_ stacks[CTB_PROFILER_MAX_STACKS];
+    int16_t stack_slots[2 * CTB_PROFILER_MAX_STACKS];
+    uint16_t stack_frames[CTB_PROFILER_MAX_STACK_FRAMES];
+} CTB_Profiler_Table_;
+
+/* Tables are allocated once on the first start and never freed, since threads keep
+   pointers to them. They are claimed by threads inside the signal handler. */
+static CTB_Profiler_Table_ *ctb_profiler_tables = NULL;
+static int ctb_profiler_num_tables = 0;
+static unsigned long long ctb_profiler_num_dropped_threads = 0;
+static ctb_thread_local CTB_Profiler_Table_ *ctb_profiler_table = NULL;
+static bool ctb_profiler_running = false;
+
+/**
+ * \brief Hash a 64-bit value (splitmix64 finalizer).
+ */
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * \brief Async-signal-safe lookup of a call site, interning it if new.
+ *
+ * \return The site index, or -1 if the site table is full.
+ */
+static int intern_site(CTB_Profiler_Table_ *table, const CTB_Frame *frame)
+{
+    const uint64_t hash = mix64(
+        (uint64_t)(uintptr_t)frame->function_name ^
+        ((uint64_t)(uintptr_t)frame->filename << 1) ^ (uint64_t)frame->line_number
+    );
+    const int num_slots = 2 * CTB_PROFILER_MAX_SITES;
+
+    for (int i = 0; i < num_slots; i++)
+    {
+        int16_t *slot = &table->site_slots[(hash + i) % num_slots];
+        const int index = *slot - 1;
+        if (index < 0)
+        {
+            if (table->num_sites >= CTB_PROFILER_MAX_SITES)
+            {
+                return -1;
+            }
+            const int new_index = table->num_sites;
+            table->sites[new_index] = *frame;
+            *slot = (int16_t)(new_index + 1);
+            ctb_atomic_store_release(&table->num_sites, new_index + 1);
+            return new_index;
+        }
+
+        const CTB_Frame *site = &table->sites[index];
+        if (site->function_name == frame->function_name &&
+            site->filename == frame->filename &&
+            site->line_number == frame->line_number)
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+/**
+ * \brief Async-signal-safe recording of one sample of the calling thread.
+ */
+static void record_sample(CTB_Profiler_Table_ *table)
+{
+    const CTB_Context *context = peek_context();
+    int depth = context->call_depth;
+    if (depth < 0)
+    {
+        depth = 0;
+    }
+    if (depth > context->max_call_stack_depth)
+    {
+        depth = context->max_call_stack_depth;
+    }
+    if (depth > CTB_PROFILER_MAX_DEPTH)
+    {
+        depth = CTB_PROFILER_MAX_DEPTH;
+    }
+
+    uint16_t sites[CTB_PROFILER_MAX_DEPTH];
+    uint64_t hash = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < depth; i++)
+    {
+        const int site = intern_site(table, &context->call_stack_frames[i]);
+        if (site < 0)
+        {
+            table->num_dropped++;
+            return;
+        }
+        sites[i] = (uint16_t)site;
+        hash = mix64(hash ^ (uint64_t)site) + (uint64_t)i;
+    }
+
+    const int num_slots = 2 * CTB_PROFILER_MAX_STACKS;
+    for (int i = 0; i < num_slots; i++)
+    {
+        int16_t *slot = &table->stack_slots[(hash + i) % num_slots];
+        const int index = *slot - 1;
+        if (index < 0)
+        {
+            if (table->num_stacks >= CTB_PROFILER_MAX_STACKS ||
+                table->num_stack_frames + depth > CTB_PROFILER_MAX_STACK_FRAMES)
+            {
+                table->num_dropped++;
+                return;
+            }
+
+            const int new_index = table->num_stacks;
+            CTB_Profiler_Stack_ *stack = &table->stacks[new_index];
+            stack->hash = hash;
+            stack->count = 1;
+            stack->offset = table->num_stack_frames;
+            stack->depth = depth;
+            for (int d = 0; d < depth; d++)
+            {
+                table->stack_frames[stack->offset + d] = sites[d];
+            }
+            table->num_stack_frames += depth;
+            *slot = (int16_t)(new_index + 1);
+            ctb_atomic_store_release(&table->num_stacks, new_index + 1);
+            return;
+        }
+
+        CTB_Profiler_Stack_ *stack = &table->stacks[index];
+        const uint16_t *stack_sites = &table->stack_frames[stack->offset];
+        if (stack->hash == hash && stack->depth == depth &&
+            memcmp(stack_sites, sites, sizeof(uint16_t) * depth) == 0)
+        {
+            ctb_atomic_store_relaxed(&stack->count, stack->count + 1);
+            return;
+        }
+    }
+    table->num_dropped++;
+}
+
+/**
+ * \brief Get the table of the calling thread, claiming one from the pool on the
+ * first sample. Async-signal-safe.
+ */
+static CTB_Profiler_Table_ *claim_table(void)
+{
+    CTB_Profiler_Table_ *table = ctb_profiler_table;
+    if (table)
+    {
+        return table;
+    }
+
+    const int index = ctb_atomic_fetch_add(&ctb_profiler_num_tables, 1);
+    if (index >= CTB_PROFILER_MAX_THREADS)
+    {
+        ctb_atomic_store_relaxed(&ctb_profiler_num_tables, CTB_PROFILER_MAX_THREADS);
+        return NULL;
+    }
+
+    table = &ctb_profiler_tables[index];
+    ctb_profiler_table = table;
+    return table;
+}
+
+#ifdef _WIN32
+
+bool ctb_profiler_start(const int frequency_hz)
+{
+    (void)frequency_hz;
+    (void)claim_table;
+    (void)record_sample;
+    LOG_WARNING_INLINE(
+        CTB_COMPATIBILITY_WARNING, "Sampling profiler is not supported on Windows"
+    );
+    return false;
+}
+
+void ctb_profiler_stop(void)
+{
+}
+
+#else
+#include <errno.h>
+#include <signal.h>
+#include <sys/time.h>
+
+static struct sigaction ctb_profiler_old_action;
+
+static void ctb_profiler_signal_handler(int sig, siginfo_t *info, void *ucontext)
+{
+    (void)sig;
+    (void)info;
+    (void)ucontext;
+
+    const int saved_errno = errno;
+    CTB_Profiler_Table_ *table = claim_table();
+    if (table)
+    {
+        record_sample(table);
+    }
+    else
+    {
+        ctb_atomic_fetch_add(&ctb_profiler_num_dropped_threads, 1);
+    }
+    errno = saved_errno;
+}
+
+bool ctb_profiler_start(const int frequency_hz)
+{
+    if (ctb_profiler_running)
+    {
+        return true;
+    }
+
+    if (frequency_hz <= 0 || frequency_hz > 1000000)
+    {
+        LOG_WARNING_INLINE_FMT(
+            CTB_USER_WARNING, "Invalid profiler frequency: %d Hz", frequency_hz
+        );
+        return false;
+    }
+
+    if (!ctb_profiler_tables)
+    {
+        ctb_profiler_tables =
+            ctb_calloc(CTB_PROFILER_MAX_THREADS, sizeof(CTB_Profiler_Table_));
+        if (!ctb_profiler_tables)
+        {
+            LOG_WARNING_INLINE(
+                CTB_RESOURCE_WARNING, "Failed to allocate profiler sample tables"
+            );
+            return false;
+        }
+    }
+
+    struct sigaction sa;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sa.sa_sigaction = ctb_profiler_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, &ctb_profiler_old_action) == -1)
+    {
+        LOG_WARNING_INLINE(CTB_WARNING, "Failed to set signal handler for SIGPROF");
+        return false;
+    }
+
+    const long interval_us = 1000000L / frequency_hz;
+    struct itimerval timer;
+    timer.it_interval.tv_sec = interval_us / 1000000L;
+    timer.it_interval.tv_usec = interval_us % 1000000L;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) == -1)
+    {
+        sigaction(SIGPROF, &ctb_profiler_old_action, NULL);
+        LOG_WARNING_INLINE(CTB_WARNING, "Failed to start the profiling timer");
+        return false;
+    }
+
+    ctb_profiler_running = true;
+    return true;
+}
+
+void ctb_profiler_stop(void)
+{
+    if (!ctb_profiler_running)
+    {
+        return;
+    }
+
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sigaction(SIGPROF, &ctb_profiler_old_action, NULL);
+    ctb_profiler_running = false;
+}
+
+#endif /* _WIN32 */
+
+void ctb_profiler_reset(void)
+{
+    if (ctb_profiler_running || !ctb_profiler_tables)
+    {
+        return;
+    }
+
+    const int num_tables = ctb_atomic_load_acquire(&ctb_profiler_num_tables);
+    for (int t = 0; t < num_tables && t < CTB_PROFILER_MAX_THREADS; t++)
+    {
+        CTB_Profiler_Table_ *table = &ctb_profiler_tables[t];
+        table->num_stacks = 0;
+        table->num_stack_frames = 0;
+        table->num_dropped = 0;
+        memset(table->stack_slots, 0, sizeof(table->stack_slots));
+    }
+    ctb_profiler_num_dropped_threads = 0;
+}
+
+/**
+ * \brief Write a call site as a folded stack frame, i.e. "function (file:line)".
+ */
+static void write_folded_frame(FILE *stream, const CTB_Frame *site)
+{
+    const int dir_len = get_parent_path_length(site->filename);
+    fprintf(
+        stream,
+        "%s (%s:%d)",
+        site->function_name,
+        site->filename + dir_len,
+        site->line_number
+    );
+}
+
+void ctb_profiler_write_folded(FILE *stream, const bool per_thread)
+{
+    if (!ctb_profiler_tables)
+    {
+        return;
+    }
+
+    unsigned long long num_dropped = ctb_profiler_num_dropped_threads;
+    const int num_tables = ctb_atomic_load_acquire(&ctb_profiler_num_tables);
+    for (int t = 0; t < num_tables && t < CTB_PROFILER_MAX_THREADS; t++)
+    {
+        const CTB_Profiler_Table_ *table = &ctb_profiler_tables[t];
+        const int num_stacks = ctb_atomic_load_acquire(&table->num_stacks);
+        num_dropped += table->num_dropped;
+
+        for (int s = 0; s < num_stacks; s++)
+        {
+            const CTB_Profiler_Stack_ *stack = &table->stacks[s];
+            if (per_thread)
+            {
+                fprintf(stream, "thread %d;", t);
+            }
+
+            if (stack->depth == 0)
+            {
+                fputs("[untraced]", stream);
+            }
+            for (int d = 0; d < stack->depth; d++)
+            {
+                if (d > 0)
+                {
+                    fputc(';', stream);
+                }
+                const int site = table->stack_frames[stack->offset + d];
+                write_folded_frame(stream, &table->sites[site]);
+            }
+            fprintf(stream, " %llu\n", ctb_atomic_load_relaxed(&stack->count));
+        }
+    }
+
+    if (num_dropped > 0)
+    {
+        fprintf(stream, "[dropped] %llu\n", num_dropped);
+    }
+    fflush(stream);
+}
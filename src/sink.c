@@ -0,0 +1,970 @@
+/**
+ * \file sink.c
+ * \brief Function definitions for output sinks.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/format.h"
+#include "internal/sink.h"
+#include "internal/trace.h"
+#include "internal/utils.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#include <windows.h>
+#define SAFE_WRITE(fd, buf, len) _write(fd, buf, len)
+#define STDERR_FD 2
+#define STREAM_FD(stream) _fileno(stream)
+#define YIELD_THREAD() SwitchToThread()
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SAFE_WRITE(fd, buf, len) write(fd, buf, len)
+#define STDERR_FD STDERR_FILENO
+#define STREAM_FD(stream) fileno(stream)
+#define YIELD_THREAD() sched_yield()
+#endif
+
+/* Maximum number of buffers passed to a single vectored system call */
+#define SINK_MAX_IOV 16
+
+/**
+ * Sinks are published as immutable copies, swapped in with a single pointer so
+ * that the signal renderer never reads a half-written sink. Copies are never
+ * freed, since an interrupted thread may still be using one, but a sink that is
+ * set again reuses its copy.
+ */
+typedef struct CTB_Published_Sink_
+{
+    struct CTB_Published_Sink_ *next;
+    CTB_Sink sink;
+} CTB_Published_Sink_;
+
+static CTB_Published_Sink_ *ctb_published_sinks = NULL;
+static int ctb_published_sinks_lock = 0;
+
+static const CTB_Sink *ctb_global_sink = NULL;
+static ctb_thread_local const CTB_Sink *ctb_thread_sink = NULL;
+
+/* Ordered queue of writers to the default streams in the atomic output mode */
+static int ctb_atomic_output = 0;
+static unsigned int ctb_output_next_ticket = 0;
+static unsigned int ctb_output_now_serving = 0;
+
+/**
+ * \brief Get the active sink of the calling thread.
+ *
+ * \return The active sink, or NULL if no sink is active.
+ */
+static const CTB_Sink *get_active_sink(void)
+{
+    const CTB_Sink *sink = ctb_thread_sink;
+    return sink ? sink : ctb_atomic_load_acquire(&ctb_global_sink);
+}
+
+/**
+ * \brief Check whether two sinks have the same functions and settings.
+ */
+static bool same_sink(const CTB_Sink *a, const CTB_Sink *b)
+{
+    return a->write_fn == b->write_fn && a->flush_fn == b->flush_fn &&
+           a->user_data == b->user_data && a->color == b->color &&
+           a->async_signal_safe == b->async_signal_safe;
+}
+
+/**
+ * \brief Get the immutable copy of a sink, creating it if the sink is new.
+ *
+ * \return The copy, or NULL if it cannot be allocated.
+ */
+static const CTB_Sink *publish_sink(const CTB_Sink *sink)
+{
+    ctb_spin_lock(&ctb_published_sinks_lock);
+    CTB_Published_Sink_ *published = ctb_published_sinks;
+    while (published && !same_sink(&published->sink, sink))
+    {
+        published = published->next;
+    }
+
+    if (!published)
+    {
+        published = ctb_malloc(sizeof(CTB_Published_Sink_));
+        if (published)
+        {
+            published->sink = *sink;
+            published->next = ctb_published_sinks;
+            ctb_published_sinks = published;
+        }
+    }
+    ctb_spin_unlock(&ctb_published_sinks_lock);
+    return published ? &published->sink : NULL;
+}
+
+bool ctb_set_sink(const CTB_Sink *sink)
+{
+    if (sink && !sink->write_fn)
+    {
+        return false;
+    }
+
+    const CTB_Sink *published = sink ? publish_sink(sink) : NULL;
+    if (sink && !published)
+    {
+        return false;
+    }
+    ctb_atomic_store_release(&ctb_global_sink, published);
+    return true;
+}
+
+bool ctb_set_thread_sink(const CTB_Sink *sink)
+{
+    if (sink && !sink->write_fn)
+    {
+        return false;
+    }
+
+    const CTB_Sink *published = sink ? publish_sink(sink) : NULL;
+    if (sink && !published)
+    {
+        return false;
+    }
+
+    /* The signal renderer may read the pointer on this thread */
+    ctb_signal_fence();
+    ctb_thread_sink = published;
+    return true;
+}
+
+void ctb_flush_sink(void)
+{
+    const CTB_Sink *sink = get_active_sink();
+    if (!sink)
+    {
+        fflush(stderr);
+        fflush(stdout);
+        return;
+    }
+
+    if (sink->flush_fn)
+    {
+        sink->flush_fn(sink->user_data);
+    }
+}
+
+bool ctb_output_use_color(FILE *stream)
+{
+    const CTB_Sink *sink = get_active_sink();
+    if (!sink)
+    {
+        return should_use_color(stream);
+    }
+
+    const char *no_color = getenv("NO_COLOR");
+    return sink->color && !(no_color && no_color[0] != '\0');
+}
+
+bool ctb_output_use_utf8(FILE *stream)
+{
+    return get_active_sink() || should_use_utf8(stream);
+}
+
+int ctb_output_width(FILE *stream)
+{
+    return get_terminal_width(get_active_sink() ? NULL : stream);
+}
+
+/**
+ * \brief Async-signal-safe write of a whole buffer to a file descriptor.
+ */
+static bool write_all(const int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+#ifdef _WIN32
+        const unsigned int chunk =
+            (length > 0x40000000) ? 0x40000000 : (unsigned int)length;
+        const int written = _write(fd, data, chunk);
+        if (written <= 0)
+        {
+            return false;
+        }
+#else
+        const ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+#endif
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+/**
+ * \brief Write to a default stream in the order of the tickets taken by writers.
+ * Only the write system call is serialised, since the output is already rendered.
+ *
+ * Waiting writers yield the CPU in a loop, so while a writer is blocked on a slow
+ * pipe or terminal, the writers queued behind it keep polling. Thread cancellation
+ * is deferred until the ticket is served, since a writer cancelled in between would
+ * never serve its ticket and every later output would wait forever.
+ *
+ * \param[in] stream The output stream.
+ * \param[in] data The output.
+ * \param[in] length The length of the output.
+ */
+static void write_ordered(FILE *stream, const char *data, const size_t length)
+{
+    /* Output buffered by the application comes first */
+    fflush(stream);
+    const int fd = STREAM_FD(stream);
+
+#ifndef _WIN32
+    int cancel_state;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+#endif
+
+    const unsigned int ticket = ctb_atomic_fetch_add(&ctb_output_next_ticket, 1u);
+    while (ctb_atomic_load_acquire(&ctb_output_now_serving) != ticket)
+    {
+        YIELD_THREAD();
+    }
+
+    /* A single write up to PIPE_BUF bytes is atomic for other processes too */
+    const int saved_errno = errno;
+    write_all(fd, data, length);
+    ctb_atomic_store_release(&ctb_output_now_serving, ticket + 1u);
+
+#ifndef _WIN32
+    pthread_setcancelstate(cancel_state, &cancel_state);
+#endif
+    errno = saved_errno;
+}
+
+void ctb_set_atomic_output(const bool enabled)
+{
+    ctb_atomic_store_relaxed(&ctb_atomic_output, enabled ? 1 : 0);
+}
+
+void ctb_output_write(CTB_Format_Arena_ *arena, FILE *stream)
+{
+    const CTB_Sink *sink = get_active_sink();
+    if (!sink)
+    {
+        if (ctb_atomic_load_relaxed(&ctb_atomic_output) && arena->length > 0)
+        {
+            write_ordered(stream, arena->data, arena->length);
+            arena->length = 0;
+            arena->data[0] = '\0';
+            return;
+        }
+        ctb_format_arena_write(arena, stream);
+        fflush(stream);
+        return;
+    }
+
+    if (arena->length > 0)
+    {
+        const CTB_Sink_Buffer buffer = {arena->data, arena->length};
+        sink->write_fn(sink->user_data, &buffer, 1);
+    }
+    arena->length = 0;
+    arena->data[0] = '\0';
+}
+
+void ctb_output_write_signal(const char *data, const size_t length)
+{
+    /* Published sinks are immutable, so a single load gives a consistent sink */
+    const CTB_Sink *sink = get_active_sink();
+
+    if (sink && sink->async_signal_safe)
+    {
+        const CTB_Sink_Buffer buffer = {data, length};
+        sink->write_fn(sink->user_data, &buffer, 1);
+        return;
+    }
+
+    SAFE_WRITE(STDERR_FD, data, (unsigned int)length);
+}
+
+/* File and file descriptor sinks */
+
+static bool file_sink_write(
+    void *user_data, const CTB_Sink_Buffer *buffers, const int num_buffers
+)
+{
+    FILE *stream = (FILE *)user_data;
+    bool success = true;
+    for (int i = 0; i < num_buffers; i++)
+    {
+        if (fwrite(buffers[i].data, 1, buffers[i].length, stream) != buffers[i].length)
+        {
+            success = false;
+        }
+    }
+
+    /* Keep the behaviour of the default streams, whose output is never held back */
+    fflush(stream);
+    return success;
+}
+
+static void file_sink_flush(void *user_data)
+{
+    fflush((FILE *)user_data);
+}
+
+CTB_Sink ctb_file_sink(FILE *stream)
+{
+    return (CTB_Sink){
+        .write_fn = file_sink_write,
+        .flush_fn = file_sink_flush,
+        .user_data = stream,
+        .color = false,
+        .async_signal_safe = false
+    };
+}
+
+static bool fd_sink_write(
+    void *user_data, const CTB_Sink_Buffer *buffers, const int num_buffers
+)
+{
+    const int fd = (int)(intptr_t)user_data;
+
+#ifdef _WIN32
+    for (int i = 0; i < num_buffers; i++)
+    {
+        if (!write_all(fd, buffers[i].data, buffers[i].length))
+        {
+            return false;
+        }
+    }
+    return true;
+#else
+    const int saved_errno = errno;
+    bool success = true;
+
+    for (int first = 0; first < num_buffers && success;)
+    {
+        const int count =
+            (num_buffers - first > SINK_MAX_IOV) ? SINK_MAX_IOV : num_buffers - first;
+
+        struct iovec iov[SINK_MAX_IOV];
+        for (int i = 0; i < count; i++)
+        {
+            iov[i].iov_base = (void *)(uintptr_t)buffers[first + i].data;
+            iov[i].iov_len = buffers[first + i].length;
+        }
+
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            success = false;
+            break;
+        }
+
+        /* Finish a short write buffer by buffer */
+        for (int i = 0; i < count && success; i++)
+        {
+            const size_t length = iov[i].iov_len;
+            if ((size_t)written >= length)
+            {
+                written -= (ssize_t)length;
+                continue;
+            }
+            success = write_all(
+                fd, (const char *)iov[i].iov_base + written, length - (size_t)written
+            );
+            written = 0;
+        }
+        first += count;
+    }
+
+    errno = saved_errno;
+    return success;
+#endif
+}
+
+CTB_Sink ctb_fd_sink(const int fd)
+{
+    return (CTB_Sink){
+        .write_fn = fd_sink_write,
+        .flush_fn = NULL,
+        .user_data = (void *)(intptr_t)fd,
+        .color = false,
+        .async_signal_safe = true
+    };
+}
+
+/* Ring buffer sink */
+
+struct CTB_Ring_Sink
+{
+    /* Total number of bytes ever written, reserved atomically by writers */
+    unsigned long long head;
+    size_t capacity;
+    char *data;
+};
+
+CTB_Ring_Sink *ctb_ring_sink_create(const size_t capacity)
+{
+    if (capacity == 0)
+    {
+        return NULL;
+    }
+
+    CTB_Ring_Sink *ring = ctb_malloc(sizeof(CTB_Ring_Sink) + capacity);
+    if (!ring)
+    {
+        return NULL;
+    }
+
+    ring->head = 0;
+    ring->capacity = capacity;
+    ring->data = (char *)(ring + 1);
+    return ring;
+}
+
+/**
+ * \brief Copy bytes into a ring buffer at a position, wrapping around its end.
+ */
+static void ring_copy_in(
+    CTB_Ring_Sink *ring, unsigned long long position, const char *data, size_t length
+)
+{
+    const size_t offset = (size_t)(position % ring->capacity);
+    const size_t first = (length < ring->capacity - offset)
+                             ? length
+                             : ring->capacity - offset;
+    memcpy(ring->data + offset, data, first);
+    memcpy(ring->data, data + first, length - first);
+}
+
+static bool ring_sink_write(
+    void *user_data, const CTB_Sink_Buffer *buffers, const int num_buffers
+)
+{
+    CTB_Ring_Sink *ring = (CTB_Ring_Sink *)user_data;
+
+    size_t total = 0;
+    for (int i = 0; i < num_buffers; i++)
+    {
+        total += buffers[i].length;
+    }
+
+    /* Only the tail of an oversized write survives */
+    size_t skip = (total > ring->capacity) ? total - ring->capacity : 0;
+    unsigned long long position = ctb_atomic_fetch_add(&ring->head, total);
+
+    for (int i = 0; i < num_buffers; i++)
+    {
+        const char *data = buffers[i].data;
+        size_t length = buffers[i].length;
+        if (skip >= length)
+        {
+            skip -= length;
+            position += length;
+            continue;
+        }
+
+        data += skip;
+        length -= skip;
+        position += skip;
+        skip = 0;
+
+        ring_copy_in(ring, position, data, length);
+        position += length;
+    }
+    return true;
+}
+
+CTB_Sink ctb_ring_sink(CTB_Ring_Sink *ring)
+{
+    return (CTB_Sink){
+        .write_fn = ring_sink_write,
+        .flush_fn = NULL,
+        .user_data = ring,
+        .color = false,
+        .async_signal_safe = true
+    };
+}
+
+size_t ctb_ring_sink_read(const CTB_Ring_Sink *ring, char *buffer, const size_t size)
+{
+    if (!ring || !buffer)
+    {
+        return 0;
+    }
+
+    const unsigned long long head = ctb_atomic_load_acquire(&ring->head);
+    size_t length = (head < ring->capacity) ? (size_t)head : ring->capacity;
+    if (length > size)
+    {
+        length = size;
+    }
+
+    const size_t offset = (size_t)((head - length) % ring->capacity);
+    const size_t first = (length < ring->capacity - offset)
+                             ? length
+                             : ring->capacity - offset;
+    memcpy(buffer, ring->data + offset, first);
+    memcpy(buffer + first, ring->data, length - first);
+    return length;
+}
+
+void ctb_ring_sink_destroy(CTB_Ring_Sink *ring)
+{
+    ctb_free(ring);
+}
+
+/* Syslog sink */
+
+/* Priority of the messages, i.e. facility user (1) and severity error (3) */
+#define SYSLOG_PRIORITY "<11>"
+#define SYSLOG_DEFAULT_PATH "/dev/log"
+#define SYSLOG_MAX_HEADER_SIZE 128
+
+struct CTB_Syslog_Sink
+{
+    int fd;
+    size_t header_length;
+    char header[SYSLOG_MAX_HEADER_SIZE];
+};
+
+#ifdef _WIN32
+CTB_Syslog_Sink *ctb_syslog_sink_create(const char *socket_path, const char *ident)
+{
+    (void)socket_path;
+    (void)ident;
+    return NULL;
+}
+
+static bool syslog_sink_write(
+    void *user_data, const CTB_Sink_Buffer *buffers, const int num_buffers
+)
+{
+    (void)user_data;
+    (void)buffers;
+    (void)num_buffers;
+    return false;
+}
+
+void ctb_syslog_sink_destroy(CTB_Syslog_Sink *syslog_sink)
+{
+    (void)syslog_sink;
+}
+#else
+CTB_Syslog_Sink *ctb_syslog_sink_create(const char *socket_path, const char *ident)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    const char *path = socket_path ? socket_path : SYSLOG_DEFAULT_PATH;
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        return NULL;
+    }
+    memcpy(address.sun_path, path, strlen(path) + 1);
+
+    const int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (connect(fd, (const struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    CTB_Syslog_Sink *syslog_sink = ctb_malloc(sizeof(CTB_Syslog_Sink));
+    if (!syslog_sink)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    syslog_sink->fd = fd;
+    const int length = ctb_format(
+        syslog_sink->header,
+        sizeof(syslog_sink->header),
+        SYSLOG_PRIORITY "%s[%d]: ",
+        ident ? ident : "c_traceback",
+        (int)getpid()
+    );
+    syslog_sink->header_length = (length < (int)sizeof(syslog_sink->header))
+                                     ? (size_t)length
+                                     : sizeof(syslog_sink->header) - 1;
+    return syslog_sink;
+}
+
+static bool syslog_sink_write(
+    void *user_data, const CTB_Sink_Buffer *buffers, const int num_buffers
+)
+{
+    CTB_Syslog_Sink *syslog_sink = (CTB_Syslog_Sink *)user_data;
+    const int saved_errno = errno;
+    bool success = true;
+
+    /* Each datagram is one message, so a long vector is sent as several messages */
+    for (int first = 0; first < num_buffers && success;)
+    {
+        const int count = (num_buffers - first > SINK_MAX_IOV - 1)
+                              ? SINK_MAX_IOV - 1
+                              : num_buffers - first;
+
+        struct iovec iov[SINK_MAX_IOV];
+        iov[0].iov_base = syslog_sink->header;
+        iov[0].iov_len = syslog_sink->header_length;
+        for (int i = 0; i < count; i++)
+        {
+            iov[i + 1].iov_base = (void *)(uintptr_t)buffers[first + i].data;
+            iov[i + 1].iov_len = buffers[first + i].length;
+        }
+
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = iov;
+        message.msg_iovlen = count + 1;
+
+        if (sendmsg(syslog_sink->fd, &message, 0) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            success = false;
+        }
+        first += count;
+    }
+
+    errno = saved_errno;
+    return success;
+}
+
+void ctb_syslog_sink_destroy(CTB_Syslog_Sink *syslog_sink)
+{
+    if (!syslog_sink)
+    {
+        return;
+    }
+    close(syslog_sink->fd);
+    ctb_free(syslog_sink);
+}
+#endif
+
+CTB_Sink ctb_syslog_sink(CTB_Syslog_Sink *syslog_sink)
+{
+    return (CTB_Sink){
+        .write_fn = syslog_sink_write,
+        .flush_fn = NULL,
+        .user_data = syslog_sink,
+        .color = false,
+        .async_signal_safe = true
+    };
+}
+
+/* Asynchronous queue sink */
+
+#ifdef _WIN32
+typedef SRWLOCK Mutex_;
+typedef CONDITION_VARIABLE Condition_;
+typedef HANDLE Thread_;
+#define THREAD_FUNCTION(name) static DWORD WINAPI name(LPVOID arg)
+#define THREAD_RETURN return 0
+#define mutex_init(mutex) (InitializeSRWLock(mutex), true)
+#define mutex_destroy(mutex) ((void)(mutex))
+#define mutex_lock(mutex) AcquireSRWLockExclusive(mutex)
+#define mutex_unlock(mutex) ReleaseSRWLockExclusive(mutex)
+#define condition_init(condition) (InitializeConditionVariable(condition), true)
+#define condition_destroy(condition) ((void)(condition))
+#define condition_wait(condition, mutex)                                               \
+    SleepConditionVariableSRW(condition, mutex, INFINITE, 0)
+#define condition_broadcast(condition) WakeAllConditionVariable(condition)
+#define thread_start(thread, function, arg)                                            \
+    ((*(thread) = CreateThread(NULL, 0, function, arg, 0, NULL)) != NULL)
+#define thread_join(thread) (WaitForSingleObject(thread, INFINITE), CloseHandle(thread))
+#else
+typedef pthread_mutex_t Mutex_;
+typedef pthread_cond_t Condition_;
+typedef pthread_t Thread_;
+#define THREAD_FUNCTION(name) static void *name(void *arg)
+#define THREAD_RETURN return NULL
+#define mutex_init(mutex) (pthread_mutex_init(mutex, NULL) == 0)
+#define mutex_destroy(mutex) pthread_mutex_destroy(mutex)
+#define mutex_lock(mutex) pthread_mutex_lock(mutex)
+#define mutex_unlock(mutex) pthread_mutex_unlock(mutex)
+#define condition_init(condition) (pthread_cond_init(condition, NULL) == 0)
+#define condition_destroy(condition) pthread_cond_destroy(condition)
+#define condition_wait(condition, mutex) pthread_cond_wait(condition, mutex)
+#define condition_broadcast(condition) pthread_cond_broadcast(condition)
+#define thread_start(thread, function, arg)                                            \
+    (pthread_create(thread, NULL, function, arg) == 0)
+#define thread_join(thread) pthread_join(thread, NULL)
+#endif
+
+/**
+ * Byte queue holding whole writes. Producers copy a write in while holding
+ * producer_lock and publish it by advancing head, the background thread passes
+ * [tail, head) to the target and advances tail afterwards.
+ */
+struct CTB_Async_Sink
+{
+    CTB_Sink target;
+    char *data;
+    size_t capacity;
+    unsigned long long head;
+    unsigned long long tail;
+    bool stop;
+
+    Mutex_ lock;
+    Mutex_ producer_lock;
+    Condition_ not_empty;
+    Condition_ not_full;
+    Thread_ thread;
+};
+
+THREAD_FUNCTION(async_sink_main)
+{
+    CTB_Async_Sink *queue = (CTB_Async_Sink *)arg;
+
+    /* Output of the target itself must not be queued behind the current write */
+    ctb_set_thread_sink(&queue->target);
+
+    mutex_lock(&queue->lock);
+    for (;;)
+    {
+        while (queue->head == queue->tail && !queue->stop)
+        {
+            condition_wait(&queue->not_empty, &queue->lock);
+        }
+        if (queue->head == queue->tail)
+        {
+            break;
+        }
+
+        const unsigned long long head = queue->head;
+        const size_t length = (size_t)(head - queue->tail);
+        const size_t offset = (size_t)(queue->tail % queue->capacity);
+        const size_t first = (length < queue->capacity - offset)
+                                 ? length
+                                 : queue->capacity - offset;
+        mutex_unlock(&queue->lock);
+
+        const CTB_Sink_Buffer buffers[2] = {
+            {queue->data + offset, first}, {queue->data, length - first}
+        };
+        queue->target.write_fn(
+            queue->target.user_data, buffers, (length > first) ? 2 : 1
+        );
+
+        mutex_lock(&queue->lock);
+        queue->tail = head;
+        condition_broadcast(&queue->not_full);
+    }
+    mutex_unlock(&queue->lock);
+
+    THREAD_RETURN;
+}
+
+/**
+ * \brief Wait until the background thread has written everything queued. Must be
+ * called with the queue locked.
+ */
+static void async_sink_wait_drained(CTB_Async_Sink *queue)
+{
+    while (queue->head != queue->tail)
+    {
+        condition_wait(&queue->not_full, &queue->lock);
+    }
+}
+
+static bool async_sink_write(
+    void *user_data, const CTB_Sink_Buffer *buffers, const int num_buffers
+)
+{
+    CTB_Async_Sink *queue = (CTB_Async_Sink *)user_data;
+
+    size_t total = 0;
+    for (int i = 0; i < num_buffers; i++)
+    {
+        total += buffers[i].length;
+    }
+
+    mutex_lock(&queue->producer_lock);
+    mutex_lock(&queue->lock);
+
+    /* A write larger than the queue goes to the target directly, in order */
+    if (total > queue->capacity)
+    {
+        async_sink_wait_drained(queue);
+        mutex_unlock(&queue->lock);
+        const bool success =
+            queue->target.write_fn(queue->target.user_data, buffers, num_buffers);
+        mutex_unlock(&queue->producer_lock);
+        return success;
+    }
+
+    while (queue->capacity - (size_t)(queue->head - queue->tail) < total)
+    {
+        condition_wait(&queue->not_full, &queue->lock);
+    }
+    mutex_unlock(&queue->lock);
+
+    /* Only this producer writes beyond head, so the copy needs no lock */
+    unsigned long long position = queue->head;
+    for (int i = 0; i < num_buffers; i++)
+    {
+        const size_t offset = (size_t)(position % queue->capacity);
+        const size_t length = buffers[i].length;
+        const size_t first = (length < queue->capacity - offset)
+                                 ? length
+                                 : queue->capacity - offset;
+        memcpy(queue->data + offset, buffers[i].data, first);
+        memcpy(queue->data, buffers[i].data + first, length - first);
+        position += length;
+    }
+
+    mutex_lock(&queue->lock);
+    queue->head = position;
+    condition_broadcast(&queue->not_empty);
+    mutex_unlock(&queue->lock);
+
+    mutex_unlock(&queue->producer_lock);
+    return true;
+}
+
+static void async_sink_flush(void *user_data)
+{
+    CTB_Async_Sink *queue = (CTB_Async_Sink *)user_data;
+
+    mutex_lock(&queue->lock);
+    async_sink_wait_drained(queue);
+    mutex_unlock(&queue->lock);
+
+    if (queue->target.flush_fn)
+    {
+        queue->target.flush_fn(queue->target.user_data);
+    }
+}
+
+CTB_Async_Sink *ctb_async_sink_create(const CTB_Sink *target, const size_t capacity)
+{
+    if (!target || !target->write_fn || capacity == 0)
+    {
+        return NULL;
+    }
+
+    CTB_Async_Sink *queue = ctb_malloc(sizeof(CTB_Async_Sink) + capacity);
+    if (!queue)
+    {
+        return NULL;
+    }
+
+    queue->target = *target;
+    queue->data = (char *)(queue + 1);
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->stop = false;
+
+    if (!mutex_init(&queue->lock))
+    {
+        ctb_free(queue);
+        return NULL;
+    }
+    if (!mutex_init(&queue->producer_lock))
+    {
+        mutex_destroy(&queue->lock);
+        ctb_free(queue);
+        return NULL;
+    }
+    if (!condition_init(&queue->not_empty))
+    {
+        mutex_destroy(&queue->producer_lock);
+        mutex_destroy(&queue->lock);
+        ctb_free(queue);
+        return NULL;
+    }
+    if (!condition_init(&queue->not_full))
+    {
+        condition_destroy(&queue->not_empty);
+        mutex_destroy(&queue->producer_lock);
+        mutex_destroy(&queue->lock);
+        ctb_free(queue);
+        return NULL;
+    }
+    if (!thread_start(&queue->thread, async_sink_main, queue))
+    {
+        condition_destroy(&queue->not_full);
+        condition_destroy(&queue->not_empty);
+        mutex_destroy(&queue->producer_lock);
+        mutex_destroy(&queue->lock);
+        ctb_free(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+CTB_Sink ctb_async_sink(CTB_Async_Sink *async_sink)
+{
+    return (CTB_Sink){
+        .write_fn = async_sink_write,
+        .flush_fn = async_sink_flush,
+        .user_data = async_sink,
+        .color = async_sink ? async_sink->target.color : false,
+        .async_signal_safe = false
+    };
+}
+
+void ctb_async_sink_destroy(CTB_Async_Sink *async_sink)
+{
+    if (!async_sink)
+    {
+        return;
+    }
+
+    mutex_lock(&async_sink->lock);
+    async_sink->stop = true;
+    condition_broadcast(&async_sink->not_empty);
+    mutex_unlock(&async_sink->lock);
+    thread_join(async_sink->thread);
+
+    if (async_sink->target.flush_fn)
+    {
+        async_sink->target.flush_fn(async_sink->target.user_data);
+    }
+
+    condition_destroy(&async_sink->not_full);
+    condition_destroy(&async_sink->not_empty);
+    mutex_destroy(&async_sink->producer_lock);
+    mutex_destroy(&async_sink->lock);
+    ctb_free(async_sink);
+}
@@ -0,0 +1,300 @@
+/**
+ * \file source_cache.c
+ * \brief Implementation of the cache of source files.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/source_cache.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct CTB_Source_File_
+{
+    char *data;
+    size_t size;
+    int num_lines;
+
+    /* Offset of the start of each line */
+    size_t line_offsets[];
+};
+
+typedef struct
+{
+    /* The path as passed on the first lookup, compared before the copy */
+    const char *path_literal;
+    char *path;
+
+    /* NULL if the file cannot be read */
+    CTB_Source_File_ *file;
+} Source_Entry;
+
+/* Cached files. Entries are only appended, so readers need no lock. */
+static Source_Entry ctb_source_entries[CTB_SOURCE_CACHE_MAX_FILES];
+static int ctb_num_source_entries = 0;
+static int ctb_source_cache_lock = 0;
+
+/**
+ * \brief Read a whole file into memory. The cache keeps its own copy, since a
+ * mapping of a source file that is truncated or rebuilt while the program runs
+ * raises SIGBUS when it is read.
+ *
+ * \param[in] path Path of the file.
+ * \param[out] size Size of the file in bytes.
+ * \return The content of the file, or NULL if it cannot be read or is empty.
+ */
+static char *read_file(const char *path, size_t *size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0 ||
+        file_size.QuadPart > (LONGLONG)UINT32_MAX)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+    const size_t capacity = (size_t)file_size.QuadPart;
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    const size_t capacity = (size_t)st.st_size;
+#endif
+
+    char *data = ctb_malloc(capacity);
+    size_t length = 0;
+    while (data && length < capacity)
+    {
+#ifdef _WIN32
+        DWORD num_read = 0;
+        if (!ReadFile(file, data + length, (DWORD)(capacity - length), &num_read, NULL))
+        {
+            break;
+        }
+#else
+        const ssize_t num_read = read(fd, data + length, capacity - length);
+        if (num_read == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (num_read == -1)
+        {
+            break;
+        }
+#endif
+        if (num_read == 0)
+        {
+            break;
+        }
+        length += (size_t)num_read;
+    }
+
+#ifdef _WIN32
+    CloseHandle(file);
+#else
+    close(fd);
+#endif
+
+    /* The file may have been truncated since its size was read */
+    if (data && length == 0)
+    {
+        ctb_free(data);
+        data = NULL;
+    }
+    *size = length;
+    return data;
+}
+
+/**
+ * \brief Read a source file and index the start of its lines.
+ *
+ * \param[in] path Path of the file.
+ * \return The source file, or NULL if it cannot be read.
+ */
+static CTB_Source_File_ *load_source_file(const char *path)
+{
+    size_t size;
+    char *data = read_file(path, &size);
+    if (!data)
+    {
+        return NULL;
+    }
+
+    size_t num_lines = (data[size - 1] != '\n') ? 1 : 0;
+    for (const char *p = data; (p = memchr(p, '\n', size - (size_t)(p - data)));
+         p++)
+    {
+        num_lines++;
+    }
+    if (num_lines > (size_t)INT_MAX)
+    {
+        ctb_free(data);
+        return NULL;
+    }
+
+    CTB_Source_File_ *file =
+        ctb_malloc(sizeof(CTB_Source_File_) + sizeof(size_t) * num_lines);
+    if (!file)
+    {
+        ctb_free(data);
+        return NULL;
+    }
+
+    file->data = data;
+    file->size = size;
+    file->num_lines = (int)num_lines;
+    size_t line = 0;
+    size_t offset = 0;
+    while (offset < size)
+    {
+        file->line_offsets[line++] = offset;
+        const char *end = memchr(data + offset, '\n', size - offset);
+        offset = end ? (size_t)(end - data) + 1 : size;
+    }
+    return file;
+}
+
+/**
+ * \brief Release a source file loaded by load_source_file.
+ */
+static void free_source_file(CTB_Source_File_ *file)
+{
+    if (file)
+    {
+        ctb_free(file->data);
+        ctb_free(file);
+    }
+}
+
+/**
+ * \brief Find a path among the first entries of the cache.
+ *
+ * \param[in] path The path.
+ * \param[in] first The first entry to compare.
+ * \param[in] num_entries The number of entries.
+ * \return The entry, or NULL if the path is not cached.
+ */
+static const Source_Entry *
+find_entry(const char *path, const int first, const int num_entries)
+{
+    for (int i = first; i < num_entries; i++)
+    {
+        const Source_Entry *entry = &ctb_source_entries[i];
+        if (entry->path_literal == path || strcmp(entry->path, path) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+const CTB_Source_File_ *ctb_source_cache_get(const char *path)
+{
+    if (!path)
+    {
+        return NULL;
+    }
+
+    const int num_entries = ctb_atomic_load_acquire(&ctb_num_source_entries);
+    const Source_Entry *entry = find_entry(path, 0, num_entries);
+    if (entry)
+    {
+        return entry->file;
+    }
+
+    /* Entries are never evicted, so a full cache would read the file every time */
+    if (num_entries >= CTB_SOURCE_CACHE_MAX_FILES)
+    {
+        return NULL;
+    }
+
+    /* Read the file without holding the lock, another thread may add it first */
+    const size_t path_size = strlen(path) + 1;
+    CTB_Source_File_ *file = load_source_file(path);
+    char *path_copy = ctb_malloc(path_size);
+
+    ctb_spin_lock(&ctb_source_cache_lock);
+    const int num_locked = ctb_num_source_entries;
+    entry = find_entry(path, num_entries, num_locked);
+    if (entry || !path_copy || num_locked >= CTB_SOURCE_CACHE_MAX_FILES)
+    {
+        ctb_spin_unlock(&ctb_source_cache_lock);
+        free_source_file(file);
+        ctb_free(path_copy);
+        return entry ? entry->file : NULL;
+    }
+
+    memcpy(path_copy, path, path_size);
+    ctb_source_entries[num_locked].path_literal = path;
+    ctb_source_entries[num_locked].path = path_copy;
+    ctb_source_entries[num_locked].file = file;
+    ctb_atomic_store_release(&ctb_num_source_entries, num_locked + 1);
+
+    ctb_spin_unlock(&ctb_source_cache_lock);
+    return file;
+}
+
+int ctb_source_file_num_lines(const CTB_Source_File_ *file)
+{
+    return file->num_lines;
+}
+
+const char *ctb_source_file_get_line(
+    const CTB_Source_File_ *file, const int line_number, size_t *length
+)
+{
+    if (line_number < 1 || line_number > file->num_lines)
+    {
+        return NULL;
+    }
+
+    const size_t start = file->line_offsets[line_number - 1];
+    size_t end =
+        (line_number < file->num_lines) ? file->line_offsets[line_number] : file->size;
+    while (end > start && (file->data[end - 1] == '\n' || file->data[end - 1] == '\r'))
+    {
+        end--;
+    }
+
+    *length = end - start;
+    return file->data + start;
+}
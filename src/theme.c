@@ -0,0 +1,396 @@
+/**
+ * \file theme.c
+ * \brief Compilation of colour themes into output templates.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/atomic.h"
+#include "internal/theme.h"
+
+#define UTF8_DASH "\u2500"
+#define UTF8_DASH_LENGTH (sizeof(UTF8_DASH) - 1)
+
+static CTB_Theme_Template_ ctb_plain_template;
+static CTB_Theme_Template_ ctb_default_template;
+static CTB_Theme_Template_ ctb_custom_template;
+
+/* Template used when colours are enabled, NULL for the default theme */
+static const CTB_Theme_Template_ *ctb_color_template = NULL;
+
+static char ctb_rule_utf8[CTB_HRULE_MAX_WIDTH * UTF8_DASH_LENGTH];
+static char ctb_rule_ascii[CTB_HRULE_MAX_WIDTH];
+
+static int ctb_templates_ready = 0;
+static int ctb_theme_lock = 0;
+
+/* Writer of the spans of a template */
+typedef struct
+{
+    CTB_Theme_Template_ *theme_template;
+    CTB_Span_Id_ span;
+    size_t length;
+    bool overflow;
+} Template_Builder;
+
+/**
+ * \brief Close the current span and open the next one.
+ */
+static void begin_span(Template_Builder *builder, const CTB_Span_Id_ next)
+{
+    CTB_Template_Span_ *span = &builder->theme_template->spans[builder->span];
+    span->length = (unsigned short)(builder->length - span->offset);
+
+    if (next < CTB_NUM_SPANS)
+    {
+        builder->span = next;
+        builder->theme_template->spans[next].offset = (unsigned short)builder->length;
+    }
+}
+
+/**
+ * \brief Append a string to the current span. NULL is treated as an empty string.
+ */
+static void add(Template_Builder *builder, const char *str)
+{
+    if (!str)
+    {
+        return;
+    }
+
+    const size_t length = strlen(str);
+    if (length > CTB_THEME_TEMPLATE_SIZE - builder->length)
+    {
+        builder->overflow = true;
+        return;
+    }
+
+    memcpy(builder->theme_template->data + builder->length, str, length);
+    builder->length += length;
+}
+
+/**
+ * \brief Compile a theme into a template.
+ *
+ * \param[out] theme_template The template.
+ * \param[in] theme The theme.
+ * \return false if the template text does not fit.
+ */
+static bool compile_theme(
+    CTB_Theme_Template_ *theme_template, const CTB_Theme *restrict theme
+)
+{
+    Template_Builder builder = {theme_template, CTB_SPAN_FRAME_INDEX, 0, false};
+    Template_Builder *b = &builder;
+    const CTB_Theme *t = theme;
+
+    memset(theme_template->spans, 0, sizeof(theme_template->spans));
+
+    /* Frame */
+    add(b, "  ");
+    add(b, t->counter);
+    add(b, "(#");
+
+    begin_span(b, CTB_SPAN_FRAME_FILE_PARENT);
+    add(b, ")");
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->text);
+    add(b, "File \"");
+    add(b, t->reset);
+    add(b, t->file_parent);
+
+    begin_span(b, CTB_SPAN_FRAME_FILE);
+    add(b, t->reset);
+    add(b, t->file);
+
+    begin_span(b, CTB_SPAN_FRAME_LINE);
+    add(b, t->reset);
+    add(b, t->text);
+    add(b, "\", line");
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->line);
+
+    begin_span(b, CTB_SPAN_FRAME_FUNCTION);
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->text);
+    add(b, "in");
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->function);
+
+    begin_span(b, CTB_SPAN_FRAME_SOURCE);
+    add(b, t->reset);
+    add(b, ":\n    ");
+    add(b, t->error);
+
+    begin_span(b, CTB_SPAN_FRAME_END);
+    add(b, t->reset);
+    add(b, "\n");
+
+    /* Source excerpt */
+    begin_span(b, CTB_SPAN_EXCERPT);
+    add(b, t->reset);
+    add(b, ":\n");
+
+    begin_span(b, CTB_SPAN_EXCERPT_LINE);
+    add(b, "       ");
+    add(b, t->line);
+
+    begin_span(b, CTB_SPAN_EXCERPT_CURRENT);
+    add(b, "    ");
+    add(b, t->error);
+    add(b, ">");
+    add(b, t->reset);
+    add(b, "  ");
+    add(b, t->line);
+
+    begin_span(b, CTB_SPAN_EXCERPT_TEXT);
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->text);
+    add(b, "|");
+    add(b, t->reset);
+    add(b, " ");
+
+    begin_span(b, CTB_SPAN_EXCERPT_CURRENT_TEXT);
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->text);
+    add(b, "|");
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->error);
+
+    begin_span(b, CTB_SPAN_EXCERPT_END);
+    add(b, "\n");
+
+    begin_span(b, CTB_SPAN_EXCERPT_CURRENT_END);
+    add(b, t->reset);
+    add(b, "\n");
+
+    /* Header */
+    begin_span(b, CTB_SPAN_ERROR_INDEX);
+    add(b, t->error);
+    add(b, "(#");
+
+    begin_span(b, CTB_SPAN_ERROR_INDEX_END);
+    add(b, ")");
+    add(b, t->reset);
+    add(b, " ");
+
+    begin_span(b, CTB_SPAN_HEADER);
+    add(b, t->error_bold);
+
+    begin_span(b, CTB_SPAN_HEADER_END);
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->error);
+    add(b, "(most recent call last):");
+    add(b, t->reset);
+    add(b, "\n");
+
+    /* Skipped frames */
+    begin_span(b, CTB_SPAN_SKIPPED);
+    add(b, "\n      ");
+    add(b, t->text);
+    add(b, "[... Skipped ");
+
+    begin_span(b, CTB_SPAN_SKIPPED_END);
+    add(b, " frames ...]");
+    add(b, t->reset);
+    add(b, "\n\n");
+
+    /* Error message */
+    begin_span(b, CTB_SPAN_ERROR_NAME);
+    add(b, t->error_bold);
+
+    begin_span(b, CTB_SPAN_ERROR_NAME_END);
+    add(b, t->reset);
+    add(b, "\n");
+
+    begin_span(b, CTB_SPAN_ERROR_MESSAGE);
+    add(b, ":");
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->error);
+
+    begin_span(b, CTB_SPAN_ERROR_MESSAGE_END);
+    add(b, t->reset);
+    add(b, "\n");
+
+    /* Repeated errors */
+    begin_span(b, CTB_SPAN_REPEATED);
+    add(b, t->text);
+    add(b, "[... Thrown ");
+
+    begin_span(b, CTB_SPAN_REPEATED_END);
+    add(b, " times ...]");
+    add(b, t->reset);
+    add(b, "\n");
+
+    begin_span(b, CTB_SPAN_LAST_MESSAGE);
+    add(b, t->text);
+    add(b, "Last message:");
+    add(b, t->reset);
+    add(b, " ");
+    add(b, t->error);
+
+    begin_span(b, CTB_SPAN_LAST_MESSAGE_END);
+    add(b, t->reset);
+    add(b, "\n");
+
+    begin_span(b, CTB_SPAN_ANOTHER_EXCEPTION);
+    add(b, "\n");
+    add(b, t->another_exception);
+    add(b, "During handling of the above exception, another exception occurred:");
+    add(b, t->reset);
+    add(b, "\n\n");
+
+    /* Truncated errors */
+    begin_span(b, CTB_SPAN_TRUNCATED);
+    add(b, "\n");
+    add(b, t->error_bold);
+    add(b, "[... Truncated ");
+
+    begin_span(b, CTB_SPAN_TRUNCATED_END);
+    add(b, " errors ...]");
+    add(b, t->reset);
+    add(b, "\n");
+
+    /* Horizontal rules */
+    begin_span(b, CTB_SPAN_ERROR_RULE);
+    add(b, t->error);
+
+    begin_span(b, CTB_SPAN_ACCENT_RULE);
+    add(b, t->accent);
+
+    begin_span(b, CTB_SPAN_RULE_END);
+    add(b, t->reset);
+    add(b, "\n");
+
+    /* Highlighted text */
+    begin_span(b, CTB_SPAN_ACCENT);
+    add(b, t->accent_bold);
+
+    begin_span(b, CTB_SPAN_ACCENT_END);
+    add(b, t->reset);
+
+    begin_span(b, CTB_NUM_SPANS);
+    return !builder.overflow;
+}
+
+/**
+ * \brief Compile the built-in templates on first use.
+ */
+static void init_templates(void)
+{
+    if (ctb_atomic_load_acquire(&ctb_templates_ready))
+    {
+        return;
+    }
+
+    ctb_spin_lock(&ctb_theme_lock);
+    if (!ctb_templates_ready)
+    {
+        const CTB_Theme plain = {0};
+        const CTB_Theme default_theme = ctb_default_theme();
+        compile_theme(&ctb_plain_template, &plain);
+        compile_theme(&ctb_default_template, &default_theme);
+
+        for (int i = 0; i < CTB_HRULE_MAX_WIDTH; i++)
+        {
+            memcpy(ctb_rule_utf8 + i * UTF8_DASH_LENGTH, UTF8_DASH, UTF8_DASH_LENGTH);
+            ctb_rule_ascii[i] = '-';
+        }
+
+        ctb_atomic_store_release(&ctb_templates_ready, 1);
+    }
+    ctb_spin_unlock(&ctb_theme_lock);
+}
+
+CTB_Theme ctb_default_theme(void)
+{
+    return (CTB_Theme){
+        .reset = CTB_RESET_COLOR,
+        .error = CTB_ERROR_COLOR,
+        .error_bold = CTB_ERROR_BOLD_COLOR,
+        .text = CTB_TRACEBACK_TEXT_COLOR,
+        .counter = CTB_TRACEBACK_COUNTER_COLOR,
+        .file_parent = CTB_TRACEBACK_FILE_PARENT_COLOR,
+        .file = CTB_TRACEBACK_FILE_COLOR,
+        .line = CTB_TRACEBACK_LINE_COLOR,
+        .function = CTB_TRACEBACK_FUNC_COLOR,
+        .another_exception = CTB_TRACEBACK_ANOTHER_EXCEPTION_TEXT_COLOR,
+        .accent = CTB_THEME_COLOR,
+        .accent_bold = CTB_THEME_BOLD_COLOR
+    };
+}
+
+bool ctb_set_theme(const CTB_Theme *theme)
+{
+    init_templates();
+
+    if (!theme)
+    {
+        ctb_atomic_store_release(&ctb_color_template, NULL);
+        return true;
+    }
+
+    CTB_Theme_Template_ compiled;
+    if (!compile_theme(&compiled, theme))
+    {
+        return false;
+    }
+
+    ctb_spin_lock(&ctb_theme_lock);
+    ctb_custom_template = compiled;
+    ctb_atomic_store_release(&ctb_color_template, &ctb_custom_template);
+    ctb_spin_unlock(&ctb_theme_lock);
+
+    return true;
+}
+
+const CTB_Theme_Template_ *ctb_get_theme_template(const bool use_color)
+{
+    init_templates();
+
+    if (!use_color)
+    {
+        return &ctb_plain_template;
+    }
+
+    const CTB_Theme_Template_ *theme_template =
+        ctb_atomic_load_acquire(&ctb_color_template);
+    return theme_template ? theme_template : &ctb_default_template;
+}
+
+const char *ctb_get_rule_dashes(const bool use_utf8, int count, size_t *length)
+{
+    init_templates();
+
+    if (count < 0)
+    {
+        count = 0;
+    }
+    else if (count > CTB_HRULE_MAX_WIDTH)
+    {
+        count = CTB_HRULE_MAX_WIDTH;
+    }
+
+    if (use_utf8)
+    {
+        *length = (size_t)count * UTF8_DASH_LENGTH;
+        return ctb_rule_utf8;
+    }
+
+    *length = (size_t)count;
+    return ctb_rule_ascii;
+}
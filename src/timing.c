@@ -0,0 +1,461 @@
+/**
+ * \file timing.c
+ * \brief Per-thread latency histograms for TRACE_TIMED call sites.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/clock.h"
+#include "internal/trace.h"
+#include "internal/utils.h"
+
+/**
+ * Histogram layout: values below 8 ticks get one bucket each, larger values are
+ * bucketed by their highest set bit with 2 bits of sub-bucket precision.
+ */
+#define CTB_TIMING_SUB_BUCKET_BITS 2
+#define CTB_TIMING_SUB_BUCKETS (1 << CTB_TIMING_SUB_BUCKET_BITS)
+#define CTB_TIMING_LINEAR_BUCKETS (2 * CTB_TIMING_SUB_BUCKETS)
+#define CTB_TIMING_NUM_BUCKETS 256
+
+typedef struct CTB_Timing_Site_
+{
+    const CTB_Frame *site;
+    unsigned long long count;
+    unsigned long long total;
+    unsigned long long max;
+    uint32_t buckets[CTB_TIMING_NUM_BUCKETS];
+} CTB_Timing_Site_;
+
+typedef struct CTB_Timing_Table_
+{
+    struct CTB_Timing_Table_ *next;
+
+    /* Set when the owning thread exits, so that another thread may reuse it */
+    bool released;
+
+    /* Value of ctb_timing_generation when the owner last reset the statistics */
+    unsigned int generation;
+    CTB_Timing_Site_ sites[CTB_MAX_TIMED_SITES];
+} CTB_Timing_Table_;
+
+static ctb_thread_local CTB_Timing_Table_ *ctb_timing_table = NULL;
+
+/* All tables ever created, so that reports can aggregate across threads */
+static CTB_Timing_Table_ *ctb_timing_tables = NULL;
+static int ctb_timing_lock = 0;
+
+/* Incremented by ctb_reset_timing. Only the owner of a table writes its statistics,
+   so each owner resets its own table on its next update. */
+static unsigned int ctb_timing_generation = 0;
+
+/**
+ * \brief Get the number of significant bits of a non-zero value.
+ */
+static inline int bit_width(const unsigned long long value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 64 - __builtin_clzll(value);
+#else
+    int width = 0;
+    unsigned long long v = value;
+    while (v)
+    {
+        width++;
+        v >>= 1;
+    }
+    return width;
+#endif
+}
+
+/**
+ * \brief Map a duration to its histogram bucket.
+ */
+static inline int bucket_index(const unsigned long long value)
+{
+    if (value < CTB_TIMING_LINEAR_BUCKETS)
+    {
+        return (int)value;
+    }
+
+    const int msb = bit_width(value) - 1;
+    const int shift = msb - CTB_TIMING_SUB_BUCKET_BITS;
+    const int sub = (int)(value >> shift) & (CTB_TIMING_SUB_BUCKETS - 1);
+    return CTB_TIMING_LINEAR_BUCKETS +
+           (msb - CTB_TIMING_SUB_BUCKET_BITS - 1) * CTB_TIMING_SUB_BUCKETS + sub;
+}
+
+/**
+ * \brief Get the highest value that maps to the given bucket.
+ */
+static unsigned long long bucket_upper_bound(const int index)
+{
+    if (index < CTB_TIMING_LINEAR_BUCKETS)
+    {
+        return (unsigned long long)index;
+    }
+
+    const int offset = index - CTB_TIMING_LINEAR_BUCKETS;
+    const int msb = offset / CTB_TIMING_SUB_BUCKETS + CTB_TIMING_SUB_BUCKET_BITS + 1;
+    const int sub = offset % CTB_TIMING_SUB_BUCKETS;
+    const int shift = msb - CTB_TIMING_SUB_BUCKET_BITS;
+    const unsigned long long lower =
+        (1ULL << msb) | ((unsigned long long)sub << shift);
+    return lower + ((1ULL << shift) - 1);
+}
+
+/**
+ * \brief Get the timing table of the calling thread, creating it on first use.
+ *
+ * \return The timing table, or NULL if it cannot be allocated.
+ */
+static CTB_Timing_Table_ *get_timing_table(void)
+{
+    CTB_Timing_Table_ *table = ctb_timing_table;
+    if (table)
+    {
+        return table;
+    }
+
+    /* Reuse the table of an exited thread. Its statistics stay in the table, so
+       reports still include them. */
+    ctb_spin_lock(&ctb_timing_lock);
+    for (table = ctb_atomic_load_acquire(&ctb_timing_tables); table;
+         table = table->next)
+    {
+        if (ctb_atomic_load_acquire(&table->released))
+        {
+            ctb_atomic_store_relaxed(&table->released, false);
+            break;
+        }
+    }
+    ctb_spin_unlock(&ctb_timing_lock);
+    if (table)
+    {
+        ctb_timing_table = table;
+        return table;
+    }
+
+    table = ctb_calloc(1, sizeof(CTB_Timing_Table_));
+    if (!table)
+    {
+        return NULL;
+    }
+
+    ctb_spin_lock(&ctb_timing_lock);
+    table->next = ctb_timing_tables;
+    ctb_atomic_store_release(&ctb_timing_tables, table);
+    ctb_spin_unlock(&ctb_timing_lock);
+
+    ctb_timing_table = table;
+    return table;
+}
+
+void ctb_release_timing_table(void)
+{
+    CTB_Timing_Table_ *table = ctb_timing_table;
+    if (table)
+    {
+        ctb_timing_table = NULL;
+        ctb_atomic_store_release(&table->released, true);
+    }
+}
+
+/**
+ * \brief Find the slot of a call site in a timing table, claiming a free slot if the
+ * site is new.
+ *
+ * \return The slot, or NULL if the table is full.
+ */
+static CTB_Timing_Site_ *find_site(CTB_Timing_Table_ *table, const CTB_Frame *site)
+{
+    const uintptr_t hash = ((uintptr_t)site >> 4) * 0x9E3779B97F4A7C15ULL;
+    const int start = (int)(hash % CTB_MAX_TIMED_SITES);
+
+    for (int i = 0; i < CTB_MAX_TIMED_SITES; i++)
+    {
+        CTB_Timing_Site_ *slot = &table->sites[(start + i) % CTB_MAX_TIMED_SITES];
+        const CTB_Frame *slot_site = ctb_atomic_load_relaxed(&slot->site);
+        if (slot_site == site)
+        {
+            return slot;
+        }
+        if (!slot_site)
+        {
+            ctb_atomic_store_release(&slot->site, site);
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Zero the statistics of a timing table, keeping its call sites.
+ */
+static void reset_timing_table(CTB_Timing_Table_ *table)
+{
+    for (int s = 0; s < CTB_MAX_TIMED_SITES; s++)
+    {
+        CTB_Timing_Site_ *slot = &table->sites[s];
+        ctb_atomic_store_relaxed(&slot->count, 0);
+        ctb_atomic_store_relaxed(&slot->total, 0);
+        ctb_atomic_store_relaxed(&slot->max, 0);
+        for (int b = 0; b < CTB_TIMING_NUM_BUCKETS; b++)
+        {
+            ctb_atomic_store_relaxed(&slot->buckets[b], 0);
+        }
+    }
+}
+
+unsigned long long ctb_timing_begin(void)
+{
+    return ctb_clock_ticks();
+}
+
+void ctb_timing_end(const CTB_Frame *site, const unsigned long long start)
+{
+    const unsigned long long elapsed = ctb_clock_ticks() - start;
+
+    CTB_Timing_Table_ *table = get_timing_table();
+    if (!table)
+    {
+        return;
+    }
+
+    const unsigned int generation = ctb_atomic_load_acquire(&ctb_timing_generation);
+    if (table->generation != generation)
+    {
+        reset_timing_table(table);
+        ctb_atomic_store_release(&table->generation, generation);
+    }
+
+    CTB_Timing_Site_ *slot = find_site(table, site);
+    if (!slot)
+    {
+        return;
+    }
+
+    /* Only the owning thread writes, so plain increments published with relaxed
+       stores are enough for concurrent readers. */
+    const int index = bucket_index(elapsed);
+    ctb_atomic_store_relaxed(&slot->buckets[index], slot->buckets[index] + 1);
+    ctb_atomic_store_relaxed(&slot->count, slot->count + 1);
+    ctb_atomic_store_relaxed(&slot->total, slot->total + elapsed);
+    if (elapsed > slot->max)
+    {
+        ctb_atomic_store_relaxed(&slot->max, elapsed);
+    }
+}
+
+/**
+ * \brief Get the value at the given quantile of a histogram.
+ */
+static unsigned long long histogram_quantile(
+    const unsigned long long *buckets,
+    const unsigned long long count,
+    const unsigned long long max,
+    const double quantile
+)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    unsigned long long rank = (unsigned long long)(quantile * (double)count);
+    if (rank >= count)
+    {
+        rank = count - 1;
+    }
+
+    unsigned long long seen = 0;
+    for (int i = 0; i < CTB_TIMING_NUM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen > rank)
+        {
+            const unsigned long long upper = bucket_upper_bound(i);
+            return (upper < max) ? upper : max;
+        }
+    }
+    return max;
+}
+
+typedef struct CTB_Timing_Merged_
+{
+    const CTB_Frame *site;
+    unsigned long long count;
+    unsigned long long total;
+    unsigned long long max;
+    unsigned long long buckets[CTB_TIMING_NUM_BUCKETS];
+} CTB_Timing_Merged_;
+
+/**
+ * \brief Merge the per-thread histograms of every table by call site.
+ *
+ * \param[out] num_merged The number of distinct call sites.
+ * \return Array of merged sites owned by the caller, or NULL.
+ */
+static CTB_Timing_Merged_ *merge_timing_tables(int *num_merged)
+{
+    int capacity = 0;
+    int count = 0;
+    CTB_Timing_Merged_ *merged = NULL;
+    const unsigned int generation = ctb_atomic_load_acquire(&ctb_timing_generation);
+
+    for (const CTB_Timing_Table_ *table = ctb_atomic_load_acquire(&ctb_timing_tables);
+         table;
+         table = table->next)
+    {
+        /* The statistics of a table predate the last reset until its owner resets
+           them */
+        if (ctb_atomic_load_acquire(&table->generation) != generation)
+        {
+            continue;
+        }
+
+        for (int s = 0; s < CTB_MAX_TIMED_SITES; s++)
+        {
+            const CTB_Timing_Site_ *slot = &table->sites[s];
+            const CTB_Frame *site = ctb_atomic_load_acquire(&slot->site);
+            if (!site)
+            {
+                continue;
+            }
+
+            int m = 0;
+            while (m < count && merged[m].site != site)
+            {
+                m++;
+            }
+
+            if (m == count)
+            {
+                if (count == capacity)
+                {
+                    const int new_capacity = capacity ? 2 * capacity : 16;
+                    CTB_Timing_Merged_ *grown =
+                        ctb_realloc(merged, sizeof(CTB_Timing_Merged_) * new_capacity);
+                    if (!grown)
+                    {
+                        *num_merged = count;
+                        return merged;
+                    }
+                    merged = grown;
+                    capacity = new_capacity;
+                }
+                memset(&merged[m], 0, sizeof(CTB_Timing_Merged_));
+                merged[m].site = site;
+                count++;
+            }
+
+            CTB_Timing_Merged_ *target = &merged[m];
+            target->count += ctb_atomic_load_relaxed(&slot->count);
+            target->total += ctb_atomic_load_relaxed(&slot->total);
+            const unsigned long long max = ctb_atomic_load_relaxed(&slot->max);
+            if (max > target->max)
+            {
+                target->max = max;
+            }
+            for (int b = 0; b < CTB_TIMING_NUM_BUCKETS; b++)
+            {
+                target->buckets[b] += ctb_atomic_load_relaxed(&slot->buckets[b]);
+            }
+        }
+    }
+
+    *num_merged = count;
+    return merged;
+}
+
+int ctb_get_timing_stats(CTB_Timing_Stats *stats, const int max_stats)
+{
+    int num_merged = 0;
+    CTB_Timing_Merged_ *merged = merge_timing_tables(&num_merged);
+    const double ticks_per_ns = ctb_clock_ticks_per_ns();
+
+    for (int i = 0; i < num_merged && i < max_stats; i++)
+    {
+        const CTB_Timing_Merged_ *m = &merged[i];
+        stats[i].site = m->site;
+        stats[i].count = m->count;
+        stats[i].total_ns = (double)m->total / ticks_per_ns;
+        const unsigned long long p50 =
+            histogram_quantile(m->buckets, m->count, m->max, 0.50);
+        const unsigned long long p99 =
+            histogram_quantile(m->buckets, m->count, m->max, 0.99);
+        stats[i].p50_ns = (double)p50 / ticks_per_ns;
+        stats[i].p99_ns = (double)p99 / ticks_per_ns;
+        stats[i].max_ns = (double)m->max / ticks_per_ns;
+    }
+
+    ctb_free(merged);
+    return num_merged;
+}
+
+void ctb_log_timing_report(void)
+{
+    FILE *const stream = stderr;
+    const bool use_color = should_use_color(stream);
+    const char *reset = use_color ? CTB_RESET_COLOR : "";
+    const char *header_color = use_color ? CTB_THEME_BOLD_COLOR : "";
+    const char *text_color = use_color ? CTB_TRACEBACK_TEXT_COLOR : "";
+    const char *site_color = use_color ? CTB_TRACEBACK_FUNC_COLOR : "";
+
+    const int num_sites = ctb_get_timing_stats(NULL, 0);
+    CTB_Timing_Stats *stats =
+        (num_sites > 0) ? ctb_malloc(sizeof(CTB_Timing_Stats) * num_sites) : NULL;
+    const int num_stats = stats ? ctb_get_timing_stats(stats, num_sites) : 0;
+
+    fprintf(stream, "%sTiming report%s\n", header_color, reset);
+    if (num_stats <= 0)
+    {
+        fputs("There is no recorded timing!\n", stream);
+        ctb_free(stats);
+        fflush(stream);
+        return;
+    }
+
+    for (int i = 0; i < num_stats && i < num_sites; i++)
+    {
+        const CTB_Frame *site = stats[i].site;
+        const int dir_len = get_parent_path_length(site->filename);
+
+        // clang-format off
+        fprintf(
+            stream,
+            "  %s%s:%d%s %sin%s %s%s%s: %s%s%s\n",
+            text_color, site->filename + dir_len, site->line_number, reset,
+            text_color, reset,
+            site_color, site->function_name, reset,
+            text_color, site->source_code, reset
+        );
+        // clang-format on
+        fprintf(
+            stream,
+            "    count %llu, p50 %.0f ns, p99 %.0f ns, max %.0f ns, total %.3f ms\n",
+            stats[i].count,
+            stats[i].p50_ns,
+            stats[i].p99_ns,
+            stats[i].max_ns,
+            stats[i].total_ns / 1e6
+        );
+    }
+
+    ctb_free(stats);
+    fflush(stream);
+}
+
+void ctb_reset_timing(void)
+{
+    ctb_atomic_fetch_add(&ctb_timing_generation, 1u);
+}
@@ -1,18 +1,155 @@
 /**
- * \file context.c
+ * \file trace.c
  * \brief Declaration of C Traceback global context, and function definitions for C
  * Traceback library.
  *
  * \author Ching-Yin Ng
  */
 
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/chrome_trace.h"
+#include "internal/format.h"
 #include "internal/trace.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 static ctb_thread_local CTB_Context ctb_traceback_context = {0};
 
+/* Context switched in by a task scheduler, NULL for the thread's own context */
+static ctb_thread_local CTB_Context *ctb_active_context = NULL;
+
+/* Thread-exit hook returning the context storage and cached objects to the pool */
+#ifdef _WIN32
+static DWORD ctb_context_fls_index = FLS_OUT_OF_INDEXES;
+static INIT_ONCE ctb_context_key_once = INIT_ONCE_STATIC_INIT;
+
+static void WINAPI release_thread_context(void *context)
+{
+    if (context)
+    {
+        ctb_release_context_storage(context);
+        ctb_release_format_arena();
+        ctb_release_chrome_trace_buffer();
+        ctb_release_timing_table();
+        ctb_release_pool_cache();
+    }
+}
+
+static BOOL CALLBACK create_context_key(INIT_ONCE *once, void *param, void **out)
+{
+    (void)once;
+    (void)param;
+    (void)out;
+    ctb_context_fls_index = FlsAlloc(release_thread_context);
+    return TRUE;
+}
+
+static void register_thread_context(CTB_Context *context)
+{
+    InitOnceExecuteOnce(&ctb_context_key_once, create_context_key, NULL, NULL);
+    if (ctb_context_fls_index != FLS_OUT_OF_INDEXES)
+    {
+        FlsSetValue(ctb_context_fls_index, context);
+    }
+}
+#else
+static pthread_key_t ctb_context_key;
+static pthread_once_t ctb_context_key_once = PTHREAD_ONCE_INIT;
+static bool ctb_context_key_created = false;
+
+static void release_thread_context(void *context)
+{
+    ctb_release_context_storage(context);
+    ctb_release_format_arena();
+    ctb_release_chrome_trace_buffer();
+    ctb_release_timing_table();
+    ctb_release_pool_cache();
+}
+
+static void create_context_key(void)
+{
+    ctb_context_key_created =
+        (pthread_key_create(&ctb_context_key, release_thread_context) == 0);
+}
+
+static void register_thread_context(CTB_Context *context)
+{
+    pthread_once(&ctb_context_key_once, create_context_key);
+    if (ctb_context_key_created)
+    {
+        pthread_setspecific(ctb_context_key, context);
+    }
+}
+#endif
+
 CTB_Context *get_context(void)
 {
-    return &ctb_traceback_context;
+    CTB_Context *context = ctb_active_context;
+    if (context)
+    {
+        return context;
+    }
+
+    context = &ctb_traceback_context;
+    if (!context->call_stack_frames)
+    {
+        ctb_init_context_storage(context);
+        register_thread_context(context);
+    }
+    return context;
+}
+
+CTB_Context *peek_context(void)
+{
+    CTB_Context *context = ctb_active_context;
+    return context ? context : &ctb_traceback_context;
+}
+
+CTB_Context *ctb_context_create(void)
+{
+    CTB_Context *context = ctb_calloc(1, sizeof(CTB_Context));
+    if (!context)
+    {
+        return NULL;
+    }
+
+    if (!ctb_alloc_context_storage(context))
+    {
+        ctb_free(context);
+        return NULL;
+    }
+    return context;
+}
+
+void ctb_context_destroy(CTB_Context *context)
+{
+    if (!context)
+    {
+        return;
+    }
+
+    ctb_release_context_storage(context);
+    ctb_free(context);
+}
+
+CTB_Context *ctb_context_switch(CTB_Context *context)
+{
+    CTB_Context *previous = ctb_active_context;
+
+    /* The profiler may sample the active context from a signal handler */
+    ctb_signal_fence();
+    ctb_active_context = context;
+    return previous;
+}
+
+CTB_Context *ctb_context_current(void)
+{
+    return ctb_active_context;
 }
 
 void ctb_push_call_stack_frame(
@@ -28,17 +165,170 @@ void ctb_push_call_stack_frame(
         return;
     }
 
-    if (call_depth >= CTB_MAX_CALL_STACK_DEPTH)
+    if (call_depth >= context->max_call_stack_depth)
+    {
+        frame_index = context->max_call_stack_depth - 1;
+    }
+
+    if (context->num_frame_signatures > frame_index)
     {
-        frame_index = CTB_MAX_CALL_STACK_DEPTH - 1;
+        context->num_frame_signatures = frame_index;
     }
 
-    CTB_Frame_ *frame = &context->call_stack_frames[frame_index];
+    CTB_Frame *frame = &context->call_stack_frames[frame_index];
     frame->filename = file;
     frame->function_name = func;
     frame->line_number = line;
     frame->source_code = source_code;
+
+    /* The profiler may sample this stack from a signal handler on this thread, so
+       the frame must be complete before it becomes visible. */
+    ctb_signal_fence();
     context->call_depth++;
+
+    if (ctb_atomic_load_relaxed(&ctb_chrome_trace_enabled))
+    {
+        ctb_chrome_trace_begin_event(frame);
+    }
+}
+
+int ctb_push_call_stack_site(const CTB_Frame *site)
+{
+    CTB_Context *context = get_context();
+    const int call_depth = context->call_depth;
+
+    if (call_depth < 0)
+    {
+        return call_depth;
+    }
+
+    const int frame_index = (call_depth < context->max_call_stack_depth)
+                                ? call_depth
+                                : context->max_call_stack_depth - 1;
+    if (context->num_frame_signatures > frame_index)
+    {
+        context->num_frame_signatures = frame_index;
+    }
+
+    CTB_Frame *frame = &context->call_stack_frames[frame_index];
+    *frame = *site;
+
+    ctb_signal_fence();
+    context->call_depth = call_depth + 1;
+
+    if (ctb_atomic_load_relaxed(&ctb_chrome_trace_enabled))
+    {
+        ctb_chrome_trace_begin_event(frame);
+    }
+    return call_depth;
+}
+
+/* FNV-1a, over the content of strings so that signatures are stable across
+   processes running the same build */
+#define CTB_SIGNATURE_OFFSET_BASIS 14695981039346656037ULL
+#define CTB_SIGNATURE_PRIME 1099511628211ULL
+
+static uint64_t hash_str(uint64_t hash, const char *str)
+{
+    if (str)
+    {
+        for (; *str; str++)
+        {
+            hash ^= (unsigned char)*str;
+            hash *= CTB_SIGNATURE_PRIME;
+        }
+    }
+    /* Separate consecutive strings */
+    hash ^= 0xFFu;
+    return hash * CTB_SIGNATURE_PRIME;
+}
+
+static uint64_t hash_int(uint64_t hash, const int n)
+{
+    const unsigned int u = (unsigned int)n;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        hash ^= (u >> shift) & 0xFFu;
+        hash *= CTB_SIGNATURE_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * \brief Feed the site identity of a frame into a signature.
+ */
+static uint64_t hash_frame(const uint64_t hash, const CTB_Frame *frame)
+{
+    return hash_int(
+        hash_str(hash_str(hash, frame->filename), frame->function_name),
+        frame->line_number
+    );
+}
+
+/**
+ * \brief Finish a signature with the call depth and the throw site.
+ */
+static uint64_t finish_signature(
+    const uint64_t hash, const int call_depth, const CTB_Frame *error_frame
+)
+{
+    return hash_frame(hash_int(hash, call_depth), error_frame);
+}
+
+uint64_t ctb_compute_stack_signature(
+    const CTB_Frame *frames,
+    const int num_frames,
+    const int call_depth,
+    const CTB_Frame *error_frame
+)
+{
+    uint64_t hash = CTB_SIGNATURE_OFFSET_BASIS;
+    for (int i = 0; i < num_frames; i++)
+    {
+        hash = hash_frame(hash, &frames[i]);
+    }
+    return finish_signature(hash, call_depth, error_frame);
+}
+
+uint64_t ctb_get_stack_signature(CTB_Context *context, const CTB_Frame *error_frame)
+{
+    const int call_depth = context->call_depth;
+    const int num_frames = (call_depth < context->max_call_stack_depth)
+                               ? call_depth
+                               : context->max_call_stack_depth;
+    uint64_t *signatures = context->frame_signatures;
+
+    int i = context->num_frame_signatures;
+    if (i >= num_frames)
+    {
+        i = num_frames;
+    }
+    uint64_t hash = (i > 0) ? signatures[i - 1] : CTB_SIGNATURE_OFFSET_BASIS;
+    if (i < num_frames)
+    {
+        for (; i < num_frames; i++)
+        {
+            hash = hash_frame(hash, &context->call_stack_frames[i]);
+            signatures[i] = hash;
+        }
+        context->num_frame_signatures = num_frames;
+    }
+
+    return finish_signature(hash, call_depth, error_frame);
+}
+
+void ctb_unwind_call_stack(const int call_depth)
+{
+    CTB_Context *context = peek_context();
+    while (context->call_depth > call_depth && context->call_depth > 0)
+    {
+        (context->call_depth)--;
+
+        if (ctb_atomic_load_relaxed(&ctb_chrome_trace_enabled))
+        {
+            ctb_chrome_trace_end_event();
+        }
+    }
 }
 
 void ctb_pop_call_stack_frame(void)
@@ -47,5 +337,10 @@ void ctb_pop_call_stack_frame(void)
     if (context->call_depth > 0)
     {
         (context->call_depth)--;
+
+        if (ctb_atomic_load_relaxed(&ctb_chrome_trace_enabled))
+        {
+            ctb_chrome_trace_end_event();
+        }
     }
 }
@@ -5,40 +5,26 @@
  * \author Ching-Yin Ng
  */
 
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "c_traceback.h"
+#include "internal/alloc.h"
+#include "internal/atomic.h"
+#include "internal/crash_log.h"
+#include "internal/format.h"
+#include "internal/sink.h"
+#include "internal/source_cache.h"
+#include "internal/theme.h"
 #include "internal/trace.h"
 #include "internal/traceback.h"
 #include "internal/utils.h"
 
-#if defined(_WIN32)
-#include <io.h>
-#define SAFE_WRITE(fd, buf, len) _write(fd, buf, len)
-#define STDERR_FD 2
-#else
-#include <unistd.h>
-#define SAFE_WRITE(fd, buf, len) write(fd, buf, len)
-#define STDERR_FD STDERR_FILENO
-#endif
-
-typedef struct
-{
-    const char *reset;
-    const char *bold;
-    const char *error;
-    const char *error_bold;
-    const char *tb_text;
-    const char *tb_counter;
-    const char *tb_file;
-    const char *tb_line;
-    const char *tb_func;
-    const char *tb_another_exception;
-    const char *theme_bold;
-    const char *theme;
-} Theme;
+/* Size of the buffer receiving the description of an errno value */
+#define ERRNO_DESCRIPTION_SIZE 128
 
 static const char *LOGO_LINES[] = {
     "    %%%%%%%%%%%%    ",
@@ -54,99 +40,248 @@ static const char *LOGO_LINES[] = {
     "    %%%%%%%%%%%%    "
 };
 
+/* Number of source lines shown around each frame, or CTB_SOURCE_CONTEXT_DISABLED */
+static int ctb_source_context = CTB_SOURCE_CONTEXT_DISABLED;
+
+void ctb_set_source_context(const int num_lines)
+{
+    const int clamped = (num_lines > CTB_MAX_SOURCE_CONTEXT_LINES)
+                            ? CTB_MAX_SOURCE_CONTEXT_LINES
+                            : num_lines;
+    ctb_atomic_store_relaxed(
+        &ctb_source_context, (clamped < 0) ? CTB_SOURCE_CONTEXT_DISABLED : clamped
+    );
+}
+
+int ctb_get_source_context(void)
+{
+    return ctb_atomic_load_relaxed(&ctb_source_context);
+}
+
 /**
- * \brief Populates the Theme struct based on color availability.
- *
- * \param[in] use_color Whether to use color in the output.
- * \return The populated Theme struct.
+ * \brief Count the decimal digits of a positive integer.
  */
-static Theme get_theme(bool use_color)
+static int count_digits(int n)
 {
-    if (!use_color)
+    int digits = 1;
+    for (; n >= 10; n /= 10)
     {
-        return (Theme){"", "", "", "", "", "", "", "", "", "", "", ""};
+        digits++;
     }
-
-    return (Theme
-    ){.reset = CTB_RESET_COLOR,
-      .bold = CTB_THEME_BOLD_COLOR,
-      .error = CTB_ERROR_COLOR,
-      .error_bold = CTB_ERROR_BOLD_COLOR,
-      .tb_text = CTB_TRACEBACK_TEXT_COLOR,
-      .tb_counter = CTB_TRACEBACK_COUNTER_COLOR,
-      .tb_file = CTB_TRACEBACK_FILE_COLOR,
-      .tb_line = CTB_TRACEBACK_LINE_COLOR,
-      .tb_func = CTB_TRACEBACK_FUNC_COLOR,
-      .tb_another_exception = CTB_TRACEBACK_ANOTHER_EXCEPTION_TEXT_COLOR,
-      .theme_bold = CTB_THEME_BOLD_COLOR,
-      .theme = CTB_THEME_COLOR};
+    return digits;
 }
 
 /**
- * \brief Returns the appropriate dash character (UTF-8 or ASCII).
+ * \brief Helper function to print the source lines around a frame.
  *
- * \param[in] stream The output stream.
- * \return The dash character as a string.
+ * \param[in,out] arena The formatting arena.
+ * \param[in] tpl The output template.
+ * \param[in] frame The frame.
+ * \param[in] num_context_lines The number of lines before and after the frame.
+ * \return false if the source line of the frame cannot be read.
  */
-static const char *get_dash(FILE *stream)
+static bool print_source_excerpt(
+    CTB_Format_Arena_ *arena,
+    const CTB_Theme_Template_ *tpl,
+    const CTB_Frame *frame,
+    const int num_context_lines
+)
 {
-    return should_use_utf8(stream) ? "\u2500" : "-";
+    const CTB_Source_File_ *file = ctb_source_cache_get(frame->filename);
+    const int line_number = frame->line_number;
+    size_t length;
+    if (!file || !ctb_source_file_get_line(file, line_number, &length))
+    {
+        return false;
+    }
+
+    const int num_lines = ctb_source_file_num_lines(file);
+    const int first =
+        (line_number > num_context_lines) ? line_number - num_context_lines : 1;
+    const int last = (line_number <= num_lines - num_context_lines)
+                         ? line_number + num_context_lines
+                         : num_lines;
+
+    const int width = count_digits(last);
+    ctb_template_append(arena, tpl, CTB_SPAN_EXCERPT);
+    for (int i = first; i <= last; i++)
+    {
+        const bool current = (i == line_number);
+        const char *text = ctb_source_file_get_line(file, i, &length);
+
+        ctb_template_append(
+            arena, tpl, current ? CTB_SPAN_EXCERPT_CURRENT : CTB_SPAN_EXCERPT_LINE
+        );
+        for (int pad = count_digits(i); pad < width; pad++)
+        {
+            CTB_FORMAT_APPEND_LITERAL(arena, " ");
+        }
+        ctb_format_append_int(arena, i, 0);
+        ctb_template_append(
+            arena, tpl, current ? CTB_SPAN_EXCERPT_CURRENT_TEXT : CTB_SPAN_EXCERPT_TEXT
+        );
+        if (length > CTB_MAX_SOURCE_LINE_LENGTH)
+        {
+            ctb_format_append(arena, text, CTB_MAX_SOURCE_LINE_LENGTH);
+            CTB_FORMAT_APPEND_LITERAL(arena, "...");
+        }
+        else
+        {
+            ctb_format_append(arena, text, length);
+        }
+        ctb_template_append(
+            arena, tpl, current ? CTB_SPAN_EXCERPT_CURRENT_END : CTB_SPAN_EXCERPT_END
+        );
+    }
+    return true;
 }
 
 /**
  * \brief Helper function to print a single frame.
  *
- * \param[in] stream The output stream.
+ * \param[in,out] arena The formatting arena.
+ * \param[in] tpl The output template.
  * \param[in] index The index of the frame in the call stack.
  * \param[in] frame The frame to print.
- * \param[in] use_color Whether to use color in the output.
  */
-static void
-print_frame(FILE *stream, int index, const CTB_Frame_ *frame, const Theme *theme)
+static void print_frame(
+    CTB_Format_Arena_ *arena,
+    const CTB_Theme_Template_ *tpl,
+    int index,
+    const CTB_Frame *frame
+)
 {
     const int dir_len = get_parent_path_length(frame->filename);
 
-    // clang-format off
-    fprintf(
-        stream,
-        "  %s(#%02d)%s %sFile \"%s",
-        theme->tb_counter, index, theme->reset,
-        theme->tb_text, theme->reset
-    );
-    // clang-format on
+    ctb_template_append(arena, tpl, CTB_SPAN_FRAME_INDEX);
+    ctb_format_append_int(arena, index, 2);
+    ctb_template_append(arena, tpl, CTB_SPAN_FRAME_FILE_PARENT);
+    ctb_format_append(arena, frame->filename, (size_t)dir_len);
+    ctb_template_append(arena, tpl, CTB_SPAN_FRAME_FILE);
+    ctb_format_append_str(arena, frame->filename + dir_len);
+    ctb_template_append(arena, tpl, CTB_SPAN_FRAME_LINE);
+    ctb_format_append_int(arena, frame->line_number, 0);
+    ctb_template_append(arena, tpl, CTB_SPAN_FRAME_FUNCTION);
+    ctb_format_append_str(arena, frame->function_name);
+
+    const int num_context_lines = ctb_get_source_context();
+    if (num_context_lines == CTB_SOURCE_CONTEXT_DISABLED ||
+        !print_source_excerpt(arena, tpl, frame, num_context_lines))
+    {
+        ctb_template_append(arena, tpl, CTB_SPAN_FRAME_SOURCE);
+        ctb_format_append_str(arena, frame->source_code);
+        ctb_template_append(arena, tpl, CTB_SPAN_FRAME_END);
+    }
+}
+
+/**
+ * \brief Helper function to print the header of a traceback.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in] tpl The output template.
+ * \param[in] index The index of the error, or -1 to omit it.
+ */
+static void print_traceback_header(
+    CTB_Format_Arena_ *arena, const CTB_Theme_Template_ *tpl, const int index
+)
+{
+    if (index >= 0)
+    {
+        ctb_template_append(arena, tpl, CTB_SPAN_ERROR_INDEX);
+        ctb_format_append_int(arena, index, 2);
+        ctb_template_append(arena, tpl, CTB_SPAN_ERROR_INDEX_END);
+    }
+
+    ctb_template_append(arena, tpl, CTB_SPAN_HEADER);
+    if (CTB_TRACEBACK_HEADER && CTB_TRACEBACK_HEADER[0])
+    {
+        ctb_format_append_str(arena, CTB_TRACEBACK_HEADER);
+    }
+    else
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, "Traceback");
+    }
+    ctb_template_append(arena, tpl, CTB_SPAN_HEADER_END);
+}
 
-    fprintf(stream, "%s%.*s%s", theme->tb_text, dir_len, frame->filename, theme->reset);
-    fprintf(stream, "%s%s%s", theme->tb_file, frame->filename + dir_len, theme->reset);
+/**
+ * \brief Helper function to print the number of skipped frames.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in] tpl The output template.
+ * \param[in] num_skipped The number of skipped frames.
+ */
+static void print_skipped_frames(
+    CTB_Format_Arena_ *arena, const CTB_Theme_Template_ *tpl, const int num_skipped
+)
+{
+    ctb_template_append(arena, tpl, CTB_SPAN_SKIPPED);
+    ctb_format_append_int(arena, num_skipped, 0);
+    ctb_template_append(arena, tpl, CTB_SPAN_SKIPPED_END);
+}
 
-    // clang-format off
-    fprintf(
-        stream,
-        "%s\", line%s %s%d%s %sin%s %s%s%s:\n    %s%s%s\n",
-        theme->tb_text, theme->reset,
-        theme->tb_line, frame->line_number, theme->reset,
-        theme->tb_text, theme->reset,
-        theme->tb_func, frame->function_name, theme->reset,
-        theme->error, frame->source_code, theme->reset
-    );
-    // clang-format on
+/**
+ * \brief Helper function to print the error line of a traceback.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in] tpl The output template.
+ * \param[in] error The error.
+ * \param[in] message The error message.
+ */
+static void print_error_message(
+    CTB_Format_Arena_ *arena,
+    const CTB_Theme_Template_ *tpl,
+    const CTB_Error error,
+    const char *message,
+    const int os_errno
+)
+{
+    ctb_template_append(arena, tpl, CTB_SPAN_ERROR_NAME);
+    ctb_format_append_str(arena, error_to_string(error));
+    if (message[0] || os_errno != 0)
+    {
+        ctb_template_append(arena, tpl, CTB_SPAN_ERROR_MESSAGE);
+        if (os_errno != 0)
+        {
+            char description[ERRNO_DESCRIPTION_SIZE];
+            CTB_FORMAT_APPEND_LITERAL(arena, "[Errno ");
+            ctb_format_append_int(arena, os_errno, 0);
+            CTB_FORMAT_APPEND_LITERAL(arena, "] ");
+            ctb_format_append_str(
+                arena, get_errno_description(os_errno, description, sizeof(description))
+            );
+            if (message[0])
+            {
+                CTB_FORMAT_APPEND_LITERAL(arena, ": ");
+            }
+        }
+        ctb_format_append_str(arena, message);
+        ctb_template_append(arena, tpl, CTB_SPAN_ERROR_MESSAGE_END);
+    }
+    else
+    {
+        ctb_template_append(arena, tpl, CTB_SPAN_ERROR_NAME_END);
+    }
 }
 
 /**
  * \brief Helper function to print a horizontal rule with optional headers.
  *
+ * \param[in,out] arena The formatting arena.
  * \param[in] stream The output stream.
- * \param[in] use_color Whether to use color in the output.
- * \param[in] color_code The color code to use for the horizontal rule.
+ * \param[in] tpl The output template.
+ * \param[in] color_span The span that starts the color of the rule.
  * \param[in] header The header text to display in the middle of the rule.
  */
 static void print_hrule_internal(
+    CTB_Format_Arena_ *arena,
     FILE *stream,
-    const bool use_color,
-    const char *restrict color_code,
+    const CTB_Theme_Template_ *tpl,
+    const CTB_Span_Id_ color_span,
     const char *restrict header
 )
 {
-    const int terminal_width = get_terminal_width(stream);
+    const int terminal_width = ctb_output_width(stream);
     const int max = CTB_HRULE_MAX_WIDTH;
     const int min = CTB_HRULE_MIN_WIDTH;
 
@@ -160,9 +295,7 @@ static void print_hrule_internal(
         hrule_width = max;
     }
 
-    const char *dash = get_dash(stream);
-    const char *reset = use_color ? CTB_RESET_COLOR : "";
-    const char *color = (use_color && color_code) ? color_code : "";
+    const bool use_utf8 = ctb_output_use_utf8(stream);
 
     int header_len = (header) ? (int)strlen(header) : 0;
     int left_width = hrule_width;
@@ -185,167 +318,435 @@ static void print_hrule_internal(
         }
     }
 
-    fprintf(stream, "%s", color);
-
-    for (int i = 0; i < left_width; i++)
-    {
-        fputs(dash, stream);
-    }
+    ctb_template_append(arena, tpl, color_span);
+    ctb_rule_append(arena, use_utf8, left_width);
 
     if (header_len > 0)
     {
-        fprintf(stream, " %s ", header);
+        CTB_FORMAT_APPEND_LITERAL(arena, " ");
+        ctb_format_append(arena, header, (size_t)header_len);
+        CTB_FORMAT_APPEND_LITERAL(arena, " ");
     }
 
-    for (int i = 0; i < right_width; i++)
-    {
-        fputs(dash, stream);
-    }
-    fprintf(stream, "%s\n", reset);
+    ctb_rule_append(arena, use_utf8, right_width);
+    ctb_template_append(arena, tpl, CTB_SPAN_RULE_END);
 }
 
 /**
  * \brief Print a horizontal rule without a header.
  *
+ * \param[in,out] arena The formatting arena.
  * \param[in] stream The output stream.
- * \param[in] use_color Whether to use color in the output.
- * \param[in] color_code The color code to use for the horizontal rule.
+ * \param[in] tpl The output template.
+ * \param[in] color_span The span that starts the color of the rule.
  */
-static void
-print_hrule(FILE *stream, const bool use_color, const char *restrict color_code)
+static void print_hrule(
+    CTB_Format_Arena_ *arena,
+    FILE *stream,
+    const CTB_Theme_Template_ *tpl,
+    const CTB_Span_Id_ color_span
+)
 {
-    print_hrule_internal(stream, use_color, color_code, NULL);
+    print_hrule_internal(arena, stream, tpl, color_span, NULL);
 }
 
 /**
  * \brief Print a horizontal rule with a header.
  *
+ * \param[in,out] arena The formatting arena.
  * \param[in] stream The output stream.
- * \param[in] use_color Whether to use color in the output.
- * \param[in] color_code The color code to use for the horizontal rule.
+ * \param[in] tpl The output template.
+ * \param[in] color_span The span that starts the color of the rule.
  * \param[in] header The header text to display in the middle of the rule.
  */
 static void print_hrule_with_header(
+    CTB_Format_Arena_ *arena,
     FILE *stream,
-    const bool use_color,
-    const char *restrict color_code,
+    const CTB_Theme_Template_ *tpl,
+    const CTB_Span_Id_ color_span,
     const char *restrict header
 )
 {
-    print_hrule_internal(stream, use_color, color_code, header);
+    print_hrule_internal(arena, stream, tpl, color_span, header);
 }
 
-void ctb_log_traceback(void)
+/**
+ * \brief Helper function to print a single frame as a JSON object.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in] frame The frame to print.
+ */
+static void print_frame_json(CTB_Format_Arena_ *arena, const CTB_Frame *frame)
 {
-    const CTB_Context *context = get_context();
-    FILE *const stream = stderr;
-    const bool use_color = should_use_color(stream);
-    const Theme theme = get_theme(use_color);
+    CTB_FORMAT_APPEND_LITERAL(arena, "{\"file\":");
+    ctb_format_append_json_string(arena, frame->filename);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"line\":");
+    ctb_format_append_int(arena, frame->line_number, 0);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"function\":");
+    ctb_format_append_json_string(arena, frame->function_name);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"source\":");
+    ctb_format_append_json_string(arena, frame->source_code);
+    CTB_FORMAT_APPEND_LITERAL(arena, "}");
+}
 
-    const char *header_text = (CTB_TRACEBACK_HEADER && CTB_TRACEBACK_HEADER[0])
-                                  ? CTB_TRACEBACK_HEADER
-                                  : "Traceback";
+/* Rendering mode of ctb_log_traceback, a CTB_Traceback_Mode */
+static int ctb_traceback_mode = CTB_TRACEBACK_FULL;
 
-    const int num_errors = context->num_errors;
-    const int num_errors_to_print =
-        (num_errors > CTB_MAX_NUM_ERROR) ? CTB_MAX_NUM_ERROR : num_errors;
+void ctb_set_traceback_mode(const CTB_Traceback_Mode mode)
+{
+    ctb_atomic_store_relaxed(&ctb_traceback_mode, (int)mode);
+}
 
-    print_hrule(stream, use_color, CTB_ERROR_COLOR);
+CTB_Traceback_Mode ctb_get_traceback_mode(void)
+{
+    return (CTB_Traceback_Mode)ctb_atomic_load_relaxed(&ctb_traceback_mode);
+}
 
-    if (num_errors_to_print <= 0)
+/**
+ * \brief Errors with the same code, throw site and call stack, printed once.
+ */
+typedef struct Traceback_Group
+{
+    const CTB_Error_Snapshot_ *first;
+    const CTB_Error_Snapshot_ *last;
+    int count;
+} Traceback_Group;
+
+/**
+ * \brief Append a signature as 16 hexadecimal digits, since JSON numbers cannot
+ * hold 64-bit integers exactly.
+ */
+static void append_signature(CTB_Format_Arena_ *arena, const uint64_t signature)
+{
+    static const char digits[] = "0123456789abcdef";
+    char hex[16];
+    for (int i = 0; i < 16; i++)
     {
-        fputs("There is no recorded error!\n", stream);
-        print_hrule(stream, use_color, CTB_ERROR_COLOR);
-        fflush(stream);
-        return;
+        hex[i] = digits[(signature >> (60 - 4 * i)) & 0xFu];
     }
+    ctb_format_append(arena, hex, sizeof(hex));
+}
 
-    for (int e = 0; e < num_errors_to_print; e++)
+/**
+ * \brief Group the stored errors of a context by error code and stack signature
+ * in the order of their first occurrence, using an open-addressing hash table.
+ *
+ * \param[in] context The context.
+ * \param[in] num_errors The number of stored errors.
+ * \param[out] num_groups The number of groups.
+ * \return The groups to free with ctb_free, or NULL if the allocation failed.
+ */
+static Traceback_Group *
+group_tracebacks(const CTB_Context *context, const int num_errors, int *num_groups)
+{
+    size_t capacity = 16;
+    while (capacity < 2 * (size_t)num_errors)
     {
-        const CTB_Error_Snapshot_ *snapshot = &context->error_snapshots[e];
-        const int num_frames = snapshot->call_depth;
-        const bool stack_frames_exceed_max = (num_frames > CTB_MAX_CALL_STACK_DEPTH);
-        const int num_frames_to_print =
-            stack_frames_exceed_max ? CTB_MAX_CALL_STACK_DEPTH : num_frames;
+        capacity *= 2;
+    }
 
-        /* Print Header */
-        if (num_errors > 1)
+    /* Slots hold a group index plus one, 0 is empty */
+    Traceback_Group *groups = ctb_malloc(
+        sizeof(Traceback_Group) * (size_t)num_errors + sizeof(int) * capacity
+    );
+    if (!groups)
+    {
+        return NULL;
+    }
+    int *slots = (int *)(groups + num_errors);
+    memset(slots, 0, sizeof(int) * capacity);
+
+    *num_groups = 0;
+    for (int e = 0; e < num_errors; e++)
+    {
+        const CTB_Error_Snapshot_ *snapshot = ctb_get_error_snapshot(context, e);
+        const uint64_t hash =
+            snapshot->signature ^ ((uint64_t)(unsigned int)snapshot->error << 32);
+
+        size_t slot = (size_t)(hash ^ (hash >> 32)) & (capacity - 1);
+        while (slots[slot] &&
+               (groups[slots[slot] - 1].first->signature != snapshot->signature ||
+                groups[slots[slot] - 1].first->error != snapshot->error))
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        if (slots[slot])
+        {
+            Traceback_Group *group = &groups[slots[slot] - 1];
+            group->last = snapshot;
+            group->count += snapshot->count;
+        }
+        else
         {
-            fprintf(stream, "%s(#%02d)%s ", theme.error, e, theme.reset);
+            Traceback_Group *group = &groups[*num_groups];
+            group->first = snapshot;
+            group->last = snapshot;
+            group->count = snapshot->count;
+            slots[slot] = ++(*num_groups);
         }
+    }
+
+    return groups;
+}
+
+/**
+ * \brief Check whether the last message of a group differs from its first one.
+ */
+static bool has_last_message(const Traceback_Group *group)
+{
+    return group->last != group->first &&
+           strcmp(group->last->error_message, group->first->error_message) != 0;
+}
 
-        fprintf(
-            stream,
-            "%s%s%s %s(most recent call last):%s\n",
-            theme.error_bold,
-            header_text,
-            theme.reset,
-            theme.error,
-            theme.reset
+/**
+ * \brief Print one error in the JSON Lines format.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in] index The index of the error.
+ * \param[in] group The error, with its last message and its count.
+ * \param[in] max_depth The maximum call stack depth.
+ */
+static void print_traceback_json(
+    CTB_Format_Arena_ *arena,
+    const int index,
+    const Traceback_Group *group,
+    const int max_depth
+)
+{
+    const CTB_Error_Snapshot_ *snapshot = group->first;
+    const int num_frames = snapshot->call_depth;
+    const int num_frames_to_print = (num_frames > max_depth) ? max_depth : num_frames;
+
+    CTB_FORMAT_APPEND_LITERAL(arena, "{\"type\":\"traceback\",\"index\":");
+    ctb_format_append_int(arena, index, 0);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"name\":");
+    ctb_format_append_json_string(arena, error_to_string(snapshot->error));
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"code\":");
+    ctb_format_append_int(arena, snapshot->error, 0);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"severity\":\"");
+    ctb_format_append_str(
+        arena, severity_to_string(ctb_get_error_severity(snapshot->error))
+    );
+    CTB_FORMAT_APPEND_LITERAL(arena, "\",\"message\":");
+    ctb_format_append_json_string(arena, snapshot->error_message);
+    if (snapshot->os_errno != 0)
+    {
+        char description[ERRNO_DESCRIPTION_SIZE];
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"errno\":");
+        ctb_format_append_int(arena, snapshot->os_errno, 0);
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"strerror\":");
+        ctb_format_append_json_string(
+            arena,
+            get_errno_description(snapshot->os_errno, description, sizeof(description))
         );
+    }
+    if (has_last_message(group))
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, ",\"last_message\":");
+        ctb_format_append_json_string(arena, group->last->error_message);
+    }
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"count\":");
+    ctb_format_append_int(arena, group->count, 0);
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"signature\":\"");
+    append_signature(arena, snapshot->signature);
+    CTB_FORMAT_APPEND_LITERAL(arena, "\"");
+
+    CTB_FORMAT_APPEND_LITERAL(arena, ",\"frames\":[");
+    for (int i = 0; i < num_frames_to_print; i++)
+    {
+        print_frame_json(arena, &snapshot->call_stack_frames[i]);
+        CTB_FORMAT_APPEND_LITERAL(arena, ",");
+    }
+    print_frame_json(arena, &snapshot->error_frame);
 
-        /* Print Stack Frames */
-        for (int i = 0; i < num_frames_to_print; i++)
+    CTB_FORMAT_APPEND_LITERAL(arena, "],\"skipped_frames\":");
+    ctb_format_append_int(arena, num_frames - num_frames_to_print, 0);
+    CTB_FORMAT_APPEND_LITERAL(arena, "}\n");
+}
+
+/**
+ * \brief Print the recorded errors in the JSON Lines format, one error per line.
+ *
+ * \param[in] context The context.
+ * \param[in] stream The output stream.
+ * \param[in] groups The grouped errors, or NULL to print every error.
+ * \param[in] num_groups The number of groups.
+ */
+static void log_traceback_json(
+    const CTB_Context *context,
+    FILE *stream,
+    const Traceback_Group *groups,
+    const int num_groups
+)
+{
+    const int max_num_errors = context->max_num_errors;
+    const int max_depth = context->max_call_stack_depth;
+    const int num_errors = context->num_errors;
+    CTB_Format_Arena_ *arena = ctb_format_arena_begin();
+
+    if (groups)
+    {
+        for (int g = 0; g < num_groups; g++)
         {
-            print_frame(stream, i, &snapshot->call_stack_frames[i], &theme);
+            print_traceback_json(arena, g, &groups[g], max_depth);
         }
-
-        if (stack_frames_exceed_max)
+    }
+    else
+    {
+        const int num_errors_to_print = ctb_get_num_stored_errors(context);
+        for (int e = 0; e < num_errors_to_print; e++)
         {
-            fprintf(
-                stream,
-                "\n      %s[... Skipped %d frames ...]%s\n\n",
-                theme.tb_text,
-                num_frames - CTB_MAX_CALL_STACK_DEPTH,
-                theme.reset
-            );
+            const CTB_Error_Snapshot_ *snapshot = ctb_get_error_snapshot(context, e);
+            const Traceback_Group group = {snapshot, snapshot, snapshot->count};
+            print_traceback_json(arena, e, &group, max_depth);
         }
+    }
+
+    if (num_errors > max_num_errors)
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, "{\"type\":\"truncated\",\"num_errors\":");
+        ctb_format_append_int(arena, num_errors - max_num_errors, 0);
+        CTB_FORMAT_APPEND_LITERAL(arena, "}\n");
+    }
+
+    ctb_output_write(arena, stream);
+}
+
+/**
+ * \brief Print the traceback of one error.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in] tpl The output template.
+ * \param[in] index The index of the error, or -1 to omit it.
+ * \param[in] group The error, with its last message and its count.
+ * \param[in] max_depth The maximum call stack depth.
+ */
+static void print_traceback(
+    CTB_Format_Arena_ *arena,
+    const CTB_Theme_Template_ *tpl,
+    const int index,
+    const Traceback_Group *group,
+    const int max_depth
+)
+{
+    const CTB_Error_Snapshot_ *snapshot = group->first;
+    const int num_frames = snapshot->call_depth;
+    const bool stack_frames_exceed_max = (num_frames > max_depth);
+    const int num_frames_to_print = stack_frames_exceed_max ? max_depth : num_frames;
+
+    /* Print Header */
+    print_traceback_header(arena, tpl, index);
+
+    /* Print Stack Frames */
+    for (int i = 0; i < num_frames_to_print; i++)
+    {
+        print_frame(arena, tpl, i, &snapshot->call_stack_frames[i]);
+    }
+
+    if (stack_frames_exceed_max)
+    {
+        print_skipped_frames(arena, tpl, num_frames - max_depth);
+    }
+
+    print_frame(arena, tpl, num_frames, &snapshot->error_frame);
+    print_error_message(
+        arena, tpl, snapshot->error, snapshot->error_message, snapshot->os_errno
+    );
+    if (group->count > 1)
+    {
+        ctb_template_append(arena, tpl, CTB_SPAN_REPEATED);
+        ctb_format_append_int(arena, group->count, 0);
+        ctb_template_append(arena, tpl, CTB_SPAN_REPEATED_END);
+    }
+    if (has_last_message(group))
+    {
+        ctb_template_append(arena, tpl, CTB_SPAN_LAST_MESSAGE);
+        ctb_format_append_str(arena, group->last->error_message);
+        ctb_template_append(arena, tpl, CTB_SPAN_LAST_MESSAGE_END);
+    }
+}
+
+void ctb_log_traceback(void)
+{
+    const CTB_Context *context = get_context();
+    const int max_num_errors = context->max_num_errors;
+    const int max_depth = context->max_call_stack_depth;
+    FILE *const stream = stderr;
+
+    const int num_errors = context->num_errors;
+    const int num_errors_to_print = ctb_get_num_stored_errors(context);
+
+    /* Fall back to printing every error if the groups cannot be allocated */
+    int num_groups = 0;
+    Traceback_Group *groups =
+        (ctb_get_traceback_mode() == CTB_TRACEBACK_GROUPED && num_errors_to_print > 1)
+            ? group_tracebacks(context, num_errors_to_print, &num_groups)
+            : NULL;
+
+    if (ctb_get_output_format(stream) == CTB_OUTPUT_JSON_LINES)
+    {
+        log_traceback_json(context, stream, groups, num_groups);
+        ctb_free(groups);
+        return;
+    }
+
+    const CTB_Theme_Template_ *tpl = ctb_get_theme_template(ctb_output_use_color(stream));
+    CTB_Format_Arena_ *arena = ctb_format_arena_begin();
+
+    print_hrule(arena, stream, tpl, CTB_SPAN_ERROR_RULE);
+
+    if (num_errors_to_print <= 0)
+    {
+        CTB_FORMAT_APPEND_LITERAL(arena, "There is no recorded error!\n");
+        print_hrule(arena, stream, tpl, CTB_SPAN_ERROR_RULE);
+        ctb_output_write(arena, stream);
+        return;
+    }
 
-        print_frame(stream, num_frames, &snapshot->error_frame, &theme);
+    /* A ring has dropped the oldest errors, so say so before the kept ones */
+    const bool truncated = (num_errors > max_num_errors);
+    const bool truncated_first =
+        truncated && (ctb_config.retention_policy == CTB_RETAIN_LAST);
+    if (truncated_first)
+    {
+        ctb_template_append(arena, tpl, CTB_SPAN_TRUNCATED);
+        ctb_format_append_int(arena, num_errors - max_num_errors, 0);
+        ctb_template_append(arena, tpl, CTB_SPAN_TRUNCATED_END);
+        CTB_FORMAT_APPEND_LITERAL(arena, "\n");
+    }
 
-        fprintf(stream, "%s%s", theme.error_bold, error_to_string(snapshot->error));
-        if (snapshot->error_message[0])
+    const int num_tracebacks = groups ? num_groups : num_errors_to_print;
+    for (int e = 0; e < num_tracebacks; e++)
+    {
+        if (groups)
         {
-            fprintf(
-                stream,
-                ":%s %s%s%s",
-                theme.reset,
-                theme.error,
-                snapshot->error_message,
-                theme.reset
-            );
+            const int index = (num_groups > 1) ? e : -1;
+            print_traceback(arena, tpl, index, &groups[e], max_depth);
         }
         else
         {
-            fputs(theme.reset, stream);
+            const CTB_Error_Snapshot_ *snapshot = ctb_get_error_snapshot(context, e);
+            const Traceback_Group group = {snapshot, snapshot, snapshot->count};
+            print_traceback(arena, tpl, (num_errors > 1) ? e : -1, &group, max_depth);
         }
-        fputs("\n", stream);
 
-        if (e < (num_errors_to_print - 1))
+        if (e < (num_tracebacks - 1))
         {
-            fprintf(
-                stream,
-                "\n%sDuring handling of the above exception, another exception "
-                "occurred:%s\n\n",
-                theme.tb_another_exception,
-                theme.reset
-            );
+            ctb_template_append(arena, tpl, CTB_SPAN_ANOTHER_EXCEPTION);
         }
     }
+    ctb_free(groups);
 
-    if (num_errors > CTB_MAX_NUM_ERROR)
+    if (truncated && !truncated_first)
     {
-        fprintf(
-            stream,
-            "\n%s[... Truncated %d errors ...]%s\n",
-            theme.error_bold,
-            num_errors - CTB_MAX_NUM_ERROR,
-            theme.reset
-        );
+        ctb_template_append(arena, tpl, CTB_SPAN_TRUNCATED);
+        ctb_format_append_int(arena, num_errors - max_num_errors, 0);
+        ctb_template_append(arena, tpl, CTB_SPAN_TRUNCATED_END);
     }
 
-    print_hrule(stream, use_color, CTB_ERROR_COLOR);
-    fflush(stream);
+    print_hrule(arena, stream, tpl, CTB_SPAN_ERROR_RULE);
+    ctb_output_write(arena, stream);
 }
 
 void ctb_dump_traceback(void)
@@ -357,66 +758,89 @@ void ctb_dump_traceback(void)
 /**
  * \brief Helper function to print the left column of the compilation info.
  *
- * \param[in] stream The output stream.
- * \param[in] theme The theme to use for coloring.
+ * \param[in,out] arena The formatting arena.
+ * \param[in] tpl The output template.
  * \param[in] row_idx The current row index.
  * \param[in] label The label text.
- * \param[in] value The value text.
+ * \param[in] value_fmt The format string of the value text, or NULL.
+ * \param[in] ... Additional arguments for formatting the value.
  */
 static void print_compilation_info_row(
-    FILE *stream,
-    const Theme *theme,
+    CTB_Format_Arena_ *arena,
+    const CTB_Theme_Template_ *tpl,
     const int row_idx,
     const char *restrict label,
-    const char *restrict value
+    const char *restrict value_fmt,
+    ...
 )
 {
     const int logo_height = sizeof(LOGO_LINES) / sizeof(LOGO_LINES[0]);
     const int left_padding = 2;
     const int gutter = 4;
     const int logo_width = strlen(LOGO_LINES[0]);
-
     if (row_idx < logo_height)
     {
-        fprintf(
-            stream,
-            "%*s%s%s%s%*s",
-            left_padding,
-            "",
-            theme->theme_bold,
-            LOGO_LINES[row_idx],
-            theme->reset,
-            gutter,
-            ""
-        );
+        ctb_format_appendf(arena, "%*s", left_padding, "");
+        ctb_template_append(arena, tpl, CTB_SPAN_ACCENT);
+        ctb_format_append_str(arena, LOGO_LINES[row_idx]);
+        ctb_template_append(arena, tpl, CTB_SPAN_ACCENT_END);
+        ctb_format_appendf(arena, "%*s", gutter, "");
     }
     else
     {
-        fprintf(stream, "%*s", left_padding + logo_width + gutter, "");
+        ctb_format_appendf(arena, "%*s", left_padding + logo_width + gutter, "");
     }
 
     if (label)
     {
-        if (value)
-        {
-            fprintf(stream, "%s%s%s%s", theme->theme_bold, label, theme->reset, value);
-        }
-        else
+        ctb_template_append(arena, tpl, CTB_SPAN_ACCENT);
+        ctb_format_append_str(arena, label);
+        ctb_template_append(arena, tpl, CTB_SPAN_ACCENT_END);
+        if (value_fmt)
         {
-            fprintf(stream, "%s%s%s", theme->theme_bold, label, theme->reset);
+            va_list args;
+            va_start(args, value_fmt);
+            ctb_format_vappendf(arena, value_fmt, args);
+            va_end(args);
         }
     }
 
-    fputs("\n", stream);
+    CTB_FORMAT_APPEND_LITERAL(arena, "\n");
+}
+
+/**
+ * \brief Helper function to print an underlined section title.
+ *
+ * \param[in,out] arena The formatting arena.
+ * \param[in] tpl The output template.
+ * \param[in] use_utf8 Whether to use UTF-8 in the output.
+ * \param[in] title The title.
+ */
+static void print_section_title(
+    CTB_Format_Arena_ *arena,
+    const CTB_Theme_Template_ *tpl,
+    const bool use_utf8,
+    const char *restrict title
+)
+{
+    const size_t title_len = strlen(title);
+
+    CTB_FORMAT_APPEND_LITERAL(arena, "\n");
+    ctb_template_append(arena, tpl, CTB_SPAN_ACCENT);
+    ctb_format_append(arena, title, title_len);
+    ctb_template_append(arena, tpl, CTB_SPAN_ACCENT_END);
+    CTB_FORMAT_APPEND_LITERAL(arena, "\n");
+    ctb_rule_append(arena, use_utf8, (int)title_len);
+    CTB_FORMAT_APPEND_LITERAL(arena, "\n");
 }
 
 void ctb_print_compilation_info(void)
 {
     FILE *const stream = stdout;
-    const bool use_color = should_use_color(stream);
-    const Theme theme = get_theme(use_color);
-    const char *dash = get_dash(stream);
+    const CTB_Theme_Template_ *tpl = ctb_get_theme_template(ctb_output_use_color(stream));
+    const bool use_utf8 = ctb_output_use_utf8(stream);
     const int logo_height = sizeof(LOGO_LINES) / sizeof(LOGO_LINES[0]);
+    CTB_Format_Arena_ *arena = ctb_format_arena_begin();
 
     /* Determine OS String */
     const char *os_str = "Unknown";
@@ -429,257 +853,292 @@ void ctb_print_compilation_info(void)
 #endif
 
     /* Determine Compiler String */
-    char compiler_str[64];
 #ifdef _MSC_VER
-    snprintf(compiler_str, sizeof(compiler_str), "MSVC (version: %d)", _MSC_VER);
+    const char *compiler_fmt = "MSVC (version: %d)";
+    const int compiler_version = _MSC_VER;
 #elif defined(__clang__)
-    snprintf(
-        compiler_str, sizeof(compiler_str), "Clang (version: %d)", __clang_major__
-    );
+    const char *compiler_fmt = "Clang (version: %d)";
+    const int compiler_version = __clang_major__;
 #elif defined(__GNUC__)
-    snprintf(compiler_str, sizeof(compiler_str), "GCC (version: %d)", __GNUC__);
+    const char *compiler_fmt = "GCC (version: %d)";
+    const int compiler_version = __GNUC__;
 #else
-    snprintf(compiler_str, sizeof(compiler_str), "Unknown");
+    const char *compiler_fmt = "Unknown";
+    const int compiler_version = 0;
 #endif
 
     /* Print Header */
     print_hrule_with_header(
-        stream, use_color, CTB_THEME_COLOR, "C Traceback Compilation Info"
+        arena, stream, tpl, CTB_SPAN_ACCENT_RULE, "C Traceback Compilation Info"
     );
 
-    /* Prepare Config Values for printing */
-    char buf_ver[128];
-    char buf_date[128];
-    char buf_stack[128];
-    char buf_msg[128];
-    char buf_err[128];
-    char buf_term[128];
-    char buf_file[128];
-    char buf_hmax[128];
-    char buf_hmin[128];
-
-    snprintf(buf_ver, sizeof(buf_ver), "%s", CTB_VERSION);
-    snprintf(buf_date, sizeof(buf_date), "%s %s", __DATE__, __TIME__);
-    snprintf(buf_stack, sizeof(buf_stack), "%d", CTB_MAX_CALL_STACK_DEPTH);
-    snprintf(buf_msg, sizeof(buf_msg), "%d", CTB_MAX_ERROR_MESSAGE_LENGTH);
-    snprintf(buf_err, sizeof(buf_err), "%d", CTB_MAX_NUM_ERROR);
-    snprintf(buf_term, sizeof(buf_term), "%d", CTB_DEFAULT_TERMINAL_WIDTH);
-    snprintf(buf_file, sizeof(buf_file), "%d", CTB_DEFAULT_FILE_WIDTH);
-    snprintf(buf_hmax, sizeof(buf_hmax), "%d", CTB_HRULE_MAX_WIDTH);
-    snprintf(buf_hmin, sizeof(buf_hmin), "%d", CTB_HRULE_MIN_WIDTH);
-
     /* Construct Horizontal Line */
-    char separator_line[64] = {0};
-    for (int i = 0; i < 6; i++)
-    {
-        strcat(separator_line, dash);
-    }
+    char separator_line[64];
+    size_t separator_len;
+    const char *dashes = ctb_get_rule_dashes(use_utf8, 6, &separator_len);
+    memcpy(separator_line, dashes, separator_len);
+    separator_line[separator_len] = '\0';
 
     /* Print Info Rows Linearly */
+    const CTB_Config *config = ctb_get_config();
+    const CTB_Theme_Template_ *t = tpl;
     int row = 0;
-    print_compilation_info_row(stream, &theme, row++, "C Traceback Version: ", buf_ver);
-    print_compilation_info_row(stream, &theme, row++, "Operating System: ", os_str);
-    print_compilation_info_row(stream, &theme, row++, "Build Date: ", buf_date);
-    print_compilation_info_row(stream, &theme, row++, "Compiler: ", compiler_str);
-    print_compilation_info_row(stream, &theme, row++, "", NULL); /* Empty Row */
-    print_compilation_info_row(stream, &theme, row++, "Config", NULL);
-    print_compilation_info_row(stream, &theme, row++, separator_line, NULL);
+    // clang-format off
+    print_compilation_info_row(
+        arena, t, row++, "C Traceback Version: ", "%s", CTB_VERSION
+    );
+    print_compilation_info_row(arena, t, row++, "Operating System: ", "%s", os_str);
+    print_compilation_info_row(
+        arena, t, row++, "Build Date: ", "%s %s", __DATE__, __TIME__
+    );
+    print_compilation_info_row(
+        arena, t, row++, "Compiler: ", compiler_fmt, compiler_version
+    );
+    print_compilation_info_row(arena, t, row++, "", NULL); /* Empty Row */
+    print_compilation_info_row(arena, t, row++, "Config", NULL);
+    print_compilation_info_row(arena, t, row++, separator_line, NULL);
+    print_compilation_info_row(
+        arena, t, row++, "Max Call Stack Depth: ", "%d", config->max_call_stack_depth
+    );
     print_compilation_info_row(
-        stream, &theme, row++, "Max Call Stack Depth: ", buf_stack
+        arena, t, row++, "Max Error Message Length: ", "%d",
+        config->max_error_message_length
     );
     print_compilation_info_row(
-        stream, &theme, row++, "Max Error Message Length: ", buf_msg
+        arena, t, row++, "Max Number of Errors: ", "%d", config->max_num_errors
     );
     print_compilation_info_row(
-        stream, &theme, row++, "Max Number of Errors: ", buf_err
+        arena, t, row++, "Error Retention: ", "%s",
+        (config->retention_policy == CTB_RETAIN_LAST)     ? "Last"
+        : (config->retention_policy == CTB_RETAIN_SAMPLE) ? "Sample"
+                                                          : "First"
     );
     print_compilation_info_row(
-        stream, &theme, row++, "Default Terminal Width: ", buf_term
+        arena, t, row++, "Default Terminal Width: ", "%d", CTB_DEFAULT_TERMINAL_WIDTH
     );
-    print_compilation_info_row(stream, &theme, row++, "Default File Width: ", buf_file);
     print_compilation_info_row(
-        stream, &theme, row++, "Horizontal Rule Max Width: ", buf_hmax
+        arena, t, row++, "Default File Width: ", "%d", CTB_DEFAULT_FILE_WIDTH
     );
     print_compilation_info_row(
-        stream, &theme, row++, "Horizontal Rule Min Width: ", buf_hmin
+        arena, t, row++, "Horizontal Rule Max Width: ", "%d", CTB_HRULE_MAX_WIDTH
     );
+    print_compilation_info_row(
+        arena, t, row++, "Horizontal Rule Min Width: ", "%d", CTB_HRULE_MIN_WIDTH
+    );
+    // clang-format on
 
     /* Fill remaining logo space */
     while (row < logo_height)
     {
-        print_compilation_info_row(stream, &theme, row, NULL, NULL);
+        print_compilation_info_row(arena, t, row, NULL, NULL);
         row++;
     }
 
     /* Sample inline logging */
-    fputs("\n", stream);
-    fprintf(stream, "%sInline logging (example)%s\n", theme.theme_bold, theme.reset);
-    for (int d = 0; d < 24; d++)
-    {
-        fputs(dash, stream);
-    }
-    fputs("\n", stream);
-    fflush(stream);
+    print_section_title(arena, tpl, use_utf8, "Inline logging (example)");
+    ctb_output_write(arena, stream);
     LOG_ERROR_INLINE(CTB_ERROR, "Sample error for compilation info");
     LOG_WARNING_INLINE(CTB_USER_WARNING, "Sample warning for compilation info");
     LOG_MESSAGE_INLINE("Sample info for compilation info");
 
+    /* The inline loggers reuse the arena of this thread */
+    arena = ctb_format_arena_begin();
+
     /* Sample Traceback */
     const int num_examples = 3;
-    const CTB_Frame_ example_frames[3] = {
+    const CTB_Frame example_frames[3] = {
         {10, "example/example.c", "main", "hello_world();"},
         {25, "example/hello_world.c", "check_terminal", "data = compute(data)"},
         {50, "example/libs/utils.c", "compute", "recursion()"}
     };
 
-    const CTB_Frame_ error_frame = {
+    const CTB_Frame error_frame = {
         75, "example/libs/utils.c", "recursion", "<error thrown here>"
     };
 
-    fputs("\n", stream);
-    fprintf(stream, "%sTraceback (example)%s\n", theme.theme_bold, theme.reset);
-    for (int d = 0; d < 19; d++)
-    {
-        fputs(dash, stream);
-    }
-    fputs("\n", stream);
-    fflush(stream);
+    print_section_title(arena, tpl, use_utf8, "Traceback (example)");
+    ctb_output_write(arena, stream);
 
-    const char *header_text = (CTB_TRACEBACK_HEADER && CTB_TRACEBACK_HEADER[0])
-                                  ? CTB_TRACEBACK_HEADER
-                                  : "Traceback";
-    fprintf(
-        stream,
-        "%s%s%s %s(most recent call last):%s\n",
-        theme.error_bold,
-        header_text,
-        theme.reset,
-        theme.error,
-        theme.reset
-    );
+    print_traceback_header(arena, tpl, -1);
 
     for (int i = 0; i < num_examples; i++)
     {
-        print_frame(stream, i, &example_frames[i], &theme);
+        print_frame(arena, tpl, i, &example_frames[i]);
     }
 
-    fprintf(
-        stream,
-        "\n      %s[... Skipped %d frames ...]%s\n\n",
-        theme.tb_text,
-        123,
-        theme.reset
-    );
+    print_skipped_frames(arena, tpl, 123);
+    print_frame(arena, tpl, 127, &error_frame);
+    print_error_message(arena, tpl, CTB_ERROR, "Something went wrong!", 0);
 
-    print_frame(stream, 127, &error_frame, &theme);
-    fprintf(
-        stream,
-        "%s%s:%s %s%s%s\n",
-        theme.error_bold,
-        error_to_string(CTB_ERROR),
-        theme.reset,
-        theme.error,
-        "Something went wrong!",
-        theme.reset
-    );
-
-    print_hrule_with_header(stream, use_color, CTB_THEME_COLOR, "END");
-    fflush(stream);
+    print_hrule_with_header(arena, stream, tpl, CTB_SPAN_ACCENT_RULE, "END");
+    ctb_output_write(arena, stream);
 }
 
+/* Output buffer of the signal renderer, written out whenever it fills up */
+typedef struct
+{
+    char data[2048];
+    size_t length;
+} Safe_Buffer;
+
 /**
- * \brief Async-signal-safe string writer.
+ * \brief Async-signal-safe flush of the output buffer to the sink or stderr.
  */
-static void safe_print_str(const char *string)
+static void safe_flush(Safe_Buffer *out)
 {
-    if (!string)
-    {
-        return;
-    }
-    size_t len = 0;
-    while (string[len])
+    if (out->length > 0)
     {
-        len++;
+        ctb_output_write_signal(out->data, out->length);
+        out->length = 0;
     }
-    SAFE_WRITE(STDERR_FD, string, (unsigned int)len);
 }
 
 /**
- * \brief Async-signal-safe integer writer (converts int to string).
+ * \brief Async-signal-safe flush of the complete lines of a full output buffer, so
+ * that every write to a sink carries whole lines. The buffer is flushed whole if a
+ * single line fills it.
  */
-static void safe_print_int(const int n)
+static void safe_flush_lines(Safe_Buffer *out)
 {
-    char buffer[64];
-    int i = 0;
-    int is_neg = 0;
-    long long x = n;
-
-    if (x == 0)
+    size_t end = out->length;
+    while (end > 0 && out->data[end - 1] != '\n')
     {
-        safe_print_str("0");
-        return;
+        end--;
     }
-
-    if (x < 0)
+    if (end == 0)
     {
-        is_neg = 1;
-        x = -x;
+        safe_flush(out);
+        return;
     }
 
-    while (x > 0)
-    {
-        buffer[i++] = (x % 10) + '0';
-        x /= 10;
-    }
+    ctb_output_write_signal(out->data, end);
+    memmove(out->data, out->data + end, out->length - end);
+    out->length -= end;
+}
 
-    if (is_neg)
+/**
+ * \brief Async-signal-safe writer of a string of known length.
+ */
+static void safe_print(Safe_Buffer *out, const char *string, size_t length)
+{
+    while (length > 0)
     {
-        buffer[i++] = '-';
+        if (out->length == sizeof(out->data))
+        {
+            safe_flush_lines(out);
+        }
+
+        const size_t space = sizeof(out->data) - out->length;
+        const size_t n = (length < space) ? length : space;
+        memcpy(out->data + out->length, string, n);
+        out->length += n;
+        string += n;
+        length -= n;
     }
+}
 
-    // Reverse buffer to print
-    for (int j = 0; j < i / 2; j++)
+/**
+ * \brief Async-signal-safe writer of a string literal.
+ */
+#define SAFE_PRINT_LITERAL(out, literal) safe_print(out, literal, sizeof(literal) - 1)
+
+/**
+ * \brief Async-signal-safe string writer.
+ */
+static void safe_print_str(Safe_Buffer *out, const char *string)
+{
+    if (!string)
     {
-        char temp = buffer[j];
-        buffer[j] = buffer[i - j - 1];
-        buffer[i - j - 1] = temp;
+        return;
     }
-    buffer[i] = '\0';
+    safe_print(out, string, strlen(string));
+}
 
-    SAFE_WRITE(STDERR_FD, buffer, (unsigned int)i);
+/**
+ * \brief Async-signal-safe integer writer, zero-padded to a minimum width.
+ */
+static void safe_print_int(Safe_Buffer *out, const int n, const int min_width)
+{
+    char buffer[CTB_FORMAT_INT_SIZE + 1];
+    safe_print(out, buffer, ctb_format_int(buffer, n, min_width));
 }
 
 /**
  * \brief Async-signal-safe helper function to print a single frame.
  *
+ * \param[in,out] out The output buffer.
  * \param[in] index The index of the frame in the call stack.
  * \param[in] frame The frame to print.
  */
-static void safe_print_frame(int index, const CTB_Frame_ *frame)
+static void safe_print_frame(Safe_Buffer *out, int index, const CTB_Frame *frame)
+{
+    SAFE_PRINT_LITERAL(out, "  (#");
+    safe_print_int(out, index, 2);
+    SAFE_PRINT_LITERAL(out, ") File \"");
+    safe_print_str(out, frame->filename);
+    SAFE_PRINT_LITERAL(out, "\", line ");
+    safe_print_int(out, frame->line_number, 0);
+    SAFE_PRINT_LITERAL(out, " in ");
+    safe_print_str(out, frame->function_name);
+    SAFE_PRINT_LITERAL(out, ":\n    ");
+    safe_print_str(out, frame->source_code);
+    SAFE_PRINT_LITERAL(out, "\n");
+}
+
+/**
+ * \brief Append a fatal signal to the crash log, located at the innermost frame.
+ *
+ * \param[in] ctb_error The error corresponding to the signal.
+ * \param[in] context The context of the thread, or NULL.
+ */
+static void record_signal(const CTB_Error ctb_error, const CTB_Context *context)
 {
-    safe_print_str("  (#");
-    if (index < 10)
+    const CTB_Frame *frame = NULL;
+    if (context)
     {
-        safe_print_str("0");
+        const int depth = (context->call_depth < context->max_call_stack_depth)
+                              ? context->call_depth
+                              : context->max_call_stack_depth;
+        if (depth > 0)
+        {
+            frame = &context->call_stack_frames[depth - 1];
+        }
     }
-    safe_print_int(index);
-    safe_print_str(") File \"");
-    safe_print_str(frame->filename);
-    safe_print_str("\", line ");
-    safe_print_int(frame->line_number);
-    safe_print_str(" in ");
-    safe_print_str(frame->function_name);
-    safe_print_str(":\n    ");
-    safe_print_str(frame->source_code);
-    safe_print_str("\n");
+
+    ctb_crash_log_record(
+        CTB_CRASH_RECORD_SIGNAL,
+        (int)ctb_error,
+        frame ? frame->filename : NULL,
+        frame ? frame->line_number : 0,
+        frame ? frame->function_name : NULL,
+        NULL,
+        0
+    );
 }
 
-void ctb_dump_traceback_signal(const CTB_Error ctb_error)
+/**
+ * \brief Async-signal-safe renderer of the recorded errors followed by a final
+ * error at the current call stack.
+ *
+ * \param[in] context The context of the thread, or NULL.
+ * \param[in] ctb_error The final error.
+ * \param[in] error_frame The frame of the final error, or NULL.
+ * \param[in] message The message of the final error, or NULL.
+ */
+static void dump_traceback_safe(
+    const CTB_Context *context,
+    const CTB_Error ctb_error,
+    const CTB_Frame *error_frame,
+    const char *message
+)
 {
-    CTB_Context *context = get_context();
+    Safe_Buffer out;
+    out.length = 0;
+
     if (!context)
     {
-        safe_print_str("Critical Error: Could not access thread context.\n");
+        SAFE_PRINT_LITERAL(&out, "Critical Error: Could not access thread context.\n");
+        safe_flush(&out);
         return;
     }
 
@@ -687,123 +1146,182 @@ void ctb_dump_traceback_signal(const CTB_Error ctb_error)
                                   ? CTB_TRACEBACK_HEADER
                                   : "Traceback";
 
+    const int max_num_errors = context->max_num_errors;
+    const int max_depth = context->max_call_stack_depth;
     const int num_errors = context->num_errors;
     const int num_errors_to_print =
-        (num_errors > CTB_MAX_NUM_ERROR) ? CTB_MAX_NUM_ERROR : num_errors;
+        (num_errors > max_num_errors) ? max_num_errors : num_errors;
 
-    safe_print_str("\n");
+    SAFE_PRINT_LITERAL(&out, "\n");
     // Red Bold
     for (int i = 0; i < CTB_DEFAULT_TERMINAL_WIDTH; i++)
     {
-        safe_print_str("-");
+        SAFE_PRINT_LITERAL(&out, "-");
     }
-    safe_print_str("\n");
+    SAFE_PRINT_LITERAL(&out, "\n");
 
     for (int e = 0; e < num_errors_to_print; e++)
     {
-        CTB_Error_Snapshot_ *snapshot = &context->error_snapshots[e];
+        const CTB_Error_Snapshot_ *snapshot = ctb_get_error_snapshot(context, e);
         const int num_frames = snapshot->call_depth;
-        const bool stack_frames_exceed_max = (num_frames > CTB_MAX_CALL_STACK_DEPTH);
+        const bool stack_frames_exceed_max = (num_frames > max_depth);
         const int num_frames_to_print =
-            stack_frames_exceed_max ? CTB_MAX_CALL_STACK_DEPTH : num_frames;
+            stack_frames_exceed_max ? max_depth : num_frames;
 
         /* Print Header */
         if (num_errors > 1)
         {
-            safe_print_str("(#");
-            if (e < 10)
-            {
-                safe_print_str("0");
-            }
-            safe_print_int(e);
-            safe_print_str(") ");
+            SAFE_PRINT_LITERAL(&out, "(#");
+            safe_print_int(&out, e, 2);
+            SAFE_PRINT_LITERAL(&out, ") ");
         }
 
-        safe_print_str(header_text);
-        safe_print_str(" (most recent call last):\n");
+        safe_print_str(&out, header_text);
+        SAFE_PRINT_LITERAL(&out, " (most recent call last):\n");
 
         /* Print Stack Frames */
         for (int i = 0; i < num_frames_to_print; i++)
         {
-            safe_print_frame(i, &snapshot->call_stack_frames[i]);
+            safe_print_frame(&out, i, &snapshot->call_stack_frames[i]);
         }
 
         if (stack_frames_exceed_max)
         {
-            safe_print_str("\n      [... Skipped ");
-            safe_print_int(num_frames - CTB_MAX_CALL_STACK_DEPTH);
-            safe_print_str(" frames ...]\n\n");
+            SAFE_PRINT_LITERAL(&out, "\n      [... Skipped ");
+            safe_print_int(&out, num_frames - max_depth, 0);
+            SAFE_PRINT_LITERAL(&out, " frames ...]\n\n");
         }
 
-        safe_print_frame(num_frames, &snapshot->error_frame);
+        safe_print_frame(&out, num_frames, &snapshot->error_frame);
 
         /* Print Error Message */
-        safe_print_str(error_to_string(snapshot->error));
-        if (snapshot->error_message[0])
+        safe_print_str(&out, error_to_string(snapshot->error));
+        if (snapshot->os_errno != 0)
+        {
+            /* strerror is not async-signal-safe */
+            SAFE_PRINT_LITERAL(&out, ": [Errno ");
+            safe_print_int(&out, snapshot->os_errno, 0);
+            SAFE_PRINT_LITERAL(&out, "]");
+            if (snapshot->error_message[0])
+            {
+                SAFE_PRINT_LITERAL(&out, " ");
+            }
+        }
+        else if (snapshot->error_message[0])
+        {
+            SAFE_PRINT_LITERAL(&out, ": ");
+        }
+        safe_print_str(&out, snapshot->error_message);
+        if (snapshot->count > 1)
         {
-            safe_print_str(": ");
-            safe_print_str(snapshot->error_message);
+            SAFE_PRINT_LITERAL(&out, "\n[... Thrown ");
+            safe_print_int(&out, snapshot->count, 0);
+            SAFE_PRINT_LITERAL(&out, " times ...]");
         }
 
-        safe_print_str("\n\nDuring handling of the above exception, another exception "
-                       "occurred:\n\n");
+        SAFE_PRINT_LITERAL(
+            &out,
+            "\n\nDuring handling of the above exception, another exception "
+            "occurred:\n\n"
+        );
     }
 
-    if (num_errors > CTB_MAX_NUM_ERROR)
+    if (num_errors > max_num_errors)
     {
-        safe_print_str("\n[... Truncated ");
-        safe_print_int(num_errors - CTB_MAX_NUM_ERROR);
-        safe_print_str(" errors ...]\n");
+        SAFE_PRINT_LITERAL(&out, "\n[... Truncated ");
+        safe_print_int(&out, num_errors - max_num_errors, 0);
+        SAFE_PRINT_LITERAL(&out, " errors ...]\n");
     }
 
     /* Print signal error*/
     if ((num_errors + 1) > 1)
     {
-        safe_print_str("(#");
-        if ((num_errors + 1) < 10)
-        {
-            safe_print_str("0");
-        }
-        safe_print_int(num_errors);
-        safe_print_str(") ");
+        SAFE_PRINT_LITERAL(&out, "(#");
+        safe_print_int(&out, num_errors, 2);
+        SAFE_PRINT_LITERAL(&out, ") ");
     }
 
-    safe_print_str(header_text);
-    safe_print_str(" (most recent call last):\n");
+    safe_print_str(&out, header_text);
+    SAFE_PRINT_LITERAL(&out, " (most recent call last):\n");
 
     /* Print Stack Frames */
     const int num_frames = context->call_depth;
 
-    if (num_frames <= 0)
+    if (num_frames <= 0 && !error_frame)
     {
-        safe_print_str("  [No recorded stack frames]\n");
+        SAFE_PRINT_LITERAL(&out, "  [No recorded stack frames]\n");
     }
     else
     {
-        const bool stack_frames_exceed_max = (num_frames > CTB_MAX_CALL_STACK_DEPTH);
+        const bool stack_frames_exceed_max = (num_frames > max_depth);
         const int num_frames_to_print =
-            stack_frames_exceed_max ? CTB_MAX_CALL_STACK_DEPTH : num_frames;
+            stack_frames_exceed_max ? max_depth : num_frames;
 
         for (int i = 0; i < num_frames_to_print; i++)
         {
-            safe_print_frame(i, &context->call_stack_frames[i]);
+            safe_print_frame(&out, i, &context->call_stack_frames[i]);
         }
 
         if (stack_frames_exceed_max)
         {
-            safe_print_str("\n      [... Skipped ");
-            safe_print_int(num_frames - CTB_MAX_CALL_STACK_DEPTH);
-            safe_print_str(" frames ...]\n\n");
+            SAFE_PRINT_LITERAL(&out, "\n      [... Skipped ");
+            safe_print_int(&out, num_frames - max_depth, 0);
+            SAFE_PRINT_LITERAL(&out, " frames ...]\n\n");
         }
     }
 
-    /* Print Signal Error Message */
-    safe_print_str(error_to_string(ctb_error));
-    safe_print_str("\n");
+    if (error_frame)
+    {
+        safe_print_frame(&out, (num_frames > 0) ? num_frames : 0, error_frame);
+    }
+
+    /* Print Final Error Message */
+    safe_print_str(&out, error_to_string(ctb_error));
+    if (message && message[0])
+    {
+        SAFE_PRINT_LITERAL(&out, ": ");
+        safe_print_str(&out, message);
+    }
+    SAFE_PRINT_LITERAL(&out, "\n");
 
     for (int i = 0; i < CTB_DEFAULT_TERMINAL_WIDTH; i++)
     {
-        safe_print_str("-");
+        SAFE_PRINT_LITERAL(&out, "-");
+    }
+    SAFE_PRINT_LITERAL(&out, "\n");
+    safe_flush(&out);
+}
+
+void ctb_dump_traceback_signal(const CTB_Error ctb_error)
+{
+    const CTB_Context *context = peek_context();
+    if (ctb_atomic_load_relaxed(&ctb_crash_log_enabled))
+    {
+        record_signal(ctb_error, context);
     }
-    safe_print_str("\n");
+    dump_traceback_safe(context, ctb_error, NULL, NULL);
+}
+
+void ctb_dump_traceback_panic(
+    const CTB_Error ctb_error, const CTB_Frame *error_frame, const char *message
+)
+{
+    /* A thread that never entered TRACE has no context, but the panic has a frame */
+    static const CTB_Context empty_context;
+    const CTB_Context *context = peek_context();
+    if (ctb_atomic_load_relaxed(&ctb_crash_log_enabled))
+    {
+        ctb_crash_log_record(
+            CTB_CRASH_RECORD_ERROR,
+            (int)ctb_error,
+            error_frame->filename,
+            error_frame->line_number,
+            error_frame->function_name,
+            message,
+            strlen(message)
+        );
+    }
+    dump_traceback_safe(
+        context ? context : &empty_context, ctb_error, error_frame, message
+    );
 }
@@ -243,3 +243,23 @@ int get_terminal_width(FILE *stream)
 
     return CTB_DEFAULT_TERMINAL_WIDTH;
 }
+
+const char *get_errno_description(const int os_errno, char *buffer, const size_t size)
+{
+#ifdef _WIN32
+    if (strerror_s(buffer, size, os_errno) != 0)
+    {
+        return "Unknown error";
+    }
+    return buffer;
+#elif defined(__GLIBC__) && defined(_GNU_SOURCE)
+    /* The GNU variant may return a static string instead of filling the buffer */
+    return strerror_r(os_errno, buffer, size);
+#else
+    if (strerror_r(os_errno, buffer, size) != 0)
+    {
+        return "Unknown error";
+    }
+    return buffer;
+#endif
+}
@@ -0,0 +1,228 @@
+/**
+ * \file ctb_crash_decode.c
+ * \brief Print the records of a crash log file in chronological order.
+ *
+ * Usage: ctb_crash_decode [-n COUNT] FILE
+ *
+ * Records torn by a kill in the middle of a write are skipped.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "c_traceback.h"
+#include "crash_log.h"
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-n COUNT] FILE\n", program);
+    fprintf(stderr, "Print the last COUNT (default: all) records of a crash log.\n");
+}
+
+static int compare_sequence(const void *a, const void *b)
+{
+    const uint64_t sequence_a = ((const CTB_Crash_Record_ *)a)->sequence;
+    const uint64_t sequence_b = ((const CTB_Crash_Record_ *)b)->sequence;
+    return (sequence_a > sequence_b) - (sequence_a < sequence_b);
+}
+
+/**
+ * \brief Check whether a header belongs to a crash log of this version.
+ */
+static bool is_valid_header(const CTB_Crash_Log_Header_ *header)
+{
+    return memcmp(
+               header->fields.magic, CTB_CRASH_LOG_MAGIC, CTB_CRASH_LOG_MAGIC_LENGTH
+           ) == 0 &&
+           header->fields.version == CTB_CRASH_LOG_VERSION &&
+           header->fields.record_size == CTB_CRASH_LOG_RECORD_SIZE &&
+           header->fields.num_records > 0 &&
+           header->fields.num_records <= SIZE_MAX / sizeof(CTB_Crash_Record_);
+}
+
+/**
+ * \brief Check whether a record has been written completely to its slot.
+ */
+static bool is_valid_record(
+    const CTB_Crash_Record_ *record, const uint64_t slot, const uint64_t num_records
+)
+{
+    if (record->sequence == 0 || (record->sequence - 1) % num_records != slot)
+    {
+        return false;
+    }
+    if (record->checksum != ctb_crash_record_checksum(record))
+    {
+        return false;
+    }
+    return (size_t)record->file_length + record->function_length +
+               record->message_length <=
+           sizeof(record->text);
+}
+
+static const char *record_name(const CTB_Crash_Record_ *record)
+{
+    switch (record->type)
+    {
+        case CTB_CRASH_RECORD_ERROR:
+        case CTB_CRASH_RECORD_SIGNAL:
+            return error_to_string((CTB_Error)record->code);
+        case CTB_CRASH_RECORD_WARNING:
+            return warning_to_string((CTB_Warning)record->code);
+        default:
+            return "Message";
+    }
+}
+
+static const char *record_type(const CTB_Crash_Record_ *record)
+{
+    switch (record->type)
+    {
+        case CTB_CRASH_RECORD_ERROR:
+            return "error";
+        case CTB_CRASH_RECORD_WARNING:
+            return "warning";
+        case CTB_CRASH_RECORD_SIGNAL:
+            return "signal";
+        default:
+            return "message";
+    }
+}
+
+static void print_record(const CTB_Crash_Record_ *record)
+{
+    const time_t seconds = (time_t)(record->timestamp_ns / 1000000000ULL);
+    const unsigned long microseconds =
+        (unsigned long)(record->timestamp_ns % 1000000000ULL / 1000ULL);
+    const struct tm *utc = gmtime(&seconds);
+    char time_text[32] = "unknown time";
+    if (utc)
+    {
+        strftime(time_text, sizeof(time_text), "%Y-%m-%dT%H:%M:%S", utc);
+    }
+
+    const char *file = record->text;
+    const char *func = file + record->file_length;
+    const char *message = func + record->function_length;
+
+    printf(
+        "#%llu %s.%06luZ pid %lu tid %lu %s %s",
+        (unsigned long long)record->sequence,
+        time_text,
+        microseconds,
+        (unsigned long)record->pid,
+        (unsigned long)record->thread_id,
+        record_type(record),
+        record_name(record)
+    );
+    if (record->type != CTB_CRASH_RECORD_MESSAGE)
+    {
+        printf(" (%ld)", (long)record->code);
+    }
+
+    if (record->file_length > 0)
+    {
+        printf(" at %.*s:%ld", (int)record->file_length, file, (long)record->line);
+    }
+    if (record->function_length > 0)
+    {
+        printf(" in %.*s", (int)record->function_length, func);
+    }
+    if (record->message_length > 0)
+    {
+        printf(": %.*s", (int)record->message_length, message);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    unsigned long long max_count = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            max_count = strtoull(argv[++i], NULL, 10);
+        }
+        else if (argv[i][0] == '-' || path)
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (!path)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open crash log file: \"%s\"\n", path);
+        return EXIT_FAILURE;
+    }
+
+    CTB_Crash_Log_Header_ header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || !is_valid_header(&header))
+    {
+        fprintf(stderr, "Not a crash log file: \"%s\"\n", path);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    const uint64_t num_records = header.fields.num_records;
+    CTB_Crash_Record_ *records = malloc((size_t)num_records * sizeof(*records));
+    if (!records)
+    {
+        fprintf(stderr, "Out of memory\n");
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    /* Keep the valid records only, a truncated file simply has fewer */
+    size_t num_valid = 0;
+    for (uint64_t slot = 0; slot < num_records; slot++)
+    {
+        if (fread(&records[num_valid], sizeof(CTB_Crash_Record_), 1, file) != 1)
+        {
+            break;
+        }
+        if (is_valid_record(&records[num_valid], slot, num_records))
+        {
+            num_valid++;
+        }
+    }
+    fclose(file);
+
+    qsort(records, num_valid, sizeof(CTB_Crash_Record_), compare_sequence);
+
+    const size_t first = (max_count > 0 && max_count < num_valid)
+                             ? num_valid - (size_t)max_count
+                             : 0;
+    printf(
+        "Crash log \"%s\": %zu of %llu records, %llu written\n",
+        path,
+        num_valid,
+        (unsigned long long)num_records,
+        (unsigned long long)header.fields.sequence
+    );
+    for (size_t i = first; i < num_valid; i++)
+    {
+        print_record(&records[i]);
+    }
+
+    free(records);
+    return EXIT_SUCCESS;
+}